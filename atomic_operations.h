@@ -3,6 +3,7 @@
 
 #include "errors.h"
 #include "matrix.h"
+#include "workspace.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -37,10 +38,11 @@ void mtx_cfg_fix_unsafe_overlappings(int enable);
   } while (0)
 
 // Caso rules == true , aloca uma nova matriz de output para alias, que deixará
-// de ser um alias e terá dados alocados para si.
+// de ser um alias e terá dados alocados para si (da arena da thread, ver
+// workspace.h).
 #define MTX_ENSURE_SAFE_OUTPUT_RULES(alias, output, input, rules)              \
   MTX_ENSURE_SAFE_OUTPUT_IN_DETAILS(alias, output, input, rules,               \
-                                    mtx_matrix_init, (output)->dy,             \
+                                    mtx_matrix_init_scratch, (output)->dy,     \
                                     (output)->dx)
 
 // Caso output convegir com input, aloca uma nova matriz com as mesmas dimensões
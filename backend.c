@@ -0,0 +1,93 @@
+#include "backend.h"
+#include <dlfcn.h>
+#include <limits.h>
+#include <string.h>
+
+static const mtx_blas_backend_t *__mtx_cfg_blas_backend = NULL;
+
+int mtx_blas_backend_open(mtx_blas_backend_t *B, const char *path) {
+  memset(B, 0, sizeof(mtx_blas_backend_t));
+
+  void *handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+  if (handle == NULL) {
+    return -1;
+  }
+
+  // dlsym returns a void *, which ISO C doesn't convert to a function
+  // pointer, so the symbol is copied into the field.
+  void *sym;
+#define LOAD(field, name)                                                      \
+  sym = dlsym(handle, name);                                                   \
+  memcpy(&B->field, &sym, sizeof(sym))
+  LOAD(dgemm, "cblas_dgemm");
+  LOAD(dtrsm, "cblas_dtrsm");
+  LOAD(dgetrf, "dgetrf_");
+#undef LOAD
+
+  if (B->dgemm == NULL && B->dtrsm == NULL && B->dgetrf == NULL) {
+    dlclose(handle);
+    return -1;
+  }
+  B->name = path;
+  B->handle = handle;
+
+  return 0;
+}
+
+void mtx_blas_backend_close(mtx_blas_backend_t *B) {
+  if (B->handle != NULL) {
+    dlclose(B->handle);
+  }
+  memset(B, 0, sizeof(mtx_blas_backend_t));
+}
+
+void mtx_cfg_set_blas_backend(const mtx_blas_backend_t *B) {
+  __mtx_cfg_blas_backend = B; // TODO: Make thread safe.
+}
+
+const mtx_blas_backend_t *mtx_cfg_get_blas_backend() {
+  return __mtx_cfg_blas_backend;
+}
+
+#ifdef MTX_BLAS_BACKEND_LIBRARY
+static mtx_blas_backend_t __mtx_default_blas_backend;
+
+#ifdef __GNUC__
+__attribute__((constructor))
+#endif
+static void __mtx_backend_init() {
+  if (mtx_blas_backend_open(&__mtx_default_blas_backend,
+                            MTX_BLAS_BACKEND_LIBRARY) == 0) {
+    __mtx_cfg_blas_backend = &__mtx_default_blas_backend;
+  }
+}
+#endif
+
+int _mtx_backend_ld(const mtx_matrix_t *M, int trans) {
+  if (M->dy > INT_MAX || M->dx > INT_MAX) {
+    return -1;
+  }
+
+  // Rows (columns when transposed) of the row-major array and the number of
+  // elements in each one.
+  size_t lines = trans ? M->dx : M->dy;
+  size_t count = trans ? M->dy : M->dx;
+  ptrdiff_t unit = trans ? mtx_matrix_row_stride(M) : mtx_matrix_col_stride(M);
+  ptrdiff_t ld = trans ? mtx_matrix_col_stride(M) : mtx_matrix_row_stride(M);
+
+  if (unit != 1 && count > 1) {
+    return -1;
+  }
+  if (count == 0) {
+    count = 1;
+  }
+  // A single line is never stepped over.
+  if (lines <= 1) {
+    return (int)count;
+  }
+  if (ld < (ptrdiff_t)count || ld > INT_MAX) {
+    return -1;
+  }
+
+  return (int)ld;
+}
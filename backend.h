@@ -0,0 +1,76 @@
+#ifndef MTX_BACKEND_H
+#define MTX_BACKEND_H
+
+#include "cblas.h"
+#include "matrix.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Rotinas de uma BLAS/LAPACK externa (OpenBLAS, MKL, BLIS, ...) usadas no
+// lugar dos kernels da lib. Qualquer uma pode ser NULL, e a operação
+// correspondente continua nos kernels da lib:
+//
+// - dgemm: mtx_gemm() (e então mtx_matrix_mul(), mtx_matrix_gemm() e
+//   cblas_dgemm()) acima de MTX_GEMM_SMALL multiplicações, quando A e B têm
+//   linhas ou colunas contíguas e C tem colunas contíguas;
+// - dgetrf: mtx_linalg_LU_decomposition() com perfect == 1 e matriz quadrada.
+//   A permutação, o signum e a forma de _M_LU (L abaixo da diagonal, com 1's
+//   implícitos, e U a partir dela) são os mesmos da decomposição da lib;
+// - dtrsm: mtx_linalg_back_subs() e mtx_linalg_forward_subs() com a matriz
+//   triangular quadrada e x sem sobreposição com ela.
+typedef struct mtx_blas_backend {
+  const char *name;
+
+  // Assinaturas da CBLAS (cblas_dgemm e cblas_dtrsm).
+  void (*dgemm)(const enum CBLAS_ORDER Order,
+                const enum CBLAS_TRANSPOSE TransA,
+                const enum CBLAS_TRANSPOSE TransB, const int M, const int N,
+                const int K, const double alpha, const double *A,
+                const int lda, const double *B, const int ldb,
+                const double beta, double *C, const int ldc);
+  void (*dtrsm)(const enum CBLAS_ORDER Order, const enum CBLAS_SIDE Side,
+                const enum CBLAS_UPLO Uplo, const enum CBLAS_TRANSPOSE TransA,
+                const enum CBLAS_DIAG Diag, const int M, const int N,
+                const double alpha, const double *A, const int lda, double *B,
+                const int ldb);
+
+  // Assinatura Fortran da LAPACK (dgetrf_): matriz column-major e ipiv com
+  // índices a partir de 1.
+  void (*dgetrf)(const int *m, const int *n, double *a, const int *lda,
+                 int *ipiv, int *info);
+
+  // Handle do dlopen (NULL se a tabela foi preenchida à mão).
+  void *handle;
+} mtx_blas_backend_t;
+
+// Carrega a biblioteca path com dlopen e preenche B com os símbolos
+// cblas_dgemm, cblas_dtrsm e dgetrf_ encontrados. Retorna 0 se ao menos um
+// deles existir e -1 caso a biblioteca não seja carregada ou não tenha
+// nenhum (B fica zerado).
+int mtx_blas_backend_open(mtx_blas_backend_t *B, const char *path);
+
+// Descarrega a biblioteca de B. B não pode estar em uso.
+void mtx_blas_backend_close(mtx_blas_backend_t *B);
+
+// Passa a usar o backend B, que deve continuar válido enquanto estiver em
+// uso. NULL volta para os kernels da lib (o padrão). Compilando a lib com
+// -DMTX_BLAS_BACKEND_LIBRARY='"libopenblas.so.0"', a biblioteca é carregada
+// e selecionada na inicialização da lib, caso exista.
+void mtx_cfg_set_blas_backend(const mtx_blas_backend_t *B);
+
+// Retorna o backend em uso (NULL para os kernels da lib).
+const mtx_blas_backend_t *mtx_cfg_get_blas_backend();
+
+// Leading dimension de M para uma chamada row-major do backend sem
+// transposição (M com colunas contíguas) ou, com trans, de M como transposta
+// de uma matriz row-major (M com linhas contíguas). Retorna -1 caso M não
+// tenha essa forma ou não caiba nos int da interface.
+int _mtx_backend_ld(const mtx_matrix_t *M, int trans);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,103 @@
+#include "blas1.h"
+#include "simd.h"
+#include <float.h>
+#include <math.h>
+
+#define _abs(x) ((x) < 0 ? -(x) : (x))
+
+// Vectors with other strides are walked element by element: they only come
+// from columns and strided views, which aren't worth gathering.
+
+double _mtx_dot(size_t n, const double *x, ptrdiff_t incx, const double *y,
+                ptrdiff_t incy) {
+  if (incx == 1 && incy == 1) {
+    return mtx_kernels()->dot(x, y, n);
+  }
+
+  double dot = 0;
+  for (size_t i = 0; i < n; ++i, x += incx, y += incy) {
+    dot += *x * *y;
+  }
+  return dot;
+}
+
+void _mtx_axpy(size_t n, double alpha, const double *x, ptrdiff_t incx,
+               double *y, ptrdiff_t incy) {
+  if (incx == 1 && incy == 1) {
+    mtx_kernels()->sum_multiple(y, x, alpha, n);
+    return;
+  }
+
+  for (size_t i = 0; i < n; ++i, x += incx, y += incy) {
+    *y += *x * alpha;
+  }
+}
+
+void _mtx_scal(size_t n, double alpha, double *x, ptrdiff_t incx) {
+  if (incx == 1) {
+    mtx_kernels()->scale(x, x, alpha, n);
+    return;
+  }
+
+  for (size_t i = 0; i < n; ++i, x += incx) {
+    *x *= alpha;
+  }
+}
+
+double _mtx_asum(size_t n, const double *x, ptrdiff_t incx) {
+  if (incx == 1) {
+    return mtx_kernels()->asum(x, n);
+  }
+
+  double sum = 0;
+  for (size_t i = 0; i < n; ++i, x += incx) {
+    sum += _abs(*x);
+  }
+  return sum;
+}
+
+static double _mtx_amax(size_t n, const double *x, ptrdiff_t incx) {
+  if (incx == 1) {
+    return mtx_kernels()->amax(x, n);
+  }
+
+  double max = 0;
+  for (size_t i = 0; i < n; ++i, x += incx) {
+    double v = _abs(*x);
+    max = v > max ? v : max;
+  }
+  return max;
+}
+
+double _mtx_nrm2(size_t n, const double *x, ptrdiff_t incx) {
+  double ss = _mtx_dot(n, x, incx, x, incx);
+  if (ss >= DBL_MIN && ss <= DBL_MAX) {
+    return sqrt(ss);
+  }
+
+  // Some square overflowed or underflowed: sum the squares of x / max |x|.
+  double max = _mtx_amax(n, x, incx);
+  if (max == 0 || max > DBL_MAX) {
+    return max;
+  }
+  ss = 0;
+  for (size_t i = 0; i < n; ++i) {
+    double v = x[(ptrdiff_t)i * incx] / max;
+    ss += v * v;
+  }
+  return max * sqrt(ss);
+}
+
+size_t _mtx_iamax(size_t n, const double *x, ptrdiff_t incx) {
+  // The maximum is found with the vector kernel, then its first position.
+  double max = _mtx_amax(n, x, incx);
+  for (size_t i = 0; i < n; ++i) {
+    double v = x[(ptrdiff_t)i * incx];
+    if (!(_abs(v) < max)) {
+      return i;
+    }
+  }
+  return 0;
+}
+
+#undef _abs
@@ -0,0 +1,40 @@
+#ifndef MTX_BLAS1_H
+#define MTX_BLAS1_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Uso interno da lib: rotinas de nível 1 do BLAS sobre vetores de n elementos
+// x[i * incx], com 0 <= i < n (o passo pode ser negativo, x aponta sempre para
+// o primeiro elemento). Com passo 1 elas usam os kernels vetorizados em uso
+// (ver simd.h), então todas as rotinas que percorrem linhas (LU,
+// substituições, refinamento, ...) passam por aqui.
+
+// Retorna o somatório de x[i] * y[i].
+double _mtx_dot(size_t n, const double *x, ptrdiff_t incx, const double *y,
+                ptrdiff_t incy);
+
+// y[i] += alpha * x[i].
+void _mtx_axpy(size_t n, double alpha, const double *x, ptrdiff_t incx,
+               double *y, ptrdiff_t incy);
+
+// x[i] *= alpha.
+void _mtx_scal(size_t n, double alpha, double *x, ptrdiff_t incx);
+
+// Retorna o somatório de |x[i]|.
+double _mtx_asum(size_t n, const double *x, ptrdiff_t incx);
+
+// Retorna a norma euclidiana de x, sem overflow ou underflow nos quadrados.
+double _mtx_nrm2(size_t n, const double *x, ptrdiff_t incx);
+
+// Retorna o primeiro i com o maior |x[i]| (0 com n == 0).
+size_t _mtx_iamax(size_t n, const double *x, ptrdiff_t incx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,337 @@
+#include "cblas.h"
+#include "blas1.h"
+#include "errors.h"
+#include "gemm.h"
+#include "matrix.h"
+#include "workspace.h"
+
+// Rows of X solved between two GEMM updates in cblas_dtrsm().
+#define TRSM_NB 64
+
+// First element of a vector of n elements with stride inc (the last one in
+// memory when inc < 0).
+#define FIRST(x, n, inc)                                                       \
+  ((inc) < 0 && (n) > 0 ? (x) - (ptrdiff_t)((n)-1) * (inc) : (x))
+
+// Wraps the rows x cols matrix stored at a in the given order, without
+// allocating: M is the matrix itself or, with trans, its transpose. A
+// row-major storage (row-major without trans or column-major with it) gives a
+// plain matrix, the other one a transposed view. Returns -1 for invalid
+// dimensions.
+static int _mtx_cblas_matrix(mtx_matrix_t *M, mtx_matrix_data_t *data,
+                             enum CBLAS_ORDER order, int trans,
+                             const double *a, int rows, int cols, int ld) {
+  int row_major = order == CblasRowMajor;
+  int s_rows = row_major ? rows : cols, s_cols = row_major ? cols : rows;
+
+  *data = (mtx_matrix_data_t){
+      .m = (double *)a, .size1 = s_rows, .size2 = s_cols, .ld = ld};
+  *M = (mtx_matrix_t){.data = data};
+  if (row_major != trans) {
+    M->dy = s_rows;
+    M->dx = s_cols;
+  } else {
+    M->dy = s_cols;
+    M->dx = s_rows;
+    M->flags = MTX_MATRIX_VIEW_STRIDED | MTX_MATRIX_VIEW_TRANSPOSED;
+    M->row_stride = 1;
+    M->col_stride = ld;
+  }
+
+  if (rows < 0 || cols < 0 || ld < (s_cols > 1 ? s_cols : 1)) {
+    MTX_DIMEN_ERR(M);
+    return -1;
+  }
+  return 0;
+}
+
+// Wraps the vector x of n elements with stride inc as a n x 1 view.
+static void _mtx_cblas_vector(mtx_matrix_t *V, mtx_matrix_data_t *data,
+                              const double *x, int n, int inc) {
+  *data = (mtx_matrix_data_t){
+      .m = (double *)FIRST(x, n, inc), .size1 = n, .size2 = 1, .ld = 1};
+  *V = (mtx_matrix_t){.data = data,
+                      .dy = n,
+                      .dx = 1,
+                      .flags = MTX_MATRIX_VIEW_STRIDED,
+                      .row_stride = inc,
+                      .col_stride = 1};
+}
+
+double cblas_ddot(const int N, const double *X, const int incX,
+                  const double *Y, const int incY) {
+  if (N <= 0) {
+    return 0;
+  }
+  return _mtx_dot(N, FIRST(X, N, incX), incX, FIRST(Y, N, incY), incY);
+}
+
+double cblas_dnrm2(const int N, const double *X, const int incX) {
+  if (N <= 0 || incX <= 0) {
+    return 0;
+  }
+  return _mtx_nrm2(N, X, incX);
+}
+
+double cblas_dasum(const int N, const double *X, const int incX) {
+  if (N <= 0 || incX <= 0) {
+    return 0;
+  }
+  return _mtx_asum(N, X, incX);
+}
+
+CBLAS_INDEX cblas_idamax(const int N, const double *X, const int incX) {
+  if (N <= 0 || incX <= 0) {
+    return 0;
+  }
+  return _mtx_iamax(N, X, incX);
+}
+
+void cblas_daxpy(const int N, const double alpha, const double *X,
+                 const int incX, double *Y, const int incY) {
+  if (N <= 0 || alpha == 0) {
+    return;
+  }
+  _mtx_axpy(N, alpha, FIRST(X, N, incX), incX, FIRST(Y, N, incY), incY);
+}
+
+void cblas_dscal(const int N, const double alpha, double *X, const int incX) {
+  if (N <= 0 || incX <= 0) {
+    return;
+  }
+  _mtx_scal(N, alpha, X, incX);
+}
+
+void cblas_dgemv(const enum CBLAS_ORDER order,
+                 const enum CBLAS_TRANSPOSE TransA, const int M, const int N,
+                 const double alpha, const double *A, const int lda,
+                 const double *X, const int incX, const double beta, double *Y,
+                 const int incY) {
+  mtx_matrix_data_t a_data, x_data, y_data;
+  mtx_matrix_t a, x, y;
+  if (_mtx_cblas_matrix(&a, &a_data, order, TransA != CblasNoTrans, A, M, N,
+                        lda) != 0 ||
+      a.dy == 0) {
+    return;
+  }
+
+  // y = alpha * a x + beta * y goes to the GEMV kernels (see gemm.c).
+  _mtx_cblas_vector(&x, &x_data, X, a.dx, incX);
+  _mtx_cblas_vector(&y, &y_data, Y, a.dy, incY);
+  mtx_gemm(&y, alpha, &a, &x, beta);
+}
+
+void cblas_dger(const enum CBLAS_ORDER order, const int M, const int N,
+                const double alpha, const double *X, const int incX,
+                const double *Y, const int incY, double *A, const int lda) {
+  mtx_matrix_data_t a_data;
+  mtx_matrix_t a;
+  if (_mtx_cblas_matrix(&a, &a_data, order, 0, A, M, N, lda) != 0 || M == 0 ||
+      N == 0 || alpha == 0) {
+    return;
+  }
+
+  const double *x = FIRST(X, M, incX), *y = FIRST(Y, N, incY);
+  if (MTX_MATRIX_HAS_UNIT_COLUMNS(&a)) {
+    for (int i = 0; i < M; ++i) {
+      _mtx_axpy(N, alpha * x[(ptrdiff_t)i * incX], y, incY,
+                mtx_matrix_row(&a, i), 1);
+    }
+  } else {
+    // Column-major: the columns are contiguous.
+    for (int j = 0; j < N; ++j) {
+      _mtx_axpy(M, alpha * y[(ptrdiff_t)j * incY], x, incX,
+                &mtx_matrix_at(&a, 0, j), 1);
+    }
+  }
+}
+
+void cblas_dtrsv(const enum CBLAS_ORDER order, const enum CBLAS_UPLO Uplo,
+                 const enum CBLAS_TRANSPOSE TransA, const enum CBLAS_DIAG Diag,
+                 const int N, const double *A, const int lda, double *X,
+                 const int incX) {
+  int trans = TransA != CblasNoTrans;
+  mtx_matrix_data_t a_data;
+  mtx_matrix_t a;
+  if (_mtx_cblas_matrix(&a, &a_data, order, trans, A, N, N, lda) != 0 ||
+      N == 0) {
+    return;
+  }
+
+  // a is op(A), triangular as A only without the transpose.
+  int upper = (Uplo == CblasUpper) != trans, unit = Diag == CblasUnit;
+  const size_t n = N;
+
+  // Strided vectors are solved on a contiguous copy.
+  double *x = (double *)FIRST(X, N, incX), *xs = x;
+  if (incX != 1) {
+    xs = (double *)_mtx_scratch_alloc(sizeof(double) * n);
+    for (size_t i = 0; i < n; ++i) {
+      xs[i] = x[(ptrdiff_t)i * incX];
+    }
+  }
+
+  if (MTX_MATRIX_HAS_UNIT_COLUMNS(&a)) {
+    // Contiguous rows: dot products against the solved part of x.
+    if (upper) {
+      for (size_t i = n; i-- > 0;) {
+        const double *a_i = mtx_matrix_row(&a, i);
+        xs[i] -= _mtx_dot(n - i - 1, &a_i[i + 1], 1, &xs[i + 1], 1);
+        if (!unit) {
+          xs[i] /= a_i[i];
+        }
+      }
+    } else {
+      for (size_t i = 0; i < n; ++i) {
+        const double *a_i = mtx_matrix_row(&a, i);
+        xs[i] -= _mtx_dot(i, a_i, 1, xs, 1);
+        if (!unit) {
+          xs[i] /= a_i[i];
+        }
+      }
+    }
+  } else {
+    // Contiguous columns: each solved element is eliminated from the rest of
+    // x with an axpy.
+    if (upper) {
+      for (size_t j = n; j-- > 0;) {
+        const double *a_j = &mtx_matrix_at(&a, 0, j);
+        if (!unit) {
+          xs[j] /= a_j[j];
+        }
+        _mtx_axpy(j, -xs[j], a_j, 1, xs, 1);
+      }
+    } else {
+      for (size_t j = 0; j < n; ++j) {
+        const double *a_j = &mtx_matrix_at(&a, 0, j);
+        if (!unit) {
+          xs[j] /= a_j[j];
+        }
+        _mtx_axpy(n - j - 1, -xs[j], &a_j[j + 1], 1, &xs[j + 1], 1);
+      }
+    }
+  }
+
+  if (xs != x) {
+    for (size_t i = 0; i < n; ++i) {
+      x[(ptrdiff_t)i * incX] = xs[i];
+    }
+    _mtx_scratch_free(xs);
+  }
+}
+
+#define B_ROW(i) (&mtx_matrix_at(b, (i), 0))
+
+// Solves a X = alpha * b in place, a n x n triangular and b n x m, both in any
+// layout. Blocks of TRSM_NB rows of X are solved with row operations, then
+// eliminated from the remaining rows of b with a GEMM update (right-looking).
+static void _mtx_cblas_trsm_left(const mtx_matrix_t *a, mtx_matrix_t *b,
+                                 int upper, int unit, double alpha) {
+  const size_t n = a->dy, m = b->dx;
+  const ptrdiff_t cs = mtx_matrix_col_stride(b);
+
+  if (alpha != 1) {
+    for (size_t i = 0; i < n; ++i) {
+      if (alpha != 0) {
+        _mtx_scal(m, alpha, B_ROW(i), cs);
+        continue;
+      }
+      for (size_t j = 0; j < m; ++j) {
+        mtx_matrix_at(b, i, j) = 0;
+      }
+    }
+    if (alpha == 0) {
+      return;
+    }
+  }
+
+  if (upper) {
+    for (size_t i1 = n; i1 > 0;) {
+      size_t i0 = i1 > TRSM_NB ? i1 - TRSM_NB : 0;
+      for (size_t i = i1; i-- > i0;) {
+        for (size_t k = i + 1; k < i1; ++k) {
+          _mtx_axpy(m, -mtx_matrix_at(a, i, k), B_ROW(k), cs, B_ROW(i), cs);
+        }
+        if (!unit) {
+          _mtx_scal(m, 1.0 / mtx_matrix_at(a, i, i), B_ROW(i), cs);
+        }
+      }
+
+      if (i0 > 0) {
+        mtx_matrix_view_t a01 = mtx_matrix_view_of(a, 0, i0, i0, i1 - i0);
+        mtx_matrix_view_t b0 = mtx_matrix_view_of(b, 0, 0, i0, m);
+        mtx_matrix_view_t b1 = mtx_matrix_view_of(b, i0, 0, i1 - i0, m);
+        mtx_gemm(&b0.matrix, -1, &a01.matrix, &b1.matrix, 1);
+      }
+      i1 = i0;
+    }
+  } else {
+    for (size_t i0 = 0; i0 < n; i0 += TRSM_NB) {
+      size_t i1 = n - i0 > TRSM_NB ? i0 + TRSM_NB : n;
+      for (size_t i = i0; i < i1; ++i) {
+        for (size_t k = i0; k < i; ++k) {
+          _mtx_axpy(m, -mtx_matrix_at(a, i, k), B_ROW(k), cs, B_ROW(i), cs);
+        }
+        if (!unit) {
+          _mtx_scal(m, 1.0 / mtx_matrix_at(a, i, i), B_ROW(i), cs);
+        }
+      }
+
+      if (i1 < n) {
+        mtx_matrix_view_t a10 = mtx_matrix_view_of(a, i1, i0, n - i1, i1 - i0);
+        mtx_matrix_view_t b1 = mtx_matrix_view_of(b, i0, 0, i1 - i0, m);
+        mtx_matrix_view_t b2 = mtx_matrix_view_of(b, i1, 0, n - i1, m);
+        mtx_gemm(&b2.matrix, -1, &a10.matrix, &b1.matrix, 1);
+      }
+    }
+  }
+}
+
+#undef B_ROW
+
+void cblas_dtrsm(const enum CBLAS_ORDER Order, const enum CBLAS_SIDE Side,
+                 const enum CBLAS_UPLO Uplo, const enum CBLAS_TRANSPOSE TransA,
+                 const enum CBLAS_DIAG Diag, const int M, const int N,
+                 const double alpha, const double *A, const int lda, double *B,
+                 const int ldb) {
+  // X op(A) = alpha * B is solved as op(A)^T X^T = alpha * B^T.
+  int right = Side == CblasRight;
+  int trans = (TransA != CblasNoTrans) != right;
+  int n = right ? N : M;
+
+  mtx_matrix_data_t a_data, b_data;
+  mtx_matrix_t a, b;
+  if (_mtx_cblas_matrix(&a, &a_data, Order, trans, A, n, n, lda) != 0 ||
+      _mtx_cblas_matrix(&b, &b_data, Order, right, B, M, N, ldb) != 0 ||
+      M == 0 || N == 0) {
+    return;
+  }
+
+  _mtx_cblas_trsm_left(&a, &b, (Uplo == CblasUpper) != trans,
+                       Diag == CblasUnit, alpha);
+}
+
+void cblas_dgemm(const enum CBLAS_ORDER Order,
+                 const enum CBLAS_TRANSPOSE TransA,
+                 const enum CBLAS_TRANSPOSE TransB, const int M, const int N,
+                 const int K, const double alpha, const double *A,
+                 const int lda, const double *B, const int ldb,
+                 const double beta, double *C, const int ldc) {
+  int trans_a = TransA != CblasNoTrans, trans_b = TransB != CblasNoTrans;
+
+  mtx_matrix_data_t a_data, b_data, c_data;
+  mtx_matrix_t a, b, c;
+  if (_mtx_cblas_matrix(&a, &a_data, Order, trans_a, A, trans_a ? K : M,
+                        trans_a ? M : K, lda) != 0 ||
+      _mtx_cblas_matrix(&b, &b_data, Order, trans_b, B, trans_b ? N : K,
+                        trans_b ? K : N, ldb) != 0 ||
+      _mtx_cblas_matrix(&c, &c_data, Order, 0, C, M, N, ldc) != 0 || M == 0 ||
+      N == 0) {
+    return;
+  }
+
+  mtx_gemm(&c, alpha, &a, &b, beta);
+}
+
+#undef TRSM_NB
+#undef FIRST
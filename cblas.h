@@ -0,0 +1,100 @@
+#ifndef MTX_CBLAS_H
+#define MTX_CBLAS_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Subconjunto da interface CBLAS para double real, com as assinaturas e os
+// valores das enumerações padrão, então códigos escritos para outras CBLAS
+// (GSL, ...) podem ser ligados a esta lib. As rotinas usam os mesmos kernels
+// das operações mtx_matrix_* (blas1.h, GEMV e GEMM, ver gemm.h).
+//
+// Os vetores x[i * incX] com incX < 0 são percorridos a partir do fim, como
+// no BLAS de referência: o primeiro elemento é x[(n - 1) * -incX]. Dimensões
+// negativas e leading dimensions menores que o número de elementos de uma
+// linha (RowMajor) ou coluna (ColMajor) geram MTX_DIMEN_ERR.
+
+enum CBLAS_ORDER { CblasRowMajor = 101, CblasColMajor = 102 };
+enum CBLAS_TRANSPOSE {
+  CblasNoTrans = 111,
+  CblasTrans = 112,
+  CblasConjTrans = 113
+};
+enum CBLAS_UPLO { CblasUpper = 121, CblasLower = 122 };
+enum CBLAS_DIAG { CblasNonUnit = 131, CblasUnit = 132 };
+enum CBLAS_SIDE { CblasLeft = 141, CblasRight = 142 };
+
+#define CBLAS_INDEX size_t
+
+// Nível 1
+
+// Retorna o somatório de x[i] * y[i].
+double cblas_ddot(const int N, const double *X, const int incX,
+                  const double *Y, const int incY);
+
+// Retorna a norma euclidiana de x.
+double cblas_dnrm2(const int N, const double *X, const int incX);
+
+// Retorna o somatório de |x[i]|.
+double cblas_dasum(const int N, const double *X, const int incX);
+
+// Retorna o primeiro i com o maior |x[i]|.
+CBLAS_INDEX cblas_idamax(const int N, const double *X, const int incX);
+
+// y = alpha * x + y.
+void cblas_daxpy(const int N, const double alpha, const double *X,
+                 const int incX, double *Y, const int incY);
+
+// x = alpha * x (nada é feito com incX <= 0).
+void cblas_dscal(const int N, const double alpha, double *X, const int incX);
+
+// Nível 2
+
+// y = alpha * op(A) x + beta * y, sendo A M x N. Com beta == 0, y não é
+// lido.
+void cblas_dgemv(const enum CBLAS_ORDER order,
+                 const enum CBLAS_TRANSPOSE TransA, const int M, const int N,
+                 const double alpha, const double *A, const int lda,
+                 const double *X, const int incX, const double beta, double *Y,
+                 const int incY);
+
+// A = alpha * x y^T + A, sendo A M x N.
+void cblas_dger(const enum CBLAS_ORDER order, const int M, const int N,
+                const double alpha, const double *X, const int incX,
+                const double *Y, const int incY, double *A, const int lda);
+
+// Resolve op(A) x = b no lugar (x entra com b), sendo A N x N triangular.
+void cblas_dtrsv(const enum CBLAS_ORDER order, const enum CBLAS_UPLO Uplo,
+                 const enum CBLAS_TRANSPOSE TransA, const enum CBLAS_DIAG Diag,
+                 const int N, const double *A, const int lda, double *X,
+                 const int incX);
+
+// Nível 3
+
+// Resolve op(A) X = alpha * B (CblasLeft) ou X op(A) = alpha * B
+// (CblasRight) no lugar (X sobrescreve B), sendo B M x N e A triangular.
+// Blocos de linhas de X são resolvidos por vez e o resto de B é atualizado
+// com GEMM.
+void cblas_dtrsm(const enum CBLAS_ORDER Order, const enum CBLAS_SIDE Side,
+                 const enum CBLAS_UPLO Uplo, const enum CBLAS_TRANSPOSE TransA,
+                 const enum CBLAS_DIAG Diag, const int M, const int N,
+                 const double alpha, const double *A, const int lda, double *B,
+                 const int ldb);
+
+// C = alpha * op(A) op(B) + beta * C, sendo C M x N e op(A) M x K. Com
+// beta == 0, C não é lido.
+void cblas_dgemm(const enum CBLAS_ORDER Order,
+                 const enum CBLAS_TRANSPOSE TransA,
+                 const enum CBLAS_TRANSPOSE TransB, const int M, const int N,
+                 const int K, const double alpha, const double *A,
+                 const int lda, const double *B, const int ldb,
+                 const double beta, double *C, const int ldc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -35,14 +35,14 @@ void mtx_default_error_handler(const char *file, const char *fun, int line,
   mtx_error_handler(__FILE__, __func__, __LINE__, error, __VA_ARGS__)
 
 #define MTX_NULL_ERR_TEXT "matrix %s is unitialized."
-#define MTX_DIMEN_ERR_TEXT "matrix (%d, %d) %s has invalid dimensions."
+#define MTX_DIMEN_ERR_TEXT "matrix (%zu, %zu) %s has invalid dimensions."
 #define MTX_INVALID_ERR_TEXT "matrix %s is invalid."
-#define MTX_BOUNDS_ERR_TEXT "matrix (%d, %d,%d, %d) %s is out of bounds."
+#define MTX_BOUNDS_ERR_TEXT "matrix (%zu, %zu,%zu, %zu) %s is out of bounds."
 #define MTX_OVERLAP_ERR_TEXT_1                                                 \
-  "matrix (%d, %d, %d, %d) %s has an unsafe overlap with matrix "              \
-  "(%d, %d, %d, %d) %s."
+  "matrix (%zu, %zu, %zu, %zu) %s has an unsafe overlap with matrix "          \
+  "(%zu, %zu, %zu, %zu) %s."
 #define MTX_OVERLAP_ERR_TEXT_2                                                 \
-  "matrix (%d, %d) %s and %s are the same and it isn't allowed in "            \
+  "matrix (%zu, %zu) %s and %s are the same and it isn't allowed in "          \
   "this function."
 
 #define MTX_SYSTEM_ERR_TEXT "Got a system error after a call to %s()"
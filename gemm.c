@@ -0,0 +1,375 @@
+#include "gemm.h"
+#include "backend.h"
+#include "blas1.h"
+#include "errors.h"
+#include "matrix.h"
+#include "simd.h"
+#include "threads.h"
+#include "workspace.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define MC MTX_GEMM_MC
+#define KC MTX_GEMM_KC
+#define NC MTX_GEMM_NC
+
+#define _min(a, b) ((a) < (b) ? (a) : (b))
+
+// Packs the mc x kc block of A starting at (ic, pc) into micro-panels of MR
+// rows. Each micro-panel is stored column by column (MR contiguous elements for
+// each k), the rows past mc are zero padded. A may be a strided view: for a
+// transposed one the MR elements of each k are contiguous in memory.
+static void _mtx_pack_A(double *Ap, const mtx_matrix_t *A, size_t ic,
+                        size_t pc, int mc, int kc, int MR) {
+  const ptrdiff_t cs = mtx_matrix_col_stride(A);
+  for (int ir = 0; ir < mc; ir += MR) {
+    int mr = _min(MR, mc - ir);
+    const double *rows[MTX_SIMD_GEMM_MR_MAX];
+    for (int i = 0; i < mr; ++i) {
+      rows[i] = &mtx_matrix_at(A, ic + ir + i, pc);
+    }
+
+    for (int p = 0; p < kc; ++p) {
+      int i = 0;
+      for (; i < mr; ++i) {
+        *(Ap++) = rows[i][p * cs];
+      }
+      for (; i < MR; ++i) {
+        *(Ap++) = 0;
+      }
+    }
+  }
+}
+
+// Packs the kc x nc panel of B starting at (pc, jc) into micro-panels of NR
+// columns. Each micro-panel is stored row by row (NR contiguous elements for
+// each k), the columns past nc are zero padded.
+static void _mtx_pack_B(double *Bp, const mtx_matrix_t *B, size_t pc,
+                        size_t jc, int kc, int nc, int NR) {
+  const ptrdiff_t cs = mtx_matrix_col_stride(B);
+  for (int jr = 0; jr < nc; jr += NR) {
+    int nr = _min(NR, nc - jr);
+    for (int p = 0; p < kc; ++p) {
+      const double *b = &mtx_matrix_at(B, pc + p, jc + jr);
+      int j = 0;
+      for (; j < nr; ++j) {
+        Bp[j] = b[j * cs];
+      }
+      for (; j < NR; ++j) {
+        Bp[j] = 0;
+      }
+      Bp += NR;
+    }
+  }
+}
+
+// Multiplies the packed mc x kc block of A by the packed kc x nc panel of B,
+// scaled by alpha, into C at (ic, jc). The first block of the k dimension
+// (first == 1) also scales C by beta; C isn't read when beta == 0.
+static void _mtx_gemm_macro_kernel(const mtx_kernels_t *kernels,
+                                   mtx_matrix_t *C, const double *Ap,
+                                   const double *Bp, size_t ic, size_t jc,
+                                   int mc, int nc, int kc, double alpha,
+                                   double beta, int first) {
+  const int MR = kernels->gemm_mr, NR = kernels->gemm_nr;
+  const ptrdiff_t cs = mtx_matrix_col_stride(C);
+  double ab[MTX_SIMD_GEMM_MR_MAX * MTX_SIMD_GEMM_NR_MAX];
+
+  for (int jr = 0; jr < nc; jr += NR) {
+    int nr = _min(NR, nc - jr);
+    for (int ir = 0; ir < mc; ir += MR) {
+      int mr = _min(MR, mc - ir);
+
+      kernels->gemm_micro(kc, &Ap[ir * kc], &Bp[jr * kc], ab);
+
+      for (int i = 0; i < mr; ++i) {
+        double *c = &mtx_matrix_at(C, ic + ir + i, jc + jr);
+        const double *ab_i = &ab[i * NR];
+        if (first && beta == 0) {
+          for (int j = 0; j < nr; ++j) {
+            c[j * cs] = alpha * ab_i[j];
+          }
+        } else if (first) {
+          for (int j = 0; j < nr; ++j) {
+            c[j * cs] = beta * c[j * cs] + alpha * ab_i[j];
+          }
+        } else {
+          for (int j = 0; j < nr; ++j) {
+            c[j * cs] += alpha * ab_i[j];
+          }
+        }
+      }
+    }
+  }
+}
+
+// C = beta * C, without reading C when beta == 0.
+static void _mtx_gemm_scale(mtx_matrix_t *C, double beta) {
+  if (beta == 1) {
+    return;
+  }
+  for (size_t i = 0; i < C->dy; ++i) {
+    for (size_t j = 0; j < C->dx; ++j) {
+      mtx_matrix_at(C, i, j) = beta == 0 ? 0 : beta * mtx_matrix_at(C, i, j);
+    }
+  }
+}
+
+// C = alpha * A x B + beta * C with an i-k-j loop over the rows, used when the
+// matrices are too small for the packing to pay off.
+static void _mtx_gemm_small(mtx_matrix_t *C, double alpha,
+                            const mtx_matrix_t *A, const mtx_matrix_t *B,
+                            double beta) {
+  if (!MTX_MATRIX_HAS_UNIT_COLUMNS(C) || !MTX_MATRIX_HAS_UNIT_COLUMNS(A) ||
+      !MTX_MATRIX_HAS_UNIT_COLUMNS(B)) {
+    // Views with other column strides (A^T, ...) element by element.
+    for (size_t i = 0; i < C->dy; ++i) {
+      for (size_t j = 0; j < C->dx; ++j) {
+        double sum = 0;
+        for (size_t p = 0; p < A->dx; ++p) {
+          sum += mtx_matrix_at(A, i, p) * mtx_matrix_at(B, p, j);
+        }
+        double *c = &mtx_matrix_at(C, i, j);
+        *c = beta == 0 ? alpha * sum : alpha * sum + beta * *c;
+      }
+    }
+    return;
+  }
+
+  _mtx_gemm_scale(C, beta);
+  for (size_t i = 0; i < C->dy; ++i) {
+    double *c = mtx_matrix_row(C, i);
+    const double *a = mtx_matrix_row(A, i);
+
+    for (size_t p = 0; p < A->dx; ++p) {
+      _mtx_axpy(C->dx, alpha * a[p], mtx_matrix_row(B, p), 1, c, 1);
+    }
+  }
+}
+
+typedef struct mtx_gemv_job {
+  const mtx_kernels_t *kernels;
+  const double *a, *x;
+  ptrdiff_t lda;
+  double *t;
+  size_t k;
+} mtx_gemv_job_t;
+
+// t[begin, end) = rows [begin, end) of A x x, A with unit columns.
+static void _mtx_gemv_rows_task(void *arg, size_t begin, size_t end) {
+  mtx_gemv_job_t *job = (mtx_gemv_job_t *)arg;
+  job->kernels->gemv(&job->t[begin], &job->a[(ptrdiff_t)begin * job->lda],
+                     job->lda, job->x, end - begin, job->k);
+}
+
+// t[begin, end) += rows [begin, end) of A x x, A with unit rows (a transposed
+// view): its columns are walked as the rows of A^T.
+static void _mtx_gemv_cols_task(void *arg, size_t begin, size_t end) {
+  mtx_gemv_job_t *job = (mtx_gemv_job_t *)arg;
+  job->kernels->gemv_t(&job->t[begin], &job->a[begin], job->lda, job->x,
+                       job->k, end - begin);
+}
+
+// C = alpha * A x B + beta * C for a single row or column C. A row is computed
+// as the column C^T = B^T x A^T. The column goes to the gemv kernels, which
+// stream A once instead of packing it.
+static void _mtx_gemv(mtx_matrix_t *C, double alpha, const mtx_matrix_t *A,
+                      const mtx_matrix_t *B, double beta) {
+  if (C->dx != 1) {
+    mtx_matrix_view_t Ct = mtx_matrix_transposed_of(C),
+                      At = mtx_matrix_transposed_of(A),
+                      Bt = mtx_matrix_transposed_of(B);
+    _mtx_gemv(&Ct.matrix, alpha, &Bt.matrix, &At.matrix, beta);
+    return;
+  }
+
+  const size_t m = C->dy, k = A->dx;
+  mtx_gemv_job_t job = {.kernels = mtx_kernels(), .k = k};
+  double *x = NULL;
+  if (mtx_matrix_row_stride(B) == 1) {
+    job.x = &mtx_matrix_at(B, 0, 0);
+  } else {
+    x = (double *)_mtx_scratch_alloc(sizeof(double) * k);
+    for (size_t p = 0; p < k; ++p) {
+      x[p] = mtx_matrix_at(B, p, 0);
+    }
+    job.x = x;
+  }
+  job.t = (double *)_mtx_scratch_alloc(sizeof(double) * m);
+  job.a = &mtx_matrix_at(A, 0, 0);
+
+  const int parallel = (double)m * k >= MTX_GEMV_PARALLEL;
+  if (MTX_MATRIX_HAS_UNIT_COLUMNS(A)) {
+    job.lda = mtx_matrix_row_stride(A);
+    if (parallel) {
+      mtx_parallel_for(0, m, MTX_PARALLEL_ROWS_GRAIN(k), _mtx_gemv_rows_task,
+                       &job);
+    } else {
+      _mtx_gemv_rows_task(&job, 0, m);
+    }
+  } else if (mtx_matrix_row_stride(A) == 1) {
+    job.lda = mtx_matrix_col_stride(A);
+    memset(job.t, 0, sizeof(double) * m);
+    if (parallel) {
+      // Blocks of whole cache lines of t.
+      mtx_parallel_for(0, m, (MTX_PARALLEL_ROWS_GRAIN(k) + 7) / 8 * 8,
+                       _mtx_gemv_cols_task, &job);
+    } else {
+      _mtx_gemv_cols_task(&job, 0, m);
+    }
+  } else {
+    // Other strided views element by element.
+    for (size_t i = 0; i < m; ++i) {
+      double sum = 0;
+      for (size_t p = 0; p < k; ++p) {
+        sum += mtx_matrix_at(A, i, p) * job.x[p];
+      }
+      job.t[i] = sum;
+    }
+  }
+
+  for (size_t i = 0; i < m; ++i) {
+    double *c = &mtx_matrix_at(C, i, 0);
+    *c = beta == 0 ? alpha * job.t[i] : alpha * job.t[i] + beta * *c;
+  }
+
+  _mtx_scratch_free(job.t);
+  _mtx_scratch_free(x);
+}
+
+typedef struct mtx_gemm_job {
+  const mtx_kernels_t *kernels;
+  mtx_matrix_t *C;
+  const mtx_matrix_t *A, *B;
+  double alpha, beta;
+  double *Ap; // One packed block of A for each thread.
+  double *Bp;
+  size_t Ap_size;
+  int threads;
+  size_t m, jc, pc;
+  int nc, kc;
+} mtx_gemm_job_t;
+
+static void _mtx_gemm_pack_B_task(void *arg, size_t begin, size_t end) {
+  mtx_gemm_job_t *job = (mtx_gemm_job_t *)arg;
+  const int NR = job->kernels->gemm_nr;
+
+  int jr = begin * NR;
+  int nc = _min((int)end * NR, job->nc) - jr;
+  _mtx_pack_B(&job->Bp[jr * job->kc], job->B, job->pc, job->jc + jr, job->kc,
+              nc, NR);
+}
+
+static void _mtx_gemm_ic_task(void *arg, size_t begin, size_t end) {
+  mtx_gemm_job_t *job = (mtx_gemm_job_t *)arg;
+  int id = job->threads > 1 ? mtx_thread_id() : 0;
+  double *Ap = &job->Ap[id * job->Ap_size];
+
+  for (size_t block = begin; block < end; ++block) {
+    size_t ic = block * MC;
+    int mc = _min(MC, job->m - ic);
+    _mtx_pack_A(Ap, job->A, ic, job->pc, mc, job->kc, job->kernels->gemm_mr);
+    _mtx_gemm_macro_kernel(job->kernels, job->C, Ap, job->Bp, ic, job->jc, mc,
+                           job->nc, job->kc, job->alpha, job->beta,
+                           job->pc == 0);
+  }
+}
+
+// Runs the product on the backend's dgemm. Returns -1, without touching C,
+// when an operand can't be passed to it as a (transposed) row-major array.
+static int _mtx_gemm_backend(const mtx_blas_backend_t *backend,
+                             mtx_matrix_t *C, double alpha,
+                             const mtx_matrix_t *A, const mtx_matrix_t *B,
+                             double beta) {
+  int trans_A = 0, trans_B = 0;
+  int ldc = _mtx_backend_ld(C, 0);
+  int lda = _mtx_backend_ld(A, 0);
+  if (lda < 0) {
+    trans_A = 1;
+    lda = _mtx_backend_ld(A, 1);
+  }
+  int ldb = _mtx_backend_ld(B, 0);
+  if (ldb < 0) {
+    trans_B = 1;
+    ldb = _mtx_backend_ld(B, 1);
+  }
+  if (ldc < 0 || lda < 0 || ldb < 0) {
+    return -1;
+  }
+
+  backend->dgemm(CblasRowMajor, trans_A ? CblasTrans : CblasNoTrans,
+                 trans_B ? CblasTrans : CblasNoTrans, (int)C->dy, (int)C->dx,
+                 (int)A->dx, alpha, &mtx_matrix_at(A, 0, 0), lda,
+                 &mtx_matrix_at(B, 0, 0), ldb, beta, &mtx_matrix_at(C, 0, 0),
+                 ldc);
+  return 0;
+}
+
+void mtx_gemm(mtx_matrix_t *C, double alpha, const mtx_matrix_t *A,
+              const mtx_matrix_t *B, double beta) {
+  size_t m = C->dy, n = C->dx, k = A->dx;
+  double work = (double)m * n * k;
+
+  if (k == 0 || alpha == 0) {
+    _mtx_gemm_scale(C, beta);
+    return;
+  }
+  const mtx_blas_backend_t *backend = mtx_cfg_get_blas_backend();
+  if (backend != NULL && backend->dgemm != NULL && work > MTX_GEMM_SMALL &&
+      _mtx_gemm_backend(backend, C, alpha, A, B, beta) == 0) {
+    return;
+  }
+  if (m == 1 || n == 1) {
+    _mtx_gemv(C, alpha, A, B, beta);
+    return;
+  }
+  if (work <= MTX_GEMM_SMALL) {
+    _mtx_gemm_small(C, alpha, A, B, beta);
+    return;
+  }
+
+  mtx_gemm_job_t job = {.kernels = mtx_kernels(),
+                        .C = C,
+                        .A = A,
+                        .B = B,
+                        .alpha = alpha,
+                        .beta = beta,
+                        .m = m};
+  const int MR = job.kernels->gemm_mr, NR = job.kernels->gemm_nr;
+  job.threads = work >= MTX_GEMM_PARALLEL ? mtx_cfg_get_num_threads() : 1;
+
+  // Each thread's block of A starts at a cache line.
+  const size_t line = MTX_MATRIX_ALIGNMENT / sizeof(double);
+  int mc_max = _min(MC, m), kc_max = _min(KC, k), nc_max = _min(NC, n);
+  job.Ap_size = kc_max * ((mc_max + MR - 1) / MR * MR);
+  job.Ap_size = (job.Ap_size + line - 1) / line * line;
+  job.Ap = (double *)_mtx_scratch_alloc(sizeof(double) * job.Ap_size *
+                                        job.threads);
+  job.Bp = (double *)_mtx_scratch_alloc(sizeof(double) * kc_max *
+                                        ((nc_max + NR - 1) / NR * NR));
+
+  for (job.jc = 0; job.jc < n; job.jc += NC) {
+    job.nc = _min(NC, n - job.jc);
+    for (job.pc = 0; job.pc < k; job.pc += KC) {
+      job.kc = _min(KC, k - job.pc);
+
+      size_t B_panels = (job.nc + NR - 1) / NR;
+      size_t A_blocks = (m + MC - 1) / MC;
+      if (job.threads > 1) {
+        mtx_parallel_for(0, B_panels, 8, _mtx_gemm_pack_B_task, &job);
+        mtx_parallel_for(0, A_blocks, 1, _mtx_gemm_ic_task, &job);
+      } else {
+        _mtx_gemm_pack_B_task(&job, 0, B_panels);
+        _mtx_gemm_ic_task(&job, 0, A_blocks);
+      }
+    }
+  }
+
+  _mtx_scratch_free(job.Bp);
+  _mtx_scratch_free(job.Ap);
+}
+
+#undef MC
+#undef KC
+#undef NC
+#undef _min
@@ -0,0 +1,42 @@
+#ifndef MTX_GEMM_H
+#define MTX_GEMM_H
+
+#include "matrix.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Dimensões dos blocos empacotados: um bloco MC x KC de A deve caber na L2 e
+// um painel KC x NC de B na L3. Um micro-painel KC x NR de B cabe na L1. MC e
+// NC são múltiplos do MR e NR de todos os micro-kernels (ver simd.h).
+#define MTX_GEMM_MC 96
+#define MTX_GEMM_KC 256
+#define MTX_GEMM_NC 4096
+
+// Abaixo desse número de multiplicações (m * n * k) o custo de empacotar os
+// painéis não se paga e um loop simples por linhas é usado.
+#define MTX_GEMM_SMALL (48 * 48 * 48)
+
+// A partir desse número de multiplicações os blocos de A são distribuídos
+// entre as threads (ver threads.h).
+#define MTX_GEMM_PARALLEL (128 * 128 * 128)
+
+// A partir desse número de multiplicações (m * k) os produtos matriz-vetor
+// (C com uma única linha ou coluna) são divididos entre as threads.
+#define MTX_GEMV_PARALLEL (1 << 18)
+
+// Calcula C = alpha * A x B + beta * C (com beta == 0, C não é lido). A e B
+// podem ser views transpostas ou com passo. Não verifica dimensões nem
+// sobreposições: C não pode convergir com A ou B (use mtx_matrix_gemm()). Um
+// C com uma única linha ou coluna é calculado pelos kernels de GEMV. Com um
+// backend selecionado (ver backend.h), produtos maiores que MTX_GEMM_SMALL
+// vão para o seu dgemm.
+void mtx_gemm(mtx_matrix_t *C, double alpha, const mtx_matrix_t *A,
+              const mtx_matrix_t *B, double beta);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,22 +1,25 @@
 #include "linalg.h"
 #include "atomic_operations.h"
+#include "backend.h"
+#include "blas1.h"
 #include "errors.h"
+#include "gemm.h"
 #include "matrix.h"
 #include "matrix_operations.h"
+#include "threads.h"
+#include "workspace.h"
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
 
-void mtx_matrix_init_perm(mtx_matrix_perm_t *_M_PERM, int d) {
-  assert(d <= MTX_MATRIX_MAX_COLUMNS && d <= MTX_MATRIX_MAX_COLUMNS);
-
+void mtx_matrix_init_perm(mtx_matrix_perm_t *_M_PERM, size_t d) {
   mtx_matrix_init(_M_PERM, d, d);
   mtx_matrix_set_identity(_M_PERM);
 }
 
-static int _mtx_row_pivot(double *row, int start, int end) {
-  int r = -1;
-  for (int i = start; i < end; ++i) {
+static ptrdiff_t _mtx_row_pivot(double *row, size_t start, size_t end) {
+  ptrdiff_t r = -1;
+  for (size_t i = start; i < end; ++i) {
     if (row[i] != 0) {
       r = i;
       break;
@@ -26,73 +29,91 @@ static int _mtx_row_pivot(double *row, int start, int end) {
   return r;
 }
 
-// Swapa a row alocada toda de uma vez (swapando ponteiros)
-static void _mtx_row_swap_restrict(mtx_matrix_t *_M, int r1, int r2) {
+static void _mtx_row_swap(mtx_matrix_t *_M, size_t r1, size_t r2) {
   assert(r1 != r2);
-  assert(r1 >= 0 && r2 >= 0);
-  double *tmp = _M->data->m[r1];
-  _M->data->m[r1] = _M->data->m[r2];
-  _M->data->m[r2] = tmp;
-}
-
-static void _mtx_row_swap(mtx_matrix_t *_M, int r1, int r2) {
-  assert(r1 != r2);
-  assert(r1 >= 0 && r2 >= 0);
-
-  // Caso matriz não seja view ou seja uma view que contemple uma row alocada
-  // inteira.
-  if (_M->dx == _M->data->size2) {
-    _mtx_row_swap_restrict(_M, r1, r2);
-    return;
-  }
 
   // Swapa elemento por elemento da linha.
   double tmp;
   double *row1 = mtx_matrix_row(_M, r1);
   double *row2 = mtx_matrix_row(_M, r2);
-  for (int i = 0; i < _M->dx; ++i) {
+  for (size_t i = 0; i < _M->dx; ++i) {
     tmp = row1[i];
     row1[i] = row2[i];
     row2[i] = tmp;
   }
 }
 
-static inline void _mtx_row_copy(double *r_to, double *r_from, int count) {
-  if (r_to != r_from) {
-    memcpy(r_to, r_from, sizeof(double) * count);
+// Move a linha index[i] de _M para a linha i, seguindo os ciclos da permutação
+// com swaps de linhas.
+static void _mtx_rows_permute(mtx_matrix_t *_M, const size_t *index) {
+  for (size_t i = 0; i < _M->dy; ++i) {
+    size_t k = index[i];
+    while (k < i) {
+      k = index[k];
+    }
+    if (k != i) {
+      _mtx_row_swap(_M, i, k);
+    }
   }
 }
 
-static inline void _mtx_row_mul(double *r, double mul, int count) {
-  for (int i = 0; i < count; ++i) {
-    r[i] *= mul;
+static inline void _mtx_row_copy(double *r_to, double *r_from, size_t count) {
+  if (r_to != r_from) {
+    memcpy(r_to, r_from, sizeof(double) * count);
   }
 }
-static inline void _mtx_sum_multiple(double *r, double *mul_r, double mul,
-                                     int start, int end) {
-  // r[init_pos] = 0;
-  for (int i = start; i < end; ++i) {
-    r[i] += mul_r[i] * mul;
+
+// The rows of the decomposition are accessed through row_index: the row i is
+// stored at the row row_index[i] of lu.
+typedef struct mtx_LU_reduce_job {
+  double *lu;
+  ptrdiff_t ld;
+  size_t dx, dy;
+  const size_t *row_index;
+  ptrdiff_t *row_pivot;
+  size_t p;
+  double pp;
+} mtx_LU_reduce_job_t;
+
+// Reduces the rows [begin, end) below the pivot p of a perfect decomposition
+// and recalculates their pivots. A row left all zeroes gets pivot -1.
+static void _mtx_LU_reduce_task(void *arg, size_t begin, size_t end) {
+  mtx_LU_reduce_job_t *job = (mtx_LU_reduce_job_t *)arg;
+  size_t p = job->p;
+  double *row_p = &job->lu[(ptrdiff_t)job->row_index[p] * job->ld];
+
+  for (size_t ic = begin; ic < end; ++ic) {
+    double *row = &job->lu[(ptrdiff_t)job->row_index[ic] * job->ld];
+    if (row[p] == 0) {
+      continue;
+    }
+
+    double mul = row[p] / job->pp;
+    row[p] = mul;
+    _mtx_axpy(job->dx - p - 1, -mul, &row_p[p + 1], 1, &row[p + 1], 1);
+    job->row_pivot[ic] = _mtx_row_pivot(row, p + 1, job->dy);
   }
 }
 
 #define PIVOT(i) row_pivot[(i)]
 
+#define LU_ROW(i) (&lu[(ptrdiff_t)row_index[(i)] * ld])
+#define LU_AT(i, j) LU_ROW(i)[(j)]
+
 #define ROW_ECHELON(r) ((r) > last_w_row || row_pivot[(r)] == (r))
 #define SWAP(r1, r2)                                                           \
-  _mtx_row_swap(_M_LU, (r1), (r2));                                            \
-  if (permutate) {                                                             \
-    _mtx_row_swap(__M_PERM, (r1), (r2));                                       \
-  }                                                                            \
+  size_t _index = row_index[(r1)];                                             \
+  row_index[(r1)] = row_index[(r2)];                                           \
+  row_index[(r2)] = _index;                                                    \
   odd_swaps = !odd_swaps;                                                      \
-  int _pivot = PIVOT((r1));                                                    \
+  ptrdiff_t _pivot = PIVOT((r1));                                              \
   row_pivot[(r1)] = PIVOT((r2));                                               \
   row_pivot[(r2)] = _pivot;
 
 // Recalcular o valor do pivot. Retorna erro caso seja toda zerada ou o pivot
 // não corresponder a uma coluna válida (caso dx > dy).
 #define SET_PIVOT_perf(i, start)                                               \
-  if ((row_pivot[(i)] = _mtx_row_pivot(mtx_matrix_row(_M_LU, (i)), (start),    \
+  if ((row_pivot[(i)] = _mtx_row_pivot(LU_ROW((i)), (start),                   \
                                        _M_LU->dy)) < 0) {                      \
     return -1;                                                                 \
   }
@@ -103,7 +124,7 @@ static inline void _mtx_sum_multiple(double *r, double *mul_r, double mul,
 // última linha não zerada. Retorna erro se o pivot não corresponder a uma
 // coluna válida (caso dx > dy).
 #define SET_PIVOT(i, start)                                                    \
-  if ((row_pivot[(i)] = _mtx_row_pivot(mtx_matrix_row(_M_LU, (i)), (start),    \
+  if ((row_pivot[(i)] = _mtx_row_pivot(LU_ROW((i)), (start),                   \
                                        _M_LU->dx)) < 0) {                      \
     if ((i) == last_w_row) {                                                   \
       --last_w_row;                                                            \
@@ -117,9 +138,9 @@ static inline void _mtx_sum_multiple(double *r, double *mul_r, double mul,
 
 #define SET_PIVOT_INIT(i)                                                      \
   while ((row_pivot[(i)] =                                                     \
-              _mtx_row_pivot(_M_LU->data->m[(i)], 0, _M_LU->dx)) < 0) {        \
+              _mtx_row_pivot(LU_ROW(i), 0, _M_LU->dx)) < 0) {                  \
     row_pivot[last_w_row] =                                                    \
-        _mtx_row_pivot(_M_LU->data->m[last_w_row], 0, _M_LU->dx);              \
+        _mtx_row_pivot(LU_ROW(last_w_row), 0, _M_LU->dx);                      \
     if (i == last_w_row) {                                                     \
       --last_w_row;                                                            \
       break;                                                                   \
@@ -131,60 +152,33 @@ static inline void _mtx_sum_multiple(double *r, double *mul_r, double mul,
     return -1;                                                                 \
   }
 
-int mtx_linalg_LU_decomposition(mtx_matrix_perm_t *__M_PERM,
-                                mtx_matrix_t *_M_LU, const mtx_matrix_t *M,
-                                int perfect) {
-  MTX_ENSURE_INIT(M);
-  // caso perfect == true, linhas zeradas serão consideradas erro. Com dx <
-  // dy, isso inevitavelmente ocorrerá.
-  if (perfect && M->dx < M->dy) {
-    return -1;
-  }
-
-  if (_M_LU->data == NULL) {
-    mtx_matrix_clone(_M_LU, M);
-  } else if (!MTX_MATRIX_ARE_SAME(_M_LU, M)) {
-    mtx_matrix_copy(_M_LU, M);
-  }
-
-  int permutate = 0;
-  if (__M_PERM != NULL) {
-    permutate = 1;
-    if (__M_PERM->data == NULL) {
-      mtx_matrix_init_perm(__M_PERM, _M_LU->dy);
-    } else if (!MTX_MATRIX_OVERLAP(__M_PERM, _M_LU) &&
-               MTX_MATRIX_IS_SQUARE(__M_PERM) && __M_PERM->dy == _M_LU->dy) {
-      mtx_matrix_set_identity(__M_PERM);
-    } else {
-      MTX_INVALID_ERR(__M_PERM);
-    }
-  }
-
+// Decompõe _M_LU em LU com os swaps de linhas feitos somente nos índices: a
+// linha i da decomposição está na linha row_index[i] de _M_LU. Retorna -1 caso
+// a decomposição falhe ou a paridade do número de swaps.
+static int _mtx_LU_factor(mtx_matrix_t *_M_LU, int perfect, size_t *row_index,
+                          ptrdiff_t *row_pivot) {
   // 0 se número de swaps é par e 1 se for ímpar.
   int odd_swaps = 0;
 
-  // O pivot de cada linha é armazenado para não ter que calcular toda vez.
-
-  int row_pivot[MTX_MATRIX_MAX_ROWS];
+  double *lu = mtx_matrix_row(_M_LU, 0);
+  ptrdiff_t ld = mtx_matrix_row_stride(_M_LU);
 
   // A última linha que faz sentido processar com swaps ou com somas (depois
   // dela vem as linhas zeradas ou nada).
-  int last_w_row = _M_LU->dy - 1;
-
-  int pivot;
+  ptrdiff_t last_w_row = _M_LU->dy - 1;
 
   if (!perfect) {
-    for (int i = 0; i <= last_w_row; ++i) {
+    for (ptrdiff_t i = 0; i <= last_w_row; ++i) {
       SET_PIVOT_INIT(i);
     }
   } else {
-    for (int i = 0; i <= last_w_row; ++i) {
+    for (ptrdiff_t i = 0; i <= last_w_row; ++i) {
       SET_PIVOT_INIT_perf(i);
     }
   }
 
-  for (int p = 0; p <= last_w_row; ++p) {
-    int pivot;
+  for (ptrdiff_t p = 0; p <= last_w_row; ++p) {
+    ptrdiff_t pivot;
     while ((pivot = PIVOT(p)) > p) {
 
       // Swapa os números da linha atual com a linha que eles deveriam estar
@@ -196,7 +190,7 @@ int mtx_linalg_LU_decomposition(mtx_matrix_perm_t *__M_PERM,
 
       // Swapa com qualquer outra linha que faça sentido (que vá resolver ou
       // mover o pivot para antes da diagonal)
-      int pn;
+      ptrdiff_t pn;
       for (pn = p + 1; pn <= last_w_row; ++pn) {
         if (ROW_ECHELON(pn)) {
           continue;
@@ -217,12 +211,12 @@ int mtx_linalg_LU_decomposition(mtx_matrix_perm_t *__M_PERM,
 
     // Garantir que o pivot seja o maior número em módulo da coluna para
     // aumentar a precisão dos cálculos.
-    double pp = mtx_matrix_at(_M_LU, p, p);
+    double pp = LU_AT(p, p);
     double max = _mod(pp);
-    int i_max = p;
+    ptrdiff_t i_max = p;
 
-    for (int ic = p + 1; ic <= last_w_row; ++ic) {
-      double mod_pivc = _mod(mtx_matrix_at(_M_LU, ic, p));
+    for (ptrdiff_t ic = p + 1; ic <= last_w_row; ++ic) {
+      double mod_pivc = _mod(LU_AT(ic, p));
       if (mod_pivc > max) {
         i_max = ic;
         max = mod_pivc;
@@ -230,23 +224,46 @@ int mtx_linalg_LU_decomposition(mtx_matrix_perm_t *__M_PERM,
     }
     if (i_max != p) {
       SWAP(p, i_max);
-      pp = mtx_matrix_at(_M_LU, p, p);
+      pp = LU_AT(p, p);
+    }
+
+    // Com perfect, as linhas abaixo são independentes e podem ser reduzidas
+    // em paralelo.
+    if (perfect && (size_t)(last_w_row - p) * (_M_LU->dx - p) >=
+                       MTX_PARALLEL_MIN_ELEMENTS) {
+      mtx_LU_reduce_job_t job = {.lu = lu,
+                                 .ld = ld,
+                                 .dx = _M_LU->dx,
+                                 .dy = _M_LU->dy,
+                                 .row_index = row_index,
+                                 .row_pivot = row_pivot,
+                                 .p = p,
+                                 .pp = pp};
+      mtx_parallel_for(p + 1, last_w_row + 1,
+                       MTX_PARALLEL_ROWS_GRAIN(_M_LU->dx - p),
+                       _mtx_LU_reduce_task, &job);
+      for (ptrdiff_t ic = p + 1; ic <= last_w_row; ++ic) {
+        if (PIVOT(ic) < 0) {
+          return -1;
+        }
+      }
+      continue;
     }
 
     // Reduz todas as linhas abaixo, substituindo todos os valores na mesma
     // coluna do pivot.
-    for (int ic = p + 1; ic <= last_w_row; ++ic) {
-      double ip = mtx_matrix_at(_M_LU, ic, p);
+    for (ptrdiff_t ic = p + 1; ic <= last_w_row; ++ic) {
+      double ip = LU_AT(ic, p);
 
       if (ip == 0) {
         continue;
       }
 
       double mul = ip / pp; // abs(pp) >= abs(ip)
-      mtx_matrix_at(_M_LU, ic, p) = mul;
+      LU_AT(ic, p) = mul;
 
-      _mtx_sum_multiple(mtx_matrix_row(_M_LU, ic), mtx_matrix_row(_M_LU, p),
-                        -mul, p + 1, _M_LU->dx);
+      _mtx_axpy(_M_LU->dx - p - 1, -mul, &LU_AT(p, p + 1), 1,
+                &LU_AT(ic, p + 1), 1);
 
       if (!perfect) {
         SET_PIVOT(ic, p + 1);
@@ -259,12 +276,213 @@ int mtx_linalg_LU_decomposition(mtx_matrix_perm_t *__M_PERM,
   return odd_swaps;
 }
 
+// Reduces the rows [begin, end) below the pivot j of a panel of the blocked
+// decomposition, up to the last column of the panel.
+typedef struct mtx_LU_panel_job {
+  double *lu;
+  ptrdiff_t ld;
+  size_t j, end;
+} mtx_LU_panel_job_t;
+
+static void _mtx_LU_panel_task(void *arg, size_t begin, size_t end) {
+  mtx_LU_panel_job_t *job = (mtx_LU_panel_job_t *)arg;
+  size_t j = job->j;
+  const double *row_j = &job->lu[(ptrdiff_t)j * job->ld];
+
+  for (size_t i = begin; i < end; ++i) {
+    double *row = &job->lu[(ptrdiff_t)i * job->ld];
+    if (row[j] == 0) {
+      continue;
+    }
+
+    double mul = row[j] / row_j[j];
+    row[j] = mul;
+    _mtx_axpy(job->end - j - 1, -mul, &row_j[j + 1], 1, &row[j + 1], 1);
+  }
+}
+
+#define BLK_AT(i, j) lu[(ptrdiff_t)(i) * ld + (j)]
+
+// Decompõe _M_LU (quadrada) em painéis de MTX_LU_NB colunas, com pivoteamento
+// parcial: cada painel é decomposto coluna a coluna, as linhas do painel à
+// direita dele são resolvidas com o seu L (diagonal de 1's) e o resto da
+// matriz é atualizado com um GEMM. Os swaps são feitos nas linhas inteiras e
+// registrados em row_index. Retorna -1 caso a matriz seja singular ou a
+// paridade do número de swaps.
+static int _mtx_LU_blocked(mtx_matrix_t *_M_LU, size_t *row_index) {
+  // 0 se número de swaps é par e 1 se for ímpar.
+  int odd_swaps = 0;
+
+  size_t n = _M_LU->dy;
+  double *lu = mtx_matrix_row(_M_LU, 0);
+  ptrdiff_t ld = mtx_matrix_row_stride(_M_LU);
+
+  for (size_t k = 0; k < n; k += MTX_LU_NB) {
+    size_t end = n - k < MTX_LU_NB ? n : k + MTX_LU_NB;
+
+    // Painel: colunas [k, end) das linhas [k, n).
+    for (size_t j = k; j < end; ++j) {
+      size_t p = j + _mtx_iamax(n - j, &BLK_AT(j, j), ld);
+      if (BLK_AT(p, j) == 0) {
+        return -1;
+      }
+      if (p != j) {
+        _mtx_row_swap(_M_LU, j, p);
+        size_t tmp = row_index[j];
+        row_index[j] = row_index[p];
+        row_index[p] = tmp;
+        odd_swaps = !odd_swaps;
+      }
+
+      mtx_LU_panel_job_t job = {.lu = lu, .ld = ld, .j = j, .end = end};
+      if ((n - j - 1) * (end - j) >= MTX_PARALLEL_MIN_ELEMENTS) {
+        mtx_parallel_for(j + 1, n, MTX_PARALLEL_ROWS_GRAIN(end - j),
+                         _mtx_LU_panel_task, &job);
+      } else {
+        _mtx_LU_panel_task(&job, j + 1, n);
+      }
+    }
+    if (end == n) {
+      break;
+    }
+
+    // U12 = L11^-1 A12.
+    for (size_t i = k + 1; i < end; ++i) {
+      for (size_t j = k; j < i; ++j) {
+        _mtx_axpy(n - end, -BLK_AT(i, j), &BLK_AT(j, end), 1, &BLK_AT(i, end),
+                  1);
+      }
+    }
+
+    // A22 -= L21 U12.
+    mtx_matrix_view_t L21 = mtx_matrix_view_of(_M_LU, end, k, n - end, end - k);
+    mtx_matrix_view_t U12 = mtx_matrix_view_of(_M_LU, k, end, end - k, n - end);
+    mtx_matrix_view_t A22 =
+        mtx_matrix_view_of(_M_LU, end, end, n - end, n - end);
+    mtx_gemm(&A22.matrix, -1, &L21.matrix, &U12.matrix, 1);
+  }
+
+  return odd_swaps;
+}
+
+#undef BLK_AT
+
+// Decompõe _M_LU (quadrada) com o dgetrf do backend, sobre a transposta de
+// _M_LU (que é _M_LU em column-major). A decomposição já volta com as linhas
+// na ordem final, cuja origem é salva em row_index a partir dos swaps de ipiv.
+// Retorna -1 caso a matriz seja singular ou a paridade do número de swaps.
+static int _mtx_LU_backend(const mtx_blas_backend_t *backend,
+                           mtx_matrix_t *_M_LU, size_t *row_index) {
+  int n = (int)_M_LU->dy;
+  mtx_matrix_t T;
+  mtx_matrix_init_scratch(&T, n, n);
+  mtx_matrix_transpose(&T, _M_LU);
+
+  int *ipiv = (int *)_mtx_scratch_alloc(sizeof(int) * n);
+  int ld = (int)T.data->ld;
+  int info;
+  backend->dgetrf(&n, &n, mtx_matrix_row(&T, 0), &ld, ipiv, &info);
+
+  int odd_swaps = -1;
+  if (info == 0) {
+    mtx_matrix_transpose(_M_LU, &T);
+    odd_swaps = 0;
+    for (int i = 0; i < n; ++i) {
+      size_t swap = ipiv[i] - 1;
+      if (swap != (size_t)i) {
+        size_t tmp = row_index[i];
+        row_index[i] = row_index[swap];
+        row_index[swap] = tmp;
+        odd_swaps ^= 1;
+      }
+    }
+  }
+
+  _mtx_scratch_free(ipiv);
+  mtx_matrix_free(&T);
+
+  return odd_swaps;
+}
+
+int mtx_linalg_LU_decomposition(mtx_matrix_perm_t *__M_PERM,
+                                mtx_matrix_t *_M_LU, const mtx_matrix_t *M,
+                                int perfect) {
+  MTX_ENSURE_INIT(M);
+  // caso perfect == true, linhas zeradas serão consideradas erro. Com dx <
+  // dy, isso inevitavelmente ocorrerá.
+  if (perfect && M->dx < M->dy) {
+    return -1;
+  }
+
+  if (_M_LU->data == NULL) {
+    mtx_matrix_clone(_M_LU, M);
+  } else {
+    MTX_ENSURE_UNIT_COLUMNS(_M_LU);
+    if (!MTX_MATRIX_ARE_SAME(_M_LU, M)) {
+      mtx_matrix_copy(_M_LU, M);
+    }
+  }
+
+  int permutate = 0;
+  if (__M_PERM != NULL) {
+    permutate = 1;
+    if (__M_PERM->data == NULL) {
+      mtx_matrix_init_perm(__M_PERM, _M_LU->dy);
+    } else if (!MTX_MATRIX_OVERLAP(__M_PERM, _M_LU) &&
+               MTX_MATRIX_IS_SQUARE(__M_PERM) && __M_PERM->dy == _M_LU->dy) {
+      mtx_matrix_set_identity(__M_PERM);
+    } else {
+      MTX_INVALID_ERR(__M_PERM);
+    }
+  }
+
+  size_t *row_index =
+      (size_t *)_mtx_scratch_alloc(sizeof(size_t) * _M_LU->dy);
+  // O pivot de cada linha é armazenado para não ter que calcular toda vez.
+  ptrdiff_t *row_pivot =
+      (ptrdiff_t *)_mtx_scratch_alloc(sizeof(ptrdiff_t) * _M_LU->dy);
+  for (size_t i = 0; i < _M_LU->dy; ++i) {
+    row_index[i] = i;
+  }
+
+  int odd_swaps;
+  const mtx_blas_backend_t *backend = mtx_cfg_get_blas_backend();
+  if (perfect && backend != NULL && backend->dgetrf != NULL &&
+      MTX_MATRIX_IS_SQUARE(_M_LU) && _mtx_backend_ld(_M_LU, 0) >= 0) {
+    odd_swaps = _mtx_LU_backend(backend, _M_LU, row_index);
+  } else if (perfect && MTX_MATRIX_IS_SQUARE(_M_LU)) {
+    odd_swaps = _mtx_LU_blocked(_M_LU, row_index);
+  } else {
+    odd_swaps = _mtx_LU_factor(_M_LU, perfect, row_index, row_pivot);
+    // A permutação é aplicada a _M_LU somente no final.
+    if (odd_swaps >= 0) {
+      _mtx_rows_permute(_M_LU, row_index);
+    }
+  }
+
+  if (odd_swaps >= 0) {
+    if (permutate) {
+      for (size_t i = 0; i < __M_PERM->dy; ++i) {
+        mtx_matrix_at(__M_PERM, i, i) = 0;
+        mtx_matrix_at(__M_PERM, i, row_index[i]) = 1;
+      }
+    }
+  }
+
+  _mtx_scratch_free(row_pivot);
+  _mtx_scratch_free(row_index);
+
+  return odd_swaps;
+}
+
 #undef DEF_ECH
 #undef PIVOT
 #undef ROW_ECHELON
 #undef SWAP
 #undef SET_PIVOT
 #undef SET_PIVOT_perf
+#undef LU_ROW
+#undef LU_AT
 
 int mtx_linalg_permutate(mtx_matrix_t *_M, const mtx_matrix_t *M,
                          const mtx_matrix_perm_t *M_PERM) {
@@ -283,16 +501,19 @@ int mtx_linalg_permutate(mtx_matrix_t *_M, const mtx_matrix_t *M,
   if (!MTX_MATRIX_SAME_DIMENSIONS(_M, M)) {
     MTX_DIMEN_ERR(_M);
   }
+  MTX_ENSURE_UNIT_COLUMNS(_M);
+  MTX_ENSURE_UNIT_COLUMNS(M);
+  MTX_ENSURE_UNIT_COLUMNS(M_PERM);
 
   MTX_MAKE_OUTPUT_ALIAS(permutated, _M);
 
   MTX_ENSURE_SAFE_OUTPUT(permutated, _M, M);
   MTX_ENSURE_SAFE_OUTPUT(permutated, _M, M_PERM);
 
-  int pivot;
-  int lower_pivot = 0;
-  int higher_pivot = M_PERM->dx - 1;
-  for (int i = 0; i < M_PERM->dy; ++i) {
+  ptrdiff_t pivot;
+  ptrdiff_t lower_pivot = 0;
+  ptrdiff_t higher_pivot = M_PERM->dx - 1;
+  for (size_t i = 0; i < M_PERM->dy; ++i) {
     pivot = _mtx_row_pivot(mtx_matrix_row(M_PERM, i), lower_pivot,
                            higher_pivot + 1);
     if (pivot == lower_pivot) {
@@ -315,7 +536,7 @@ double mtx_linalg_det_LU(const mtx_matrix_t *M_LU, int signum) {
   double det = 1;
   if (signum >= 0) {
 
-    for (int p = 0; p < M_LU->dy; ++p) {
+    for (size_t p = 0; p < M_LU->dy; ++p) {
       det *= mtx_matrix_at(M_LU, p, p);
     }
 
@@ -335,7 +556,8 @@ double mtx_matrix_det(const mtx_matrix_t *M) {
     MTX_DIMEN_ERR(M);
   }
 
-  mtx_matrix_t lu = {0};
+  mtx_matrix_t lu;
+  mtx_matrix_init_scratch(&lu, M->dy, M->dx);
 
   int signum = mtx_linalg_LU_decomp_perf(NULL, &lu, M);
   double det = mtx_linalg_det_LU(&lu, signum);
@@ -344,6 +566,29 @@ double mtx_matrix_det(const mtx_matrix_t *M) {
   return det;
 }
 
+// Resolve T x = B, sendo T quadrada e triangular (uplo), com o dtrsm do
+// backend: B é copiada para x, que é resolvida no lugar. Retorna -1, sem fazer
+// nada, caso T ou x não possam ser passadas a ele ou x se sobreponha a T.
+static int _mtx_subs_backend(const mtx_blas_backend_t *backend,
+                             mtx_matrix_t *x, const mtx_matrix_t *T,
+                             const mtx_matrix_t *B, enum CBLAS_UPLO uplo,
+                             int jordan) {
+  int ldt = _mtx_backend_ld(T, 0);
+  int ldx = _mtx_backend_ld(x, 0);
+  if (ldt < 0 || ldx < 0 || MTX_MATRIX_OVERLAP(x, T)) {
+    return -1;
+  }
+
+  if (!MTX_MATRIX_ARE_SAME(x, B)) {
+    mtx_matrix_copy(x, B);
+  }
+  backend->dtrsm(CblasRowMajor, CblasLeft, uplo, CblasNoTrans,
+                 jordan ? CblasUnit : CblasNonUnit, (int)x->dy, (int)x->dx,
+                 1.0, &mtx_matrix_at(T, 0, 0), ldt, &mtx_matrix_at(x, 0, 0),
+                 ldx);
+  return 0;
+}
+
 int mtx_linalg_back_subs(mtx_matrix_t *_X, const mtx_matrix_t *U,
                          const mtx_matrix_t *B, int jordan) {
   MTX_ENSURE_INIT(U);
@@ -352,9 +597,9 @@ int mtx_linalg_back_subs(mtx_matrix_t *_X, const mtx_matrix_t *U,
     MTX_DIMEN_ERR(U);
   }
 
-  int dx = U->dx;
-  int dy = U->dy;
-  int var_num = dx;
+  size_t dx = U->dx;
+  size_t dy = U->dy;
+  size_t var_num = dx;
 
   // Sistema indeterminado
   if (mtx_matrix_at(U, dy - 1, dx - 1) == 0) {
@@ -366,6 +611,9 @@ int mtx_linalg_back_subs(mtx_matrix_t *_X, const mtx_matrix_t *U,
   } else if (!MTX_MATRIX_SAME_DIMENSIONS(_X, B)) {
     MTX_DIMEN_ERR(_X);
   }
+  MTX_ENSURE_UNIT_COLUMNS(_X);
+  MTX_ENSURE_UNIT_COLUMNS(U);
+  MTX_ENSURE_UNIT_COLUMNS(B);
 
   MTX_MAKE_OUTPUT_ALIAS(x, _X);
 
@@ -374,23 +622,45 @@ int mtx_linalg_back_subs(mtx_matrix_t *_X, const mtx_matrix_t *U,
   MTX_ENSURE_SAFE_OUTPUT_RULES(
       x, _X, U, (MTX_MATRIX_OVERLAP(_X, U) && (_X->offY <= U->offY)));
 
+  const mtx_blas_backend_t *backend = mtx_cfg_get_blas_backend();
+  if (backend != NULL && backend->dtrsm != NULL &&
+      _mtx_subs_backend(backend, &x, U, B, CblasUpper, jordan) == 0) {
+    MTX_COMMIT_OUTPUT(x, _X);
+    return 0;
+  }
+
+  // Uma única coluna é resolvida com produtos escalares contra a parte já
+  // resolvida de x, mantida contígua em xs.
+  double *xs = x.dx == 1
+                   ? (double *)_mtx_scratch_alloc(sizeof(double) * var_num)
+                   : NULL;
+
   double *U_i;
   double *X_i;
-  for (int i = var_num - 1; i >= 0; --i) {
+  for (size_t i = var_num; i-- > 0;) {
     U_i = mtx_matrix_row(U, i);
     X_i = mtx_matrix_row(&x, i);
 
+    if (xs != NULL) {
+      double xi = mtx_matrix_at(B, i, 0) -
+                  _mtx_dot(var_num - i - 1, &U_i[i + 1], 1, &xs[i + 1], 1);
+      xs[i] = X_i[0] = jordan ? xi : xi * (1.0 / U_i[i]);
+      continue;
+    }
+
     _mtx_row_copy(X_i, mtx_matrix_row(B, i), x.dx);
-    for (int j = i + 1; j < var_num; ++j) {
-      _mtx_sum_multiple(X_i, mtx_matrix_row(&x, j), -U_i[j], 0, x.dx);
+    for (size_t j = i + 1; j < var_num; ++j) {
+      _mtx_axpy(x.dx, -U_i[j], mtx_matrix_row(&x, j), 1, X_i, 1);
     }
 
     if (!jordan) {
       double pivot = U_i[i];
-      _mtx_row_mul(mtx_matrix_row(&x, i), 1.0 / pivot, x.dx);
+      _mtx_scal(x.dx, 1.0 / pivot, X_i, 1);
     }
   }
 
+  _mtx_scratch_free(xs);
+
   MTX_COMMIT_OUTPUT(x, _X);
 
   return 0;
@@ -409,10 +679,13 @@ int mtx_linalg_forward_subs(mtx_matrix_t *_X, const mtx_matrix_t *L,
   } else if (!MTX_MATRIX_SAME_DIMENSIONS(_X, B)) {
     MTX_DIMEN_ERR(_X);
   }
+  MTX_ENSURE_UNIT_COLUMNS(_X);
+  MTX_ENSURE_UNIT_COLUMNS(L);
+  MTX_ENSURE_UNIT_COLUMNS(B);
 
-  int dx = L->dx;
-  int dy = L->dy;
-  int var_num = dx;
+  size_t dx = L->dx;
+  size_t dy = L->dy;
+  size_t var_num = dx;
 
   // Sistema indeterminado
   if (var_num > dy || mtx_matrix_at(L, var_num - 1, var_num - 1) == 0) {
@@ -427,34 +700,60 @@ int mtx_linalg_forward_subs(mtx_matrix_t *_X, const mtx_matrix_t *L,
   MTX_ENSURE_SAFE_OUTPUT_RULES(
       x, _X, L, (MTX_MATRIX_OVERLAP(_X, L) && (_X->offY >= L->offY)));
 
+  const mtx_blas_backend_t *backend = mtx_cfg_get_blas_backend();
+  if (backend != NULL && backend->dtrsm != NULL && var_num == dy &&
+      _mtx_subs_backend(backend, &x, L, B, CblasLower, jordan) == 0) {
+    MTX_COMMIT_OUTPUT(x, _X);
+    return 0;
+  }
+
+  // Uma única coluna é resolvida com produtos escalares contra a parte já
+  // resolvida de x, mantida contígua em xs.
+  double *xs = x.dx == 1
+                   ? (double *)_mtx_scratch_alloc(sizeof(double) * var_num)
+                   : NULL;
+
   double *L_i;
   double *X_i;
-  for (int i = 0; i < var_num; ++i) {
+  for (size_t i = 0; i < var_num; ++i) {
     L_i = mtx_matrix_row(L, i);
     X_i = mtx_matrix_row(&x, i);
 
+    if (xs != NULL) {
+      double xi = mtx_matrix_at(B, i, 0) - _mtx_dot(i, L_i, 1, xs, 1);
+      xs[i] = X_i[0] = jordan ? xi : xi * (1.0 / L_i[i]);
+      continue;
+    }
+
     _mtx_row_copy(X_i, mtx_matrix_row(B, i), x.dx);
-    for (int j = 0; j < i; ++j) {
-      _mtx_sum_multiple(X_i, mtx_matrix_row(&x, j), -L_i[j], 0, x.dx);
+    for (size_t j = 0; j < i; ++j) {
+      _mtx_axpy(x.dx, -L_i[j], mtx_matrix_row(&x, j), 1, X_i, 1);
     }
 
     if (!jordan) {
       double diagn = L_i[i];
-      _mtx_row_mul(mtx_matrix_row(&x, i), 1.0 / diagn, x.dx);
+      _mtx_scal(x.dx, 1.0 / diagn, X_i, 1);
     }
   }
 
   // Caso dy > dx, continua a substituir os elementos abaixo.
-  for (int i = var_num; i < L->dy; ++i) {
+  for (size_t i = var_num; i < L->dy; ++i) {
     L_i = mtx_matrix_row(L, i);
     X_i = mtx_matrix_row(&x, i);
 
+    if (xs != NULL) {
+      X_i[0] = mtx_matrix_at(B, i, 0) - _mtx_dot(L->dx, L_i, 1, xs, 1);
+      continue;
+    }
+
     _mtx_row_copy(X_i, mtx_matrix_row(B, i), x.dx);
-    for (int j = 0; j < L->dx; ++j) {
-      _mtx_sum_multiple(X_i, mtx_matrix_row(&x, j), -L_i[j], 0, x.dx);
+    for (size_t j = 0; j < L->dx; ++j) {
+      _mtx_axpy(x.dx, -L_i[j], mtx_matrix_row(&x, j), 1, X_i, 1);
     }
   }
 
+  _mtx_scratch_free(xs);
+
   MTX_COMMIT_OUTPUT(x, _X);
 
   return 0;
@@ -464,17 +763,17 @@ int mtx_linalg_LU_AB_solve(mtx_matrix_t *X, const mtx_matrix_t *AB_LU) {
 
   MTX_ENSURE_INIT(AB_LU);
   MTX_ENSURE_INIT(X);
-  int var_num = AB_LU->dx - X->dx;
-  if (var_num < 1 || X->dy < var_num) {
+  if (AB_LU->dx <= X->dx || X->dy < AB_LU->dx - X->dx) {
     MTX_BOUNDS_ERR(X);
   }
+  size_t var_num = AB_LU->dx - X->dx;
 
   mtx_matrix_view_t B = mtx_matrix_view_of(AB_LU, 0, var_num, AB_LU->dy, X->dx);
 
   // Sistema impossível
   if (AB_LU->dy > var_num) {
-    for (int bi = var_num; bi < B.matrix.dy; ++bi) {
-      for (int bj = 0; bj < B.matrix.dx; ++bj) {
+    for (size_t bi = var_num; bi < B.matrix.dy; ++bi) {
+      for (size_t bj = 0; bj < B.matrix.dx; ++bj) {
         if (mtx_matrix_at(&B.matrix, bi, bj) != 0) {
           return 1;
         }
@@ -521,9 +820,20 @@ double mtx_linalg_LU_refine(mtx_matrix_t *_M_WORK, mtx_matrix_t *X,
                             const mtx_matrix_t *A_LU, const mtx_matrix_t *A,
                             const mtx_matrix_t *B) {
 
-  mtx_matrix_mul(_M_WORK, A, X);
-  double dt;
-  if ((dt = mtx_matrix_distance_each(_M_WORK, _M_WORK, B)) == 0) {
+  // Residual A x X - B accumulated on a copy of B.
+  if (_M_WORK->data == NULL) {
+    mtx_matrix_clone(_M_WORK, B);
+  } else {
+    mtx_matrix_copy(_M_WORK, B);
+  }
+  mtx_matrix_gemm(MTX_NO_TRANS, MTX_NO_TRANS, 1, A, X, -1, _M_WORK);
+
+  double dt = 0;
+  for (size_t i = 0; i < _M_WORK->dy; ++i) {
+    dt += _mtx_asum(_M_WORK->dx, &mtx_matrix_at(_M_WORK, i, 0),
+                    mtx_matrix_col_stride(_M_WORK));
+  }
+  if (dt == 0) {
     return 0;
   }
 
@@ -11,8 +11,13 @@ typedef mtx_matrix_t mtx_matrix_perm_t;
 
 // TODO: Rewrite the header and source documentation to english.
 
+// Largura dos painéis da decomposição LU blocada (perfect == 1 e matriz
+// quadrada): as colunas de cada painel são reduzidas uma a uma e o resto da
+// matriz é atualizado de uma vez com GEMM (ver gemm.h).
+#define MTX_LU_NB 64
+
 // Inicializa a matriz _M_PERM como uma matriz de permutação de dimensões dxd.
-void mtx_matrix_init_perm(mtx_matrix_perm_t *_M_PERM, int d);
+void mtx_matrix_init_perm(mtx_matrix_perm_t *_M_PERM, size_t d);
 
 // Decomposição LU, use as macros mtx_linalg_LU_decomp para decompsição geral e
 // mtx_linalg_LU_decomp_perf para decomposição mais rápida na resolução de
@@ -49,7 +54,7 @@ double mtx_linalg_det_LU(const mtx_matrix_t *M_LU, int signum);
 
 // Calcula o determinante de uma dada matriz quadrada M. Retorna zero se a
 // matriz não for quadrada (para mxn e n > m, use mtx_linalg_det_LU()).
-double mtx_linalg_det(const mtx_matrix_t *M);
+double mtx_matrix_det(const mtx_matrix_t *M);
 
 // Realiza a back substitution (debaixo pra cima) do sistema Ux = B. A matriz
 // U é uma matriz quadrada upper triangular.
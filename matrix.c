@@ -1,24 +1,16 @@
 #include "matrix.h"
 #include "atomic_operations.h"
 #include "errors.h"
+#include "matrix_io.h"
+#include "workspace.h"
 #include <assert.h>
-#include <ctype.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
-#define FSCANF_ONE(stream, fmt, pointer)                                       \
-  do {                                                                         \
-    if (fscanf(stream, fmt, pointer) != 1) {                                   \
-      MTX_SYSTEM_ERR("fscanf");                                                \
-    }                                                                          \
-  } while (0)
-
-#define FPRINTF_ONE(stream, fmt, data)                                         \
-  do {                                                                         \
-    if (fprintf(stream, fmt, data) < 0) {                                      \
-      MTX_SYSTEM_ERR("fprintf");                                               \
-    }                                                                          \
-  } while (0)
+// Size of the buffer where mtx_matrix_fprint_opt() formats the elements
+// before writing them to the stream.
+#define PRINT_BUFFER_SIZE (16 * 1024)
 
 int __mtx_cfg_fix_unsafe_overlappings = 1;
 
@@ -50,58 +42,130 @@ void mtx_cfg_set_mem_alloc(mtx_mem_allocator_t allocator) {
   __mtx_cfg_mem_allocator = allocator; // TODO: Make Thread safe.
 }
 
-static void __configure_matrix(mtx_matrix_t *_M, int dy, int dx) {
-  assert(dy <= MTX_MATRIX_MAX_ROWS && dx <= MTX_MATRIX_MAX_COLUMNS);
-  assert(dy > 0 && dx > 0);
-  _M->data = (mtx_matrix_data_t *)mtx_mem_alloc(sizeof(mtx_matrix_data_t));
+mtx_mem_aligned_allocator_t __mtx_cfg_mem_aligned_allocator =
+    mtx_default_mem_aligned_alloc;
+
+void *mtx_default_mem_aligned_alloc(size_t alignment, size_t size) {
+  void *p = NULL;
+
+  if (size == 0 || posix_memalign(&p, alignment, size) != 0) {
+    MTX_SYSTEM_ERR("posix_memalign");
+  }
+
+  return p;
+}
+
+void mtx_cfg_set_mem_aligned_alloc(mtx_mem_aligned_allocator_t allocator) {
+  __mtx_cfg_mem_aligned_allocator = allocator; // TODO: Make Thread safe.
+}
+
+// Elements in a cache line and in a 4 KiB page.
+#define LINE_ELEMENTS (MTX_MATRIX_ALIGNMENT / sizeof(double))
+#define PAGE_ELEMENTS (4096 / sizeof(double))
+
+// Rows narrower than this aren't padded: the padding would take a large
+// fraction of their size, and unpadded matrices stay contiguous.
+#define PAD_MIN_ELEMENTS (16 * LINE_ELEMENTS)
+
+// Leading dimension of a new dy x dx matrix: for wide rows, dx rounded up to
+// whole cache lines plus one more line when the row stride would be a multiple
+// of 4 KiB, since then every row maps to the same L1 sets.
+static size_t __padded_ld(size_t dy, size_t dx) {
+  if (dy == 1 || dx < PAD_MIN_ELEMENTS || dx > SIZE_MAX - 2 * LINE_ELEMENTS) {
+    return dx;
+  }
+
+  size_t ld = (dx + LINE_ELEMENTS - 1) / LINE_ELEMENTS * LINE_ELEMENTS;
+  if (ld % PAGE_ELEMENTS == 0) {
+    ld += LINE_ELEMENTS;
+  }
+  return ld;
+}
+
+#undef LINE_ELEMENTS
+#undef PAGE_ELEMENTS
+#undef PAD_MIN_ELEMENTS
+
+// Size of the header of a matrix created by mtx_matrix_init(), which is
+// followed by the elements in the same allocation.
+#define HEADER_SIZE                                                            \
+  ((sizeof(mtx_matrix_data_t) + MTX_MATRIX_ALIGNMENT - 1) /                    \
+   MTX_MATRIX_ALIGNMENT * MTX_MATRIX_ALIGNMENT)
+
+// Raises MTX_DIMEN_ERR if the header plus dy * ld elements can't be
+// addressed.
+static void __check_size(mtx_matrix_t *_M, size_t dy, size_t dx, size_t ld) {
+  assert(dy > 0 && dx > 0 && ld >= dx);
+  if (ld > (SIZE_MAX - HEADER_SIZE) / sizeof(double) / dy) {
+    _M->data = NULL;
+    _M->dy = dy;
+    _M->dx = dx;
+    MTX_DIMEN_ERR(_M);
+  }
+}
+
+static void __configure_matrix(mtx_matrix_t *_M, size_t dy, size_t dx,
+                               size_t ld) {
   _M->data->size1 = dy;
   _M->data->size2 = dx;
+  _M->data->ld = ld;
 
   _M->dy = _M->data->size1;
   _M->dx = _M->data->size2;
 
   _M->offY = 0;
   _M->offX = 0;
-
-  _M->data->m = (double **)mtx_mem_alloc(sizeof(double *) * dy);
+  _M->flags = 0;
+  _M->row_stride = 0;
+  _M->col_stride = 0;
 }
 
-static inline void __reference_arr(mtx_matrix_t *_M, double *arr, int dy,
-                                   int dx) {
-  assert(arr != NULL);
-  assert(dy <= MTX_MATRIX_MAX_ROWS && dx <= MTX_MATRIX_MAX_COLUMNS);
-  assert(dy > 0 && dx > 0);
-  for (int i = 0; i < dy; ++i) {
-    _M->data->m[i] = &arr[i * dx];
+// Allocates the header and the elements in a single block, taken from the
+// workspace of the thread if scratch is set.
+static void __init_inline(mtx_matrix_t *_M, size_t dy, size_t dx,
+                          int scratch) {
+  size_t ld = __padded_ld(dy, dx);
+  __check_size(_M, dy, dx, ld);
+
+  size_t size = HEADER_SIZE + dy * ld * sizeof(double);
+  char *block = scratch ? (char *)_mtx_scratch_alloc(size)
+                        : (char *)mtx_mem_aligned_alloc(MTX_MATRIX_ALIGNMENT,
+                                                        size);
+  _M->data = (mtx_matrix_data_t *)block;
+  _M->data->m = (double *)(block + HEADER_SIZE);
+  _M->data->flags = MTX_MATRIX_DATA_INLINE;
+  if (scratch) {
+    _M->data->flags |= MTX_MATRIX_DATA_SCRATCH;
   }
+
+  __configure_matrix(_M, dy, dx, ld);
 }
 
-void mtx_matrix_init(mtx_matrix_t *_M, int dy, int dx) {
-  __configure_matrix(_M, dy, dx);
+void mtx_matrix_init(mtx_matrix_t *_M, size_t dy, size_t dx) {
+  __init_inline(_M, dy, dx, 0);
+}
 
-  double *m = (double *)mtx_mem_alloc(dy * dx * sizeof(double));
-  __reference_arr(_M, m, dy, dx);
+void mtx_matrix_init_scratch(mtx_matrix_t *_M, size_t dy, size_t dx) {
+  __init_inline(_M, dy, dx, 1);
 }
 
-void mtx_matrix_ref_a(mtx_matrix_t *_M, double *arr, int dy, int dx) {
-  __configure_matrix(_M, dy, dx);
-  __reference_arr(_M, arr, dy, dx);
+void mtx_matrix_ref_a(mtx_matrix_t *_M, double *arr, size_t dy, size_t dx) {
+  assert(arr != NULL);
+  __check_size(_M, dy, dx, dx);
+
+  _M->data = (mtx_matrix_data_t *)mtx_mem_alloc(sizeof(mtx_matrix_data_t));
+  _M->data->m = arr;
+  _M->data->flags = 0;
+
+  __configure_matrix(_M, dy, dx, dx);
 }
 
+#undef HEADER_SIZE
+
 double *mtx_matrix_raw_a(mtx_matrix_t *M) {
   MTX_ENSURE_INIT(M);
 
-  double *head_mem = M->data->m[0]; // head mem is the pointer which can be
-                                    // freed.
-  for (int i = 0; i < M->dy; ++i) {
-    // rows swaps can be done, then the head mem might not be the first. Since
-    // its a contiguous array, the pointer which the lowest value is the head.
-    if (M->data->m[i] < head_mem) {
-      head_mem = M->data->m[i];
-    }
-  }
-
-  return head_mem;
+  return M->data->m;
 }
 
 void mtx_matrix_unref(mtx_matrix_t *__M) {
@@ -110,8 +174,12 @@ void mtx_matrix_unref(mtx_matrix_t *__M) {
     return;
   }
 
-  free(__M->data->m);
-  __M->data->m = NULL;
+  // The elements can't outlive a header allocated with them and a mapping
+  // must be released with mtx_matrix_munmap().
+  if (__M->data->flags & (MTX_MATRIX_DATA_INLINE | MTX_MATRIX_DATA_MAPPED)) {
+    MTX_INVALID_ERR(__M);
+  }
+
   free(__M->data);
   __M->data = NULL;
 }
@@ -124,9 +192,11 @@ void mtx_matrix_swap(mtx_matrix_t *M1, mtx_matrix_t *M2) {
     MTX_INVALID_ERR(M1);
   }
 
-  double **tmp = M1->data->m;
-  M1->data->m = M2->data->m;
-  M2->data->m = tmp;
+  // The headers are swapped along with the elements since an inline header
+  // shares the allocation of its elements.
+  mtx_matrix_data_t *tmp = M1->data;
+  M1->data = M2->data;
+  M2->data = tmp;
 }
 
 void mtx_matrix_free(mtx_matrix_t *__M) {
@@ -134,30 +204,56 @@ void mtx_matrix_free(mtx_matrix_t *__M) {
     return;
   }
 
-  if (MTX_MATRIX_IS_VIEW(__M)) {
+  if (MTX_MATRIX_IS_VIEW(__M) || __M->data->flags & MTX_MATRIX_DATA_MAPPED) {
     MTX_INVALID_ERR(__M);
   }
 
-  double *head_mem = mtx_matrix_raw_a(__M);
-  // This only works because all rows are a single CONTIGUOUS and splited
-  // array starting at head_mem.
-  free(head_mem);
+  if (__M->data->flags & MTX_MATRIX_DATA_SCRATCH) {
+    _mtx_scratch_free(__M->data);
+    __M->data = NULL;
+    return;
+  }
 
-  mtx_matrix_unref(__M);
+  if (!(__M->data->flags & MTX_MATRIX_DATA_INLINE)) {
+    free(__M->data->m);
+  }
+  free(__M->data);
+  __M->data = NULL;
 }
 
 void mtx_matrix_fill_a(mtx_matrix_t *M, double *array) {
   MTX_ENSURE_INIT(M);
-  for (int i = 0; i < M->dy; ++i) {
-    memcpy(mtx_matrix_row(M, i), array, sizeof(double) * M->dx);
+  for (size_t i = 0; i < M->dy; ++i) {
+    if (MTX_MATRIX_HAS_UNIT_COLUMNS(M)) {
+      memcpy(mtx_matrix_row(M, i), array, sizeof(double) * M->dx);
+    } else {
+      for (size_t j = 0; j < M->dx; ++j) {
+        mtx_matrix_at(M, i, j) = array[j];
+      }
+    }
     array = &array[M->dx];
   }
 }
 
 void mtx_matrix_fill_m(mtx_matrix_t *M, double **matrix) {
   MTX_ENSURE_INIT(M);
-  for (int j = 0; j < M->dy; ++j) {
-    memcpy(mtx_matrix_row(M, j), matrix[j], sizeof(double) * M->dx);
+  for (size_t j = 0; j < M->dy; ++j) {
+    if (MTX_MATRIX_HAS_UNIT_COLUMNS(M)) {
+      memcpy(mtx_matrix_row(M, j), matrix[j], sizeof(double) * M->dx);
+    } else {
+      for (size_t i = 0; i < M->dx; ++i) {
+        mtx_matrix_at(M, j, i) = matrix[j][i];
+      }
+    }
+  }
+}
+
+// Copies the elements one at a time, for views whose rows aren't contiguous.
+static void __copy_elements(mtx_matrix_t *M_TO, const mtx_matrix_t *M_FROM) {
+  for (size_t i = 0; i < M_TO->dy; ++i) {
+    for (size_t j = 0; j < M_TO->dx; ++j) {
+      mtx_matrix_at(M_TO, i, j) = mtx_matrix_at(M_FROM, i, j);
+    }
   }
 }
 
@@ -167,7 +263,11 @@ void mtx_matrix_clone(mtx_matrix_t *_M, const mtx_matrix_t *M) {
 
   mtx_matrix_init(_M, M->dy, M->dx);
 
-  for (int j = 0; j < _M->dy; ++j) {
+  if (!MTX_MATRIX_HAS_UNIT_COLUMNS(M)) {
+    __copy_elements(_M, M);
+    return;
+  }
+  for (size_t j = 0; j < _M->dy; ++j) {
     memcpy(mtx_matrix_row(_M, j), mtx_matrix_row(M, j),
            sizeof(double) * _M->dx);
   }
@@ -181,40 +281,145 @@ void mtx_matrix_copy(mtx_matrix_t *M_TO, const mtx_matrix_t *M_FROM) {
     MTX_DIMEN_ERR(M_TO);
   }
 
+  int strided = (M_TO->flags | M_FROM->flags) != 0;
+  if (strided && MTX_MATRIX_OVERLAP(M_FROM, M_TO)) {
+    if (MTX_MATRIX_ARE_SAME(M_FROM, M_TO)) {
+      return;
+    }
+    // The elements may be read after being overwritten in any order, so they
+    // go through a temporary.
+    mtx_matrix_t tmp;
+    mtx_matrix_init_scratch(&tmp, M_FROM->dy, M_FROM->dx);
+    __copy_elements(&tmp, M_FROM);
+    __copy_elements(M_TO, &tmp);
+    mtx_matrix_free(&tmp);
+    return;
+  }
+  if (!MTX_MATRIX_HAS_UNIT_COLUMNS(M_TO) ||
+      !MTX_MATRIX_HAS_UNIT_COLUMNS(M_FROM)) {
+    __copy_elements(M_TO, M_FROM);
+    return;
+  }
+
   void *(*copy)(void *, const void *, size_t) = memcpy;
   if (MTX_MATRIX_OVERLAP(M_FROM, M_TO)) {
     copy = memmove;
   }
-  for (int i = 0; i < M_TO->dy; ++i) {
+  for (size_t i = 0; i < M_TO->dy; ++i) {
     copy(mtx_matrix_row(M_TO, i), mtx_matrix_row(M_FROM, i),
          sizeof(double) * M_TO->dx);
   }
 }
-mtx_matrix_view_t mtx_matrix_view_of(const mtx_matrix_t *M_OF, int init_i,
-                                     int init_j, int dy, int dx) {
+
+mtx_matrix_view_t mtx_matrix_view_of(const mtx_matrix_t *M_OF, size_t init_i,
+                                     size_t init_j, size_t dy, size_t dx) {
   MTX_ENSURE_INIT(M_OF);
-  assert(init_i >= 0 && init_j >= 0);
   assert(dy > 0 && dx > 0);
 
-  if (init_i + dy > M_OF->dy || init_j + dx > M_OF->dx) {
+  if (init_i > M_OF->dy || dy > M_OF->dy - init_i || init_j > M_OF->dx ||
+      dx > M_OF->dx - init_j) {
     MTX_BOUNDS_ERR(M_OF);
   }
 
-  mtx_matrix_t mtx;
-  mtx.data = M_OF->data;
-  mtx.offY = M_OF->offY + init_i;
-  mtx.offX = M_OF->offX + init_j;
+  mtx_matrix_t mtx = *M_OF;
+  if (M_OF->flags & MTX_MATRIX_VIEW_STRIDED) {
+    // The view keeps the strides and starts at the element (init_i, init_j).
+    size_t at = _mtx_matrix_index(M_OF, init_i, init_j);
+    mtx.offY = at / M_OF->data->ld;
+    mtx.offX = at % M_OF->data->ld;
+  } else {
+    mtx.offY = M_OF->offY + init_i;
+    mtx.offX = M_OF->offX + init_j;
+  }
   mtx.dy = dy;
   mtx.dx = dx;
 
   return (mtx_matrix_view_t){.matrix = mtx};
 }
 
+// View of M_OF starting at its element at and with the given strides.
+static mtx_matrix_view_t __strided_view(const mtx_matrix_t *M_OF, size_t at,
+                                        size_t dy, size_t dx,
+                                        ptrdiff_t row_stride,
+                                        ptrdiff_t col_stride, unsigned flags) {
+  mtx_matrix_t mtx = {
+      .data = M_OF->data,
+      .dy = dy,
+      .dx = dx,
+      .offY = at / M_OF->data->ld,
+      .offX = at % M_OF->data->ld,
+      .flags = flags | MTX_MATRIX_VIEW_STRIDED,
+      .row_stride = row_stride,
+      .col_stride = col_stride,
+  };
+  return (mtx_matrix_view_t){.matrix = mtx};
+}
+
+mtx_matrix_view_t mtx_matrix_strided_of(const mtx_matrix_t *M_OF, size_t init_i,
+                                        size_t init_j, size_t dy, size_t dx,
+                                        ptrdiff_t step_i, ptrdiff_t step_j) {
+  MTX_ENSURE_INIT(M_OF);
+  assert(dy > 0 && dx > 0 && step_i != 0 && step_j != 0);
+
+  // Position of the last row and column of the view in M_OF.
+#define LAST_OF(init, d, step, size)                                           \
+  ((init) < (size) &&                                                          \
+   ((step) > 0 ? ((d)-1) <= ((size)-1 - (init)) / (size_t)(step)               \
+               : ((d)-1) <= (init) / (size_t)(-(step))))
+
+  if (!LAST_OF(init_i, dy, step_i, M_OF->dy) ||
+      !LAST_OF(init_j, dx, step_j, M_OF->dx)) {
+    MTX_BOUNDS_ERR(M_OF);
+  }
+
+#undef LAST_OF
+
+  return __strided_view(M_OF, _mtx_matrix_index(M_OF, init_i, init_j), dy, dx,
+                        step_i * mtx_matrix_row_stride(M_OF),
+                        step_j * mtx_matrix_col_stride(M_OF),
+                        M_OF->flags & MTX_MATRIX_VIEW_TRANSPOSED);
+}
+
+mtx_matrix_view_t mtx_matrix_transposed_of(const mtx_matrix_t *M_OF) {
+  MTX_ENSURE_INIT(M_OF);
+
+  return __strided_view(M_OF, _mtx_matrix_index(M_OF, 0, 0), M_OF->dx,
+                        M_OF->dy, mtx_matrix_col_stride(M_OF),
+                        mtx_matrix_row_stride(M_OF),
+                        (M_OF->flags ^ MTX_MATRIX_VIEW_TRANSPOSED) &
+                            MTX_MATRIX_VIEW_TRANSPOSED);
+}
+
+mtx_matrix_view_t mtx_matrix_diagonal_of(const mtx_matrix_t *M_OF) {
+  MTX_ENSURE_INIT(M_OF);
+
+  size_t d = M_OF->dy < M_OF->dx ? M_OF->dy : M_OF->dx;
+  return __strided_view(M_OF, _mtx_matrix_index(M_OF, 0, 0), d, 1,
+                        mtx_matrix_row_stride(M_OF) +
+                            mtx_matrix_col_stride(M_OF),
+                        1, 0);
+}
+
+mtx_matrix_view_t mtx_matrix_reshape_of(const mtx_matrix_t *M_OF, size_t dy,
+                                        size_t dx) {
+  MTX_ENSURE_INIT(M_OF);
+  assert(dy > 0 && dx > 0);
+
+  if (!MTX_MATRIX_IS_CONTIGUOUS(M_OF)) {
+    MTX_INVALID_ERR(M_OF);
+  }
+  if (dx > SIZE_MAX / dy || dy * dx != M_OF->dy * M_OF->dx) {
+    MTX_DIMEN_ERR(M_OF);
+  }
+
+  return __strided_view(M_OF, _mtx_matrix_index(M_OF, 0, 0), dy, dx,
+                        (ptrdiff_t)dx, 1, 0);
+}
+
 int mtx_matrix_copy_from(mtx_matrix_t *M_TO, const mtx_matrix_t *M_FROM,
-                         int init_i, int init_j) {
+                         size_t init_i, size_t init_j) {
   MTX_ENSURE_INIT(M_FROM);
   MTX_ENSURE_INIT(M_TO);
-  assert(init_i >= 0 && init_j >= 0);
 
   // if (init_i + M_TO->dy > M_FROM->dy || init_j + M_TO->dx > M_FROM->dx) {
   //   return 1;
@@ -229,46 +434,96 @@ int mtx_matrix_copy_from(mtx_matrix_t *M_TO, const mtx_matrix_t *M_FROM,
 
 void mtx_matrix_print(const mtx_matrix_t *M) {
 
-  printf("matrix (%u, %u):\n", M->dy, M->dx);
+  printf("matrix (%zu, %zu):\n", M->dy, M->dx);
   mtx_matrix_fprint(stdout, M);
 }
 void mtx_matrix_fprint(FILE *stream, const mtx_matrix_t *M) {
-  MTX_ENSURE_INIT(M);
-  if (stream == NULL) {
-    MTX_SYSTEM_ERR("fprintf");
+  mtx_matrix_fprint_opt(stream, M, NULL);
+}
+
+static void __print_flush(FILE *stream, const char *buffer, size_t *len) {
+  if (*len > 0 && fwrite(buffer, 1, *len, stream) != *len) {
+    MTX_SYSTEM_ERR("fwrite");
   }
-  for (int i = 0; i < M->dy; ++i) {
-    for (int j = 0; j < M->dx; ++j) {
-      FPRINTF_ONE(stream, "%g ", mtx_matrix_at(M, i, j));
+  *len = 0;
+}
+
+static void __print_put(FILE *stream, char *buffer, size_t *len, const char *s,
+                        size_t n) {
+  if (n > PRINT_BUFFER_SIZE - *len) {
+    __print_flush(stream, buffer, len);
+    if (n > PRINT_BUFFER_SIZE) {
+      __print_flush(stream, s, &n);
+      return;
     }
-    fprintf(stream, "\n");
   }
+  memcpy(buffer + *len, s, n);
+  *len += n;
 }
 
-void mtx_matrix_fread(FILE *stream, mtx_matrix_t *M) {
+void mtx_matrix_fprint_opt(FILE *stream, const mtx_matrix_t *M,
+                           const mtx_print_opts_t *opts) {
   MTX_ENSURE_INIT(M);
   if (stream == NULL) {
-    MTX_SYSTEM_ERR("fscanf");
+    MTX_SYSTEM_ERR("fwrite");
   }
-  for (int i = 0; i < M->dy; ++i) {
-    for (int j = 0; j < M->dx; ++j) {
-      FSCANF_ONE(stream, "%lf", &mtx_matrix_at(M, i, j));
+
+  int precision = opts != NULL ? opts->precision : 0;
+  if (precision > MTX_PRINT_PRECISION_MAX) {
+    precision = MTX_PRINT_PRECISION_MAX;
+  }
+  const char *delimiter =
+      opts != NULL && opts->delimiter != NULL ? opts->delimiter : " ";
+  size_t delimiter_len = strlen(delimiter);
+
+  char buffer[PRINT_BUFFER_SIZE];
+  size_t len = 0;
+  char number[MTX_DOUBLE_CHARS_MAX];
+  for (size_t i = 0; i < M->dy; ++i) {
+    for (size_t j = 0; j < M->dx; ++j) {
+      if (j > 0) {
+        __print_put(stream, buffer, &len, delimiter, delimiter_len);
+      }
+
+      double x = mtx_matrix_at(M, i, j);
+      size_t n = precision > 0 ? (size_t)snprintf(number, sizeof(number),
+                                                  "%.*g", precision, x)
+                               : (size_t)_mtx_format_double(number, x);
+      __print_put(stream, buffer, &len, number, n);
     }
+    __print_put(stream, buffer, &len, "\n", 1);
   }
+  __print_flush(stream, buffer, &len);
 }
 
-static inline int __char_is_del(char c, const char *dels);
-static inline double *__next_mtx_dbl(double **mtx, size_t *size_d,
-                                     size_t *max_size_d);
+static int __read_number(FILE *stream, double *x);
 static int read_line(double **mtx, size_t *size_d, size_t *max_size_d,
                      FILE *stream);
 
+void mtx_matrix_fread(FILE *stream, mtx_matrix_t *M) {
+  MTX_ENSURE_INIT(M);
+  if (stream == NULL) {
+    MTX_SYSTEM_ERR("getc");
+  }
+
+  flockfile(stream);
+  for (size_t i = 0; i < M->dy; ++i) {
+    for (size_t j = 0; j < M->dx; ++j) {
+      if (__read_number(stream, &mtx_matrix_at(M, i, j)) != 0) {
+        funlockfile(stream);
+        MTX_SYSTEM_ERR("getc");
+      }
+    }
+  }
+  funlockfile(stream);
+}
+
 // TODO: Make possible to pass custom delimiters used for separation of numbers
 // read.
-double *mtx_matrix_fread_raw(FILE *stream, int *dy, int *dx) {
+double *mtx_matrix_fread_raw(FILE *stream, size_t *dy, size_t *dx) {
 
   if (stream == NULL) {
-    MTX_SYSTEM_ERR("fscanf");
+    MTX_SYSTEM_ERR("getc");
   }
 
   double *mtx = NULL;
@@ -279,7 +534,7 @@ double *mtx_matrix_fread_raw(FILE *stream, int *dy, int *dx) {
   // _dx is the matrix's columns number determined by the number of elements
   // in the first line. It must be at least 1 . _dy can be of any size,
   // depending of number of valid lines read. It must be at least 1
-  int _dx, _dy;
+  size_t _dx, _dy;
 
   int ret;
   while (size_d == 0) {
@@ -319,7 +574,7 @@ double *mtx_matrix_fread_raw(FILE *stream, int *dy, int *dx) {
 
 void mtx_matrix_finit(FILE *stream, mtx_matrix_t *_M) {
 
-  int dx, dy;
+  size_t dx, dy;
   double *mtx_m = mtx_matrix_fread_raw(stream, &dy, &dx);
   if (mtx_m != NULL) {
     mtx_matrix_ref_a(_M, mtx_m, dy, dx);
@@ -340,8 +595,8 @@ int mtx_matrix_equals(const mtx_matrix_t *A, const mtx_matrix_t *B) {
     return 0;
   }
 
-  for (int i = 0; i < A->dy; ++i) {
-    for (int j = 0; j < A->dx; ++j) {
+  for (size_t i = 0; i < A->dy; ++i) {
+    for (size_t j = 0; j < A->dx; ++j) {
       if (mtx_matrix_at(A, i, j) != mtx_matrix_at(B, i, j)) {
         return 0;
       }
@@ -351,98 +606,114 @@ int mtx_matrix_equals(const mtx_matrix_t *A, const mtx_matrix_t *B) {
   return 1;
 }
 
-static inline int __char_is_del(char c, const char *dels) {
-  while (*dels != '\0') {
-    if (c == *(dels++)) {
+// Longest number accepted in a text matrix.
+#define TOKEN_MAX 128
+
+// Reads the next number of stream (locked by the caller), skipping delimiters
+// and line breaks. The character after the number is left in the stream.
+// Returns 1 if the stream doesn't continue with a number.
+static int __read_number(FILE *stream, double *x) {
+  char token[TOKEN_MAX];
+  size_t len = 0;
+
+  int c;
+  while ((c = getc_unlocked(stream)) != EOF &&
+         (_mtx_text_char_class(c) == MTX_TEXT_DELIMITER ||
+          _mtx_text_char_class(c) == MTX_TEXT_LINE_END))
+    ;
+  for (; c != EOF && _mtx_text_char_class(c) == MTX_TEXT_NUMBER;
+       c = getc_unlocked(stream)) {
+    if (len == sizeof(token)) {
       return 1;
     }
+    token[len++] = c;
   }
-  return 0;
+  if (c != EOF) {
+    ungetc(c, stream);
+  }
+
+  return len == 0 || _mtx_parse_double(token, token + len, x) != token + len;
 }
 
-static inline double *__next_mtx_dbl(double **mtx, size_t *size_d,
-                                     size_t *max_size_d) {
-  if ((*size_d) >= *max_size_d) {
-    *mtx = (double *)realloc(*mtx, (*max_size_d += MTX_MATRIX_MAX_COLUMNS) *
-                                       sizeof(double));
-    if (*mtx == NULL) {
-      MTX_SYSTEM_ERR("realloc");
+// Number of elements of the first buffer of mtx_matrix_fread_raw(), which
+// doubles each time it fills up.
+#define READ_CHUNK_SIZE 1024
+
+static inline int __push_dbl(double **mtx, size_t *size_d, size_t *max_size_d,
+                             double x) {
+  if (*size_d == *max_size_d) {
+    size_t max_size = *max_size_d > 0 ? *max_size_d * 2 : READ_CHUNK_SIZE;
+    double *grown = NULL;
+    if (max_size <= SIZE_MAX / sizeof(double)) {
+      grown = (double *)realloc(*mtx, max_size * sizeof(double));
+    }
+    if (grown == NULL) {
+      return 1;
     }
+    *mtx = grown;
+    *max_size_d = max_size;
   }
-  return &(*mtx)[(*size_d)++];
+  (*mtx)[(*size_d)++] = x;
+  return 0;
 }
 
+// Reads the numbers of a line of stream into *mtx. Returns 0 at the end of the
+// line, 1 at the end of the stream or after an invalid character (which is
+// consumed). The stream is read through its own buffer with getc_unlocked(),
+// so nothing past the line is consumed.
 static int read_line(double **mtx, size_t *size_d, size_t *max_size_d,
                      FILE *stream) {
-  char num_buf[32];
-  int nbuf_size = 0;
-
-#define READ                                                                   \
-  do {                                                                         \
-    if (nbuf_size > 0) {                                                       \
-      num_buf[nbuf_size] = '\0';                                               \
-      int num_size;                                                            \
-      sscanf(num_buf, "%lf%n", __next_mtx_dbl(mtx, size_d, max_size_d),        \
-             &num_size);                                                       \
-      if (num_size < nbuf_size) {                                              \
-        return 1;                                                              \
-      }                                                                        \
-    }                                                                          \
-  } while (0);
-
-#define STOP_READ(ret)                                                         \
-  READ;                                                                        \
-  return ret;
-
-  const char dels[4] = ",\t ";
+  char token[TOKEN_MAX];
+  size_t len = 0;
+  int ret;
 
-  int c;
-  while ((c = getc(stream)) != EOF) {
-    int char_is_del;
+  flockfile(stream);
+  for (;;) {
+    int c = getc_unlocked(stream);
+    int char_class = c == EOF ? MTX_TEXT_OTHER : _mtx_text_char_class(c);
 
-    if (isspace(c) && !isblank(c)) {
-      // In any case if a /n, /f, /r, etc. Stop the read and store pending
-      // number.
-      STOP_READ(0);
+    if (char_class == MTX_TEXT_NUMBER) {
+      if (len == sizeof(token)) {
+        ret = 1;
+        break;
+      }
+      token[len++] = c;
+      continue;
     }
 
-    // WAIT FOR NUMBER: if nbuf_size >= 0 and its not a blank, try to read a
-    // char of number.
-    if ((isdigit(c) || c == '-' || c == '+' || c == 'e' || c == '.') &&
-        nbuf_size >= 0) {
-      if (nbuf_size >= sizeof(num_buf)) {
-        STOP_READ(1);
+    // Stores the pending number.
+    if (len > 0) {
+      double x;
+      if (_mtx_parse_double(token, token + len, &x) != token + len) {
+        ret = 1;
+        break;
       }
-      num_buf[nbuf_size++] = c;
-    }
-    // WAIT FOR DELIMITER: if nbuf_size < 0 only accept a
-    // delimiter or blanks.
-    else if (nbuf_size < 0) {
-      if ((char_is_del = __char_is_del(c, dels))) {
-        nbuf_size = 0;
-        continue;
-      } else if (!isblank(c)) {
-        return 1;
+      if (__push_dbl(mtx, size_d, max_size_d, x) != 0) {
+        funlockfile(stream);
+        free(*mtx);
+        *mtx = NULL;
+        MTX_SYSTEM_ERR("realloc");
       }
+      len = 0;
     }
 
-    // If nbuf_size >= 0 and its not a number char but its a
-    // delimiter, store pending number. After that, restart to read number
-    // chars.
-    else if (__char_is_del(c, dels)) {
-      READ;
-      nbuf_size = 0;
-    } // If is blank, store the pending number if it exists, after that, ONLY
-    // accept new blanks or delimiter (setting nbuf_size < 0);
-    else if (isblank(c)) {
-      if (nbuf_size > 0) {
-        READ;
-        nbuf_size = -1;
+    if (char_class == MTX_TEXT_DELIMITER) {
+      continue;
+    }
+    if (c == '\r') {
+      // \r\n is a single line break.
+      int next = getc_unlocked(stream);
+      if (next != '\n' && next != EOF) {
+        ungetc(next, stream);
       }
-    } else {
-      STOP_READ(1);
     }
+    ret = char_class == MTX_TEXT_LINE_END ? 0 : 1;
+    break;
   }
+  funlockfile(stream);
 
-  return 1;
+  return ret;
 }
+
+#undef TOKEN_MAX
+#undef READ_CHUNK_SIZE
@@ -5,34 +5,85 @@
 extern "C" {
 #endif
 
+#include <stddef.h>
 #include <stdio.h>
 
+// Os elementos são armazenados em um único array row-major: o elemento (i, j)
+// está em m[i * ld + j], sendo ld (leading dimension) a distância entre o
+// início de duas linhas consecutivas (ld >= size2).
 typedef struct mtx_matrix_data {
-  double **m;
+  double *m;
   size_t size1;
   size_t size2;
+  size_t ld;
+  // Combinação de MTX_MATRIX_DATA_*.
+  unsigned flags;
 } mtx_matrix_data_t;
 
+// Os elementos estão no mesmo bloco de memória do mtx_matrix_data_t, logo
+// depois dele (matrizes criadas por mtx_matrix_init()).
+#define MTX_MATRIX_DATA_INLINE 0x1
+// O bloco foi alocado com _mtx_scratch_alloc() (ver workspace.h).
+#define MTX_MATRIX_DATA_SCRATCH 0x2
+// Os elementos são um arquivo mapeado em memória por mtx_matrix_mmap().
+#define MTX_MATRIX_DATA_MAPPED 0x4
+
 typedef struct mtx_matrix {
   mtx_matrix_data_t *data;
-  int dx, dy;
-  int offX, offY;
+  size_t dx, dy;
+  // Posição do elemento (0, 0) nos elementos de data.
+  size_t offX, offY;
+  // Combinação de MTX_MATRIX_VIEW_*; 0 nas matrizes e views retangulares.
+  unsigned flags;
+  // Views com MTX_MATRIX_VIEW_STRIDED: distância em elementos entre linhas e
+  // colunas consecutivas (negativa nas views em ordem reversa).
+  ptrdiff_t row_stride, col_stride;
 } mtx_matrix_t;
 
+// O elemento (i, j) está em m[offY * ld + offX + i * row_stride +
+// j * col_stride] (transpostas, diagonais, a cada k linhas, em ordem reversa e
+// reshapes, ver mtx_matrix_strided_of()).
+#define MTX_MATRIX_VIEW_STRIDED 0x1
+// A view percorre a transposta dos elementos: as linhas dela são colunas
+// de data (ver mtx_matrix_transposed_of()).
+#define MTX_MATRIX_VIEW_TRANSPOSED 0x2
+
 typedef struct mtx_matrix_view {
   mtx_matrix_t matrix;
 } mtx_matrix_view_t;
 
 #define _mod(x) ((x) < 0 ? -(x) : (x))
 
-#define mtx_matrix_at(M, i, j) (M)->data->m[(M)->offY + i][(M)->offX + j]
+// Índice do elemento (i, j) de M em data->m.
+#define _mtx_matrix_index(M, i, j)                                             \
+  ((M)->flags & MTX_MATRIX_VIEW_STRIDED                                        \
+       ? (ptrdiff_t)((M)->offY * (M)->data->ld + (M)->offX) +                  \
+             (ptrdiff_t)(i) * (M)->row_stride +                                \
+             (ptrdiff_t)(j) * (M)->col_stride                                  \
+       : (ptrdiff_t)(((M)->offY + (i)) * (M)->data->ld + (M)->offX + (j)))
 
-#define mtx_matrix_row(M, i) &(M)->data->m[(M)->offY + i][(M)->offX]
+#define mtx_matrix_at(M, i, j) (M)->data->m[_mtx_matrix_index(M, i, j)]
 
-#define MTX_MATRIX_IS_SQUARE(M) ((M)->dx == (M)->dy)
+// Ponteiro para o elemento (i, 0). Os elementos da linha só são contíguos caso
+// MTX_MATRIX_HAS_UNIT_COLUMNS(M).
+#define mtx_matrix_row(M, i) (&(M)->data->m[_mtx_matrix_index(M, i, 0)])
+
+// Distância em elementos entre linhas e entre colunas consecutivas de M.
+#define mtx_matrix_row_stride(M)                                               \
+  ((M)->flags & MTX_MATRIX_VIEW_STRIDED ? (M)->row_stride                      \
+                                        : (ptrdiff_t)(M)->data->ld)
+#define mtx_matrix_col_stride(M)                                               \
+  ((M)->flags & MTX_MATRIX_VIEW_STRIDED ? (M)->col_stride : 1)
 
-#define MTX_MATRIX_MAX_ROWS 1024
-#define MTX_MATRIX_MAX_COLUMNS 1024
+// As linhas de M são arrays contíguos.
+#define MTX_MATRIX_HAS_UNIT_COLUMNS(M) (mtx_matrix_col_stride(M) == 1)
+
+// Todos os elementos de M formam um único array row-major contíguo.
+#define MTX_MATRIX_IS_CONTIGUOUS(M)                                            \
+  (MTX_MATRIX_HAS_UNIT_COLUMNS(M) &&                                           \
+   ((M)->dy == 1 || mtx_matrix_row_stride(M) == (ptrdiff_t)(M)->dx))
+
+#define MTX_MATRIX_IS_SQUARE(M) ((M)->dx == (M)->dy)
 
 #define MTX_MATRIX_SAME_DIMENSIONS(M1, M2)                                     \
   ((M1)->dx == (M2)->dx && (M1)->dy == (M2)->dy)
@@ -41,23 +92,38 @@ typedef struct mtx_matrix_view {
 
 #define MTX_MATRIX_ARE_SAME(M1, M2)                                            \
   (MTX_MATRIX_ARE_SHARED(M1, M2) && MTX_MATRIX_SAME_DIMENSIONS(M1, M2) &&      \
-   (M1)->offY == (M2)->offY && (M1)->offX == (M2)->offX)
+   (M1)->offY == (M2)->offY && (M1)->offX == (M2)->offX &&                     \
+   mtx_matrix_row_stride(M1) == mtx_matrix_row_stride(M2) &&                   \
+   mtx_matrix_col_stride(M1) == mtx_matrix_col_stride(M2))
 
 #define MTX_MATRIX_IS_VIEW(M)                                                  \
   ((M)->offX > 0 || (M)->offY > 0 || (M)->dy != (M)->data->size1 ||            \
-   (M)->dx != (M)->data->size2)
+   (M)->dx != (M)->data->size2 || (M)->flags != 0)
 
+// Views com passo que compartilham os elementos são sempre consideradas
+// sobrepostas.
 #define MTX_MATRIX_OVERLAP_OF(M, M_OF)                                         \
   ((M)->offY + (M)->dy - 1 >= (M_OF)->offY &&                                  \
    (M)->offX + (M)->dx - 1 >= (M_OF)->offX)
 #define MTX_MATRIX_OVERLAP(M1, M2)                                             \
   (MTX_MATRIX_ARE_SHARED(M1, M2) &&                                            \
-   (MTX_MATRIX_OVERLAP_OF(M1, M2) && MTX_MATRIX_OVERLAP_OF(M2, M1)))
+   (((M1)->flags | (M2)->flags) != 0 ||                                        \
+    (MTX_MATRIX_OVERLAP_OF(M1, M2) && MTX_MATRIX_OVERLAP_OF(M2, M1))))
 
 #define MTX_MATRIX_OVERLAP_AFTER(M1, M2)                                       \
   (MTX_MATRIX_OVERLAP(M1, M2) &&                                               \
-   ((M2)->offY > (M1)->offY ||                                                 \
-    ((M2)->offX > (M1)->offX && (M2)->offY == (M1)->offY)))
+   (((M1)->flags | (M2)->flags) != 0                                           \
+        ? !MTX_MATRIX_ARE_SAME(M1, M2)                                         \
+        : ((M2)->offY > (M1)->offY ||                                          \
+           ((M2)->offX > (M1)->offX && (M2)->offY == (M1)->offY))))
+
+// Gera MTX_INVALID_ERR caso as linhas de M não sejam contíguas (views
+// transpostas, diagonais ou com passo entre as colunas), que as funções que
+// percorrem linhas inteiras não aceitam: copie a view para uma matriz antes.
+#define MTX_ENSURE_UNIT_COLUMNS(M)                                             \
+  if (!MTX_MATRIX_HAS_UNIT_COLUMNS(M)) {                                       \
+    MTX_INVALID_ERR(M);                                                        \
+  }
 
 typedef void *(*mtx_mem_allocator_t)(size_t size);
 
@@ -71,20 +137,47 @@ void mtx_cfg_set_mem_alloc(mtx_mem_allocator_t allocator);
 
 #define mtx_mem_alloc(size) __mtx_cfg_mem_allocator(size)
 
-// Inicializa a matriz _M com dy linhas e dx colunas.
-void mtx_matrix_init(mtx_matrix_t *_M, int dy, int dx);
+// Alinhamento em bytes do início de cada linha das matrizes criadas por
+// mtx_matrix_init() (uma linha de cache).
+#define MTX_MATRIX_ALIGNMENT 64
+
+typedef void *(*mtx_mem_aligned_allocator_t)(size_t alignment, size_t size);
+
+extern mtx_mem_aligned_allocator_t __mtx_cfg_mem_aligned_allocator;
+
+// Função padrão para alocação de memória alinhada, através de posix_memalign().
+void *mtx_default_mem_aligned_alloc(size_t alignment, size_t size);
+
+// Seta a função alocadora de memória alinhada. alignment é sempre uma potência
+// de 2 múltipla de sizeof(void *) e a memória retornada deve poder ser liberada
+// com free().
+void mtx_cfg_set_mem_aligned_alloc(mtx_mem_aligned_allocator_t allocator);
+
+#define mtx_mem_aligned_alloc(alignment, size)                                 \
+  __mtx_cfg_mem_aligned_allocator(alignment, size)
+
+// Inicializa a matriz _M com dy linhas e dx colunas, alocando os metadados e os
+// elementos em um único bloco de memória, que começa em um endereço múltiplo de
+// MTX_MATRIX_ALIGNMENT. Com linhas largas (dx >= 128), o leading dimension
+// recebe um padding para que cada linha comece em um endereço alinhado e
+// linhas consecutivas não caiam nos mesmos sets da cache (4K aliasing); as
+// mais estreitas ficam contíguas (ld == dx). Gera MTX_DIMEN_ERR caso o tamanho
+// da matriz não caiba em um size_t.
+void mtx_matrix_init(mtx_matrix_t *_M, size_t dy, size_t dx);
 
 // Inicializa a matriz _M através de stream, auto-detectando as dimensões de
 // acoro com o conteúdo de stream.
 void mtx_matrix_finit(FILE *stream, mtx_matrix_t *_M);
 
 // Swapa os recursos de M1 e M2, se e somente se M1 e M2 tenham as mesmas
-// dimensões e não sejam views.
+// dimensões e não sejam views. Views de M1 continuam referenciando os
+// elementos que passam a ser de M2 e vice-versa.
 void mtx_matrix_swap(mtx_matrix_t *M1, mtx_matrix_t *M2);
 
 // Libera a memória alocada da matriz M, tanto os metadados quanto os elementos.
 // Apenas é totalmente seguro usar essa função em uma matriz M gerada por
-// mtx_matrix_init(), mtx_matrix_init_perm() ou mtx_matrix_finit().
+// mtx_matrix_init(), mtx_matrix_init_perm() ou mtx_matrix_finit(). Gera
+// MTX_INVALID_ERR para views e matrizes mapeadas (use mtx_matrix_munmap()).
 void mtx_matrix_free(mtx_matrix_t *M);
 
 // Preenche a matriz M com elementos do array.
@@ -103,20 +196,45 @@ void mtx_matrix_copy(mtx_matrix_t *M_TO, const mtx_matrix_t *M_FROM);
 // Retorna uma view (essencialmente uma submatriz) que refere-se a uma parte dos
 // elementos de M_OF, de acordo com a posição relativa e as dimensões
 // especificadas.
-mtx_matrix_view_t mtx_matrix_view_of(const mtx_matrix_t *M_OF, int init_i,
-                                     int init_j, int dy, int dx);
+mtx_matrix_view_t mtx_matrix_view_of(const mtx_matrix_t *M_OF, size_t init_i,
+                                     size_t init_j, size_t dy, size_t dx);
+
+// Retorna uma view de dy x dx elementos de M_OF, com o elemento (i, j) da view
+// sendo o elemento (init_i + i * step_i, init_j + j * step_j) de M_OF. Passos
+// negativos percorrem M_OF em ordem reversa (a partir de init_i ou init_j) e
+// passos maiores que 1 pulam linhas ou colunas. Gera MTX_BOUNDS_ERR caso algum
+// elemento esteja fora de M_OF.
+mtx_matrix_view_t mtx_matrix_strided_of(const mtx_matrix_t *M_OF, size_t init_i,
+                                        size_t init_j, size_t dy, size_t dx,
+                                        ptrdiff_t step_i, ptrdiff_t step_j);
+
+// Retorna uma view da transposta de M_OF, sem copiar os elementos.
+mtx_matrix_view_t mtx_matrix_transposed_of(const mtx_matrix_t *M_OF);
+
+// Retorna uma view coluna da diagonal principal de M_OF.
+mtx_matrix_view_t mtx_matrix_diagonal_of(const mtx_matrix_t *M_OF);
+
+// Retorna uma view dos elementos de M_OF, em ordem row-major, com dy linhas e
+// dx colunas. Os elementos de M_OF têm que ser contíguos (uma matriz sem
+// padding entre as linhas ou uma view de linhas inteiras dela, ver
+// MTX_MATRIX_IS_CONTIGUOUS) e em mesmo número (MTX_DIMEN_ERR).
+mtx_matrix_view_t mtx_matrix_reshape_of(const mtx_matrix_t *M_OF, size_t dy,
+                                        size_t dx);
 
 // Cria uma matriz que se referencia a todos os elementos de um dado array, de
 // acordo com dy e dx. Caso 'arr' aponte para memória não alocada por
 // malloc(),calloc() ou realloc(), JAMAIS use mtx_matrix_free() na matriz _M,
 // use mtx_matrix_unref().
-void mtx_matrix_ref_a(mtx_matrix_t *_M, double *arr, int dy, int dx);
+void mtx_matrix_ref_a(mtx_matrix_t *_M, double *arr, size_t dy, size_t dx);
 
-// Retorna o ponteiro C do array dos elementos de uma matriz.
+// Retorna o ponteiro C do array dos elementos de uma matriz. As linhas estão a
+// M->data->ld elementos de distância umas das outras.
 double *mtx_matrix_raw_a(mtx_matrix_t *M);
 
 // Destroi a estrutura da matriz, liberando a memória dos metadados, mas sem
-// liberar a memória do array de elementos.
+// liberar a memória do array de elementos. Gera MTX_INVALID_ERR para matrizes
+// criadas por mtx_matrix_init(), cujos metadados e elementos estão no mesmo
+// bloco, e para matrizes mapeadas (use mtx_matrix_munmap()).
 void mtx_matrix_unref(mtx_matrix_t *__M);
 
 // Retorna uma view da coluna j de M_OF.
@@ -129,21 +247,42 @@ void mtx_matrix_unref(mtx_matrix_t *__M);
 // Copia uma parte dos elementos de M_FROM para M_TO de acordo com a posição
 // relativa a M_FROM.
 int mtx_matrix_copy_from(mtx_matrix_t *M_TO, const mtx_matrix_t *M_FROM,
-                         int init_i, int init_j);
+                         size_t init_i, size_t init_j);
 
 // Escreve a matriz M para o stdout com o prefixo indicando as dimensões dela.
 void mtx_matrix_print(const mtx_matrix_t *M);
 
-// Escreve a matriz M em stream.
+// Escreve a matriz M em stream, uma linha por linha da matriz, com os
+// elementos separados por espaços e escritos com o menor número de dígitos que,
+// lidos de volta com mtx_matrix_fread(), resultam nos mesmos valores.
 void mtx_matrix_fprint(FILE *stream, const mtx_matrix_t *M);
 
+// Maior precisão de mtx_print_opts_t: 17 dígitos distinguem quaisquer doubles.
+#define MTX_PRINT_PRECISION_MAX 17
+
+// Opções de mtx_matrix_fprint_opt().
+typedef struct mtx_print_opts {
+  // Número de dígitos significativos, como em "%.*g" (limitado a
+  // MTX_PRINT_PRECISION_MAX), ou 0 para o menor número de dígitos que preserva
+  // o valor.
+  int precision;
+  // Separador dos elementos de uma linha. NULL equivale a " ".
+  const char *delimiter;
+} mtx_print_opts_t;
+
+// Escreve a matriz M em stream como mtx_matrix_fprint(), com as opções opts
+// (NULL para as opções padrão). Os números são formatados em um buffer interno
+// que é escrito em blocos com fwrite().
+void mtx_matrix_fprint_opt(FILE *stream, const mtx_matrix_t *M,
+                           const mtx_print_opts_t *opts);
+
 // Lê a matriz M de stream.
 void mtx_matrix_fread(FILE *stream, mtx_matrix_t *M);
 
 // Lê uma matriz de stream, auto-detectando as dimensões e retornando o array
 // que representa os elementos lidos na ordem row-major. Provavelmente isso será
 // usado em conjunto com mtx_matrix_fill_a().
-double *mtx_matrix_fread_raw(FILE *stream, int *dy, int *dx);
+double *mtx_matrix_fread_raw(FILE *stream, size_t *dy, size_t *dx);
 
 // Compara as matrizes A e B. Retorna 1 caso todos os elementos de A sejam
 // exatamente iguais aos de B, caso contrário, retorna 0.
@@ -0,0 +1,1936 @@
+#include "matrix_io.h"
+#include "errors.h"
+#include "threads.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+_Static_assert(sizeof(mtx_bin_header_t) == 64,
+               "the binary header must take 64 bytes");
+
+#define FNV1A_PRIME 0x100000001b3ull
+
+uint64_t mtx_fnv1a(uint64_t hash, const void *data, size_t size) {
+  const unsigned char *p = (const unsigned char *)data;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= p[i];
+    hash *= FNV1A_PRIME;
+  }
+  return hash;
+}
+
+#undef FNV1A_PRIME
+
+// Powers of ten exactly representable as doubles.
+static const double __mtx_pow10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// Longest number handed to strtod() by the slow path of _mtx_parse_double().
+#define SLOW_PATH_MAX 128
+
+// Parses inf, infinity or nan in any case, starting after the sign.
+static const char *__mtx_parse_special(const char *p, const char *end,
+                                       int negative, double *x) {
+  size_t left = end - p;
+  if (left >= 8 && strncasecmp(p, "infinity", 8) == 0) {
+    *x = negative ? -INFINITY : INFINITY;
+    return p + 8;
+  }
+  if (left >= 3 && strncasecmp(p, "inf", 3) == 0) {
+    *x = negative ? -INFINITY : INFINITY;
+    return p + 3;
+  }
+  if (left >= 3 && strncasecmp(p, "nan", 3) == 0) {
+    *x = negative ? -NAN : NAN;
+    return p + 3;
+  }
+  return NULL;
+}
+
+const char *_mtx_parse_double(const char *s, const char *end, double *x) {
+  const char *p = s;
+  int negative = 0;
+  if (p < end && (*p == '+' || *p == '-')) {
+    negative = *p++ == '-';
+  }
+  if (p < end && (*p == 'i' || *p == 'I' || *p == 'n' || *p == 'N')) {
+    return __mtx_parse_special(p, end, negative, x);
+  }
+
+  // Up to 19 significant digits fit in the mantissa, the value is
+  // mantissa * 10^exp10. Non zero digits past them make the mantissa inexact.
+  uint64_t mantissa = 0;
+  int digits = 0, exp10 = 0, truncated = 0, any_digit = 0;
+  for (; p < end && *p >= '0' && *p <= '9'; ++p, any_digit = 1) {
+    if (digits < 19) {
+      mantissa = mantissa * 10 + (*p - '0');
+      digits += mantissa != 0;
+    } else {
+      ++exp10;
+      truncated |= *p != '0';
+    }
+  }
+  if (p < end && *p == '.') {
+    for (++p; p < end && *p >= '0' && *p <= '9'; ++p, any_digit = 1) {
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (*p - '0');
+        digits += mantissa != 0;
+        --exp10;
+      } else {
+        truncated |= *p != '0';
+      }
+    }
+  }
+  if (!any_digit) {
+    return NULL;
+  }
+
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    const char *q = p + 1;
+    int exp_negative = 0;
+    if (q < end && (*q == '+' || *q == '-')) {
+      exp_negative = *q++ == '-';
+    }
+    if (q < end && *q >= '0' && *q <= '9') {
+      int e = 0;
+      for (; q < end && *q >= '0' && *q <= '9'; ++q) {
+        // Anything past this over/underflows anyway.
+        if (e < 100000) {
+          e = e * 10 + (*q - '0');
+        }
+      }
+      exp10 += exp_negative ? -e : e;
+      p = q;
+    }
+  }
+
+  // Fast path (Clinger): the mantissa and the power of ten are exact, so a
+  // single multiplication or division rounds correctly.
+  if (mantissa == 0) {
+    *x = negative ? -0.0 : 0.0;
+    return p;
+  }
+  if (!truncated && mantissa <= (1ull << 53) && exp10 >= -22 && exp10 <= 22) {
+    double v = (double)mantissa;
+    v = exp10 < 0 ? v / __mtx_pow10[-exp10] : v * __mtx_pow10[exp10];
+    *x = negative ? -v : v;
+    return p;
+  }
+
+  // Slow path: long mantissas and large exponents, rare in practice, are
+  // left to the correctly rounded strtod().
+  char buf[SLOW_PATH_MAX];
+  size_t len = p - s;
+  if (len >= sizeof(buf)) {
+    return NULL;
+  }
+  for (size_t i = 0; i < len; ++i) {
+    buf[i] = s[i];
+  }
+  buf[len] = '\0';
+  *x = strtod(buf, NULL);
+  return p;
+}
+
+#undef SLOW_PATH_MAX
+
+// Formatting of doubles with the shortest digits that read back to the same
+// value, with the Grisu3 algorithm (Florian Loitsch, "Printing Floating-Point
+// Numbers Quickly and Accurately with Integers", PLDI 2010).
+
+// A floating point number f * 2^e with a 64-bit significand.
+typedef struct mtx_diyfp {
+  uint64_t f;
+  int e;
+} mtx_diyfp_t;
+
+// Normalized approximations of 10^k, for k = -348, -340, ..., 340.
+static const mtx_diyfp_t __mtx_cached_pow10[] = {
+    {0xfa8fd5a0081c0288ull, -1220},
+    {0xbaaee17fa23ebf76ull, -1193},
+    {0x8b16fb203055ac76ull, -1166},
+    {0xcf42894a5dce35eaull, -1140},
+    {0x9a6bb0aa55653b2dull, -1113},
+    {0xe61acf033d1a45dfull, -1087},
+    {0xab70fe17c79ac6caull, -1060},
+    {0xff77b1fcbebcdc4full, -1034},
+    {0xbe5691ef416bd60cull, -1007},
+    {0x8dd01fad907ffc3cull, -980},
+    {0xd3515c2831559a83ull, -954},
+    {0x9d71ac8fada6c9b5ull, -927},
+    {0xea9c227723ee8bcbull, -901},
+    {0xaecc49914078536dull, -874},
+    {0x823c12795db6ce57ull, -847},
+    {0xc21094364dfb5637ull, -821},
+    {0x9096ea6f3848984full, -794},
+    {0xd77485cb25823ac7ull, -768},
+    {0xa086cfcd97bf97f4ull, -741},
+    {0xef340a98172aace5ull, -715},
+    {0xb23867fb2a35b28eull, -688},
+    {0x84c8d4dfd2c63f3bull, -661},
+    {0xc5dd44271ad3cdbaull, -635},
+    {0x936b9fcebb25c996ull, -608},
+    {0xdbac6c247d62a584ull, -582},
+    {0xa3ab66580d5fdaf6ull, -555},
+    {0xf3e2f893dec3f126ull, -529},
+    {0xb5b5ada8aaff80b8ull, -502},
+    {0x87625f056c7c4a8bull, -475},
+    {0xc9bcff6034c13053ull, -449},
+    {0x964e858c91ba2655ull, -422},
+    {0xdff9772470297ebdull, -396},
+    {0xa6dfbd9fb8e5b88full, -369},
+    {0xf8a95fcf88747d94ull, -343},
+    {0xb94470938fa89bcfull, -316},
+    {0x8a08f0f8bf0f156bull, -289},
+    {0xcdb02555653131b6ull, -263},
+    {0x993fe2c6d07b7facull, -236},
+    {0xe45c10c42a2b3b06ull, -210},
+    {0xaa242499697392d3ull, -183},
+    {0xfd87b5f28300ca0eull, -157},
+    {0xbce5086492111aebull, -130},
+    {0x8cbccc096f5088ccull, -103},
+    {0xd1b71758e219652cull, -77},
+    {0x9c40000000000000ull, -50},
+    {0xe8d4a51000000000ull, -24},
+    {0xad78ebc5ac620000ull, 3},
+    {0x813f3978f8940984ull, 30},
+    {0xc097ce7bc90715b3ull, 56},
+    {0x8f7e32ce7bea5c70ull, 83},
+    {0xd5d238a4abe98068ull, 109},
+    {0x9f4f2726179a2245ull, 136},
+    {0xed63a231d4c4fb27ull, 162},
+    {0xb0de65388cc8ada8ull, 189},
+    {0x83c7088e1aab65dbull, 216},
+    {0xc45d1df942711d9aull, 242},
+    {0x924d692ca61be758ull, 269},
+    {0xda01ee641a708deaull, 295},
+    {0xa26da3999aef774aull, 322},
+    {0xf209787bb47d6b85ull, 348},
+    {0xb454e4a179dd1877ull, 375},
+    {0x865b86925b9bc5c2ull, 402},
+    {0xc83553c5c8965d3dull, 428},
+    {0x952ab45cfa97a0b3ull, 455},
+    {0xde469fbd99a05fe3ull, 481},
+    {0xa59bc234db398c25ull, 508},
+    {0xf6c69a72a3989f5cull, 534},
+    {0xb7dcbf5354e9beceull, 561},
+    {0x88fcf317f22241e2ull, 588},
+    {0xcc20ce9bd35c78a5ull, 614},
+    {0x98165af37b2153dfull, 641},
+    {0xe2a0b5dc971f303aull, 667},
+    {0xa8d9d1535ce3b396ull, 694},
+    {0xfb9b7cd9a4a7443cull, 720},
+    {0xbb764c4ca7a44410ull, 747},
+    {0x8bab8eefb6409c1aull, 774},
+    {0xd01fef10a657842cull, 800},
+    {0x9b10a4e5e9913129ull, 827},
+    {0xe7109bfba19c0c9dull, 853},
+    {0xac2820d9623bf429ull, 880},
+    {0x80444b5e7aa7cf85ull, 907},
+    {0xbf21e44003acdd2dull, 933},
+    {0x8e679c2f5e44ff8full, 960},
+    {0xd433179d9c8cb841ull, 986},
+    {0x9e19db92b4e31ba9ull, 1013},
+    {0xeb96bf6ebadf77d9ull, 1039},
+    {0xaf87023b9bf0ee6bull, 1066},
+};
+
+static const uint64_t __mtx_pow10_u64[] = {1ull,
+                                           10ull,
+                                           100ull,
+                                           1000ull,
+                                           10000ull,
+                                           100000ull,
+                                           1000000ull,
+                                           10000000ull,
+                                           100000000ull,
+                                           1000000000ull,
+                                           10000000000ull,
+                                           100000000000ull,
+                                           1000000000000ull,
+                                           10000000000000ull,
+                                           100000000000000ull,
+                                           1000000000000000ull,
+                                           10000000000000000ull,
+                                           100000000000000000ull,
+                                           1000000000000000000ull,
+                                           10000000000000000000ull};
+
+static inline mtx_diyfp_t __mtx_diyfp_mul(mtx_diyfp_t a, mtx_diyfp_t b) {
+  __uint128_t p = (__uint128_t)a.f * b.f;
+  uint64_t h = (uint64_t)(p >> 64), l = (uint64_t)p;
+  // Rounds the discarded half.
+  h += l >> 63;
+  return (mtx_diyfp_t){h, a.e + b.e + 64};
+}
+
+static inline mtx_diyfp_t __mtx_diyfp_normalize(mtx_diyfp_t a) {
+  int s = __builtin_clzll(a.f);
+  return (mtx_diyfp_t){a.f << s, a.e - s};
+}
+
+// Moves the last digit of the buffer towards w while it stays inside the
+// unsafe interval. Returns 0 if the digits can't be proven to be the closest
+// ones to w (Grisu3's round_weed()). Distances are scaled by 10^-kappa.
+static int __mtx_round_weed(char *buffer, int len, uint64_t distance_too_high_w,
+                            uint64_t unsafe_interval, uint64_t rest,
+                            uint64_t ten_kappa, uint64_t unit) {
+  uint64_t small_distance = distance_too_high_w - unit;
+  uint64_t big_distance = distance_too_high_w + unit;
+
+  while (rest < small_distance && unsafe_interval - rest >= ten_kappa &&
+         (rest + ten_kappa < small_distance ||
+          small_distance - rest >= rest + ten_kappa - small_distance)) {
+    buffer[len - 1]--;
+    rest += ten_kappa;
+  }
+
+  if (rest < big_distance && unsafe_interval - rest >= ten_kappa &&
+      (rest + ten_kappa < big_distance ||
+       big_distance - rest > rest + ten_kappa - big_distance)) {
+    return 0;
+  }
+
+  return 2 * unit <= rest && rest <= unsafe_interval - 4 * unit;
+}
+
+// Generates the shortest digits of a positive, finite x into buffer, with
+// Grisu3: x is buffer * 10^k. Returns the number of digits (at most 17), or 0
+// in the rare cases (about 0.5%) the result can't be proven shortest and
+// correct.
+static int __mtx_grisu3(double x, char *buffer, int *k) {
+  union {
+    double d;
+    uint64_t u;
+  } pun = {x};
+  uint64_t bits = pun.u;
+  int biased_e = (int)(bits >> 52 & 0x7ff);
+  uint64_t significand = bits & ((1ull << 52) - 1);
+  mtx_diyfp_t v = biased_e != 0
+                      ? (mtx_diyfp_t){significand | 1ull << 52, biased_e - 1075}
+                      : (mtx_diyfp_t){significand, -1074};
+
+  // Boundaries m- and m+ halfway to the neighbours of v, with the exponent of
+  // the normalized v.
+  mtx_diyfp_t w = __mtx_diyfp_normalize(v);
+  mtx_diyfp_t m_p =
+      __mtx_diyfp_normalize((mtx_diyfp_t){(v.f << 1) + 1, v.e - 1});
+  mtx_diyfp_t m_m = v.f == 1ull << 52 && biased_e > 1
+                        ? (mtx_diyfp_t){(v.f << 2) - 1, v.e - 2}
+                        : (mtx_diyfp_t){(v.f << 1) - 1, v.e - 1};
+  m_m.f <<= m_m.e - m_p.e;
+  m_m.e = m_p.e;
+
+  // Cached power c = 10^-mk such that the exponent of w * c lies in
+  // [-60, -32].
+  double dk = (-61 - w.e) * 0.30102999566398114 + 347;
+  int ik = (int)dk;
+  if (dk - ik > 0.0) {
+    ++ik;
+  }
+  unsigned index = (unsigned)(ik >> 3) + 1;
+  int mk = -348 + (int)index * 8;
+  mtx_diyfp_t c = __mtx_cached_pow10[index];
+
+  // The products have an error of at most one unit, so the digits are
+  // generated inside the interval that is surely outside of the boundaries
+  // (too_low, too_high) and checked against the one surely inside them.
+  mtx_diyfp_t sw = __mtx_diyfp_mul(w, c);
+  mtx_diyfp_t s_m = __mtx_diyfp_mul(m_m, c);
+  mtx_diyfp_t s_p = __mtx_diyfp_mul(m_p, c);
+
+  uint64_t unit = 1;
+  uint64_t too_low = s_m.f - unit, too_high = s_p.f + unit;
+  uint64_t unsafe_interval = too_high - too_low;
+  const int shift = -sw.e;
+  const uint64_t one = 1ull << shift;
+  uint32_t integrals = (uint32_t)(too_high >> shift);
+  uint64_t fractionals = too_high & (one - 1);
+
+  int kappa = 1;
+  while (kappa < 10 && integrals >= __mtx_pow10_u64[kappa]) {
+    ++kappa;
+  }
+
+  int len = 0;
+  while (kappa > 0) {
+    uint32_t divisor = (uint32_t)__mtx_pow10_u64[kappa - 1];
+    buffer[len++] = (char)('0' + integrals / divisor);
+    integrals %= divisor;
+    --kappa;
+    uint64_t rest = ((uint64_t)integrals << shift) + fractionals;
+    if (rest < unsafe_interval) {
+      *k = kappa - mk;
+      return __mtx_round_weed(buffer, len, too_high - sw.f, unsafe_interval,
+                              rest, (uint64_t)divisor << shift, unit)
+                 ? len
+                 : 0;
+    }
+  }
+
+  for (;;) {
+    fractionals *= 10;
+    unit *= 10;
+    unsafe_interval *= 10;
+    buffer[len++] = (char)('0' + (fractionals >> shift));
+    fractionals &= one - 1;
+    --kappa;
+    if (fractionals < unsafe_interval) {
+      *k = kappa - mk;
+      return __mtx_round_weed(buffer, len, (too_high - sw.f) * unit,
+                              unsafe_interval, fractionals, one, unit)
+                 ? len
+                 : 0;
+    }
+  }
+}
+
+// Fallback of __mtx_grisu3(): the shortest of printf's correctly rounded 15,
+// 16 or 17 digits that reads back to x.
+static int __mtx_shortest_printf(double x, char *buffer, int *k) {
+  char s[MTX_DOUBLE_CHARS_MAX];
+  int digits = 15;
+  for (; digits < 17; ++digits) {
+    snprintf(s, sizeof(s), "%.*e", digits - 1, x);
+    if (strtod(s, NULL) == x) {
+      break;
+    }
+  }
+  snprintf(s, sizeof(s), "%.*e", digits - 1, x);
+
+  // d.ddddde[+-]xx
+  int len = 0;
+  const char *p = s;
+  for (; *p != 'e'; ++p) {
+    if (*p != '.') {
+      buffer[len++] = *p;
+    }
+  }
+  while (len > 1 && buffer[len - 1] == '0') {
+    --len;
+  }
+  *k = atoi(p + 1) - (len - 1);
+  return len;
+}
+
+// Writes the exponent of the scientific notation.
+static int __mtx_write_exponent(char *p, int e) {
+  int n = 0;
+  p[n++] = 'e';
+  if (e < 0) {
+    p[n++] = '-';
+    e = -e;
+  }
+  if (e >= 100) {
+    p[n++] = (char)('0' + e / 100);
+    e %= 100;
+    p[n++] = (char)('0' + e / 10);
+  } else if (e >= 10) {
+    p[n++] = (char)('0' + e / 10);
+  }
+  p[n++] = (char)('0' + e % 10);
+  return n;
+}
+
+int _mtx_format_double(char *buf, double x) {
+  char *p = buf;
+
+  if (x != x) {
+    memcpy(p, "nan", 3);
+    return 3;
+  }
+  if (signbit(x)) {
+    *p++ = '-';
+    x = -x;
+  }
+  if (x == 0) {
+    *p++ = '0';
+    return (int)(p - buf);
+  }
+  if (isinf(x)) {
+    memcpy(p, "inf", 3);
+    return (int)(p - buf) + 3;
+  }
+
+  char digits[20];
+  int k;
+  int n = __mtx_grisu3(x, digits, &k);
+  if (n == 0) {
+    n = __mtx_shortest_printf(x, digits, &k);
+  }
+  // Position of the decimal point relative to the first digit.
+  int point = n + k;
+
+  if (n <= point && point <= 21) {
+    // Integer: 1234e3 -> 1234000.
+    memcpy(p, digits, n);
+    memset(p + n, '0', point - n);
+    p += point;
+  } else if (0 < point && point <= 21) {
+    // 1234e-2 -> 12.34.
+    memcpy(p, digits, point);
+    p[point] = '.';
+    memcpy(p + point + 1, digits + point, n - point);
+    p += n + 1;
+  } else if (-6 < point && point <= 0) {
+    // 1234e-6 -> 0.001234.
+    p[0] = '0';
+    p[1] = '.';
+    memset(p + 2, '0', -point);
+    memcpy(p + 2 - point, digits, n);
+    p += 2 - point + n;
+  } else {
+    // 1234e30 -> 1.234e33.
+    *p++ = digits[0];
+    if (n > 1) {
+      *p++ = '.';
+      memcpy(p, digits + 1, n - 1);
+      p += n - 1;
+    }
+    p += __mtx_write_exponent(p, point - 1);
+  }
+
+  return (int)(p - buf);
+}
+
+#define FWRITE_ALL(ptr, size, stream)                                          \
+  do {                                                                         \
+    if (fwrite(ptr, 1, size, stream) != (size)) {                              \
+      MTX_SYSTEM_ERR("fwrite");                                                \
+    }                                                                          \
+  } while (0)
+
+// Continues hash with the elements of the rows of M.
+static uint64_t __mtx_bin_checksum(uint64_t hash, const mtx_matrix_t *M) {
+  for (size_t i = 0; i < M->dy; ++i) {
+    if (MTX_MATRIX_HAS_UNIT_COLUMNS(M)) {
+      hash = mtx_fnv1a(hash, mtx_matrix_row(M, i), M->dx * sizeof(double));
+      continue;
+    }
+    for (size_t j = 0; j < M->dx; ++j) {
+      hash = mtx_fnv1a(hash, &mtx_matrix_at(M, i, j), sizeof(double));
+    }
+  }
+  return hash;
+}
+
+// Writes the elements of M to stream.
+static void __mtx_bin_write_rows(FILE *stream, const mtx_matrix_t *M) {
+  size_t row_size = M->dx * sizeof(double);
+
+  if (MTX_MATRIX_IS_CONTIGUOUS(M)) {
+    FWRITE_ALL(mtx_matrix_row(M, 0), row_size * M->dy, stream);
+  } else if (!MTX_MATRIX_HAS_UNIT_COLUMNS(M)) {
+    for (size_t i = 0; i < M->dy; ++i) {
+      for (size_t j = 0; j < M->dx; ++j) {
+        FWRITE_ALL(&mtx_matrix_at(M, i, j), sizeof(double), stream);
+      }
+    }
+  } else {
+    for (size_t i = 0; i < M->dy; ++i) {
+      FWRITE_ALL(mtx_matrix_row(M, i), row_size, stream);
+    }
+  }
+}
+
+void mtx_matrix_fwrite_bin(FILE *stream, const mtx_matrix_t *M, int flags) {
+  MTX_ENSURE_INIT(M);
+  if (stream == NULL) {
+    MTX_SYSTEM_ERR("fwrite");
+  }
+
+  mtx_bin_header_t header = {
+      .magic = MTX_BIN_MAGIC,
+      .version = MTX_BIN_VERSION,
+      .dtype = MTX_BIN_FLOAT64,
+      .flags = flags & MTX_BIN_CHECKSUM,
+      .endian = MTX_BIN_ENDIAN_TAG,
+      .rows = M->dy,
+      .cols = M->dx,
+  };
+  if (header.flags & MTX_BIN_CHECKSUM) {
+    header.checksum = __mtx_bin_checksum(MTX_FNV1A_INIT, M);
+  }
+
+  FWRITE_ALL(&header, sizeof(header), stream);
+  __mtx_bin_write_rows(stream, M);
+}
+
+#undef FWRITE_ALL
+
+static void __mtx_bin_swap(uint64_t *p, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    p[i] = __builtin_bswap64(p[i]);
+  }
+}
+
+// Reads the elements of M from stream, continuing *checksum (if not NULL) with
+// the bytes as they are stored in the file. Returns 1 if the stream ends before
+// them.
+static int __mtx_bin_read_rows(FILE *stream, mtx_matrix_t *M,
+                               uint64_t *checksum, int swapped) {
+  size_t row_size = M->dx * sizeof(double);
+
+#define FREAD_ALL(ptr, size)                                                   \
+  do {                                                                         \
+    if (fread(ptr, 1, size, stream) != (size)) {                               \
+      if (ferror(stream)) {                                                    \
+        MTX_SYSTEM_ERR("fread");                                               \
+      }                                                                        \
+      return 1;                                                                \
+    }                                                                          \
+  } while (0)
+
+  if (MTX_MATRIX_IS_CONTIGUOUS(M)) {
+    FREAD_ALL(mtx_matrix_row(M, 0), row_size * M->dy);
+  } else {
+    for (size_t i = 0; i < M->dy; ++i) {
+      FREAD_ALL(mtx_matrix_row(M, i), row_size);
+    }
+  }
+
+#undef FREAD_ALL
+
+  if (checksum != NULL) {
+    *checksum = __mtx_bin_checksum(*checksum, M);
+  }
+
+  if (swapped) {
+    for (size_t i = 0; i < M->dy; ++i) {
+      __mtx_bin_swap((uint64_t *)mtx_matrix_row(M, i), M->dx);
+    }
+  }
+
+  return 0;
+}
+
+// Reads the elements of M from stream. Returns 1 if the stream ends before them
+// or if they don't match the checksum of the header.
+static int __mtx_bin_read_elements(FILE *stream, mtx_matrix_t *M,
+                                   const mtx_bin_header_t *header,
+                                   int swapped) {
+  uint64_t checksum = MTX_FNV1A_INIT;
+  int checked = header->flags & MTX_BIN_CHECKSUM;
+
+  return __mtx_bin_read_rows(stream, M, checked ? &checksum : NULL,
+                             swapped) != 0 ||
+         (checked && checksum != header->checksum);
+}
+
+// Validates a binary header, converting it to the host byte order. Returns 1
+// if it isn't a valid header.
+static int __mtx_bin_check_header(mtx_bin_header_t *header, int *swapped) {
+  *swapped = header->endian == __builtin_bswap32(MTX_BIN_ENDIAN_TAG);
+  if (*swapped) {
+    header->version = __builtin_bswap16(header->version);
+    header->rows = __builtin_bswap64(header->rows);
+    header->cols = __builtin_bswap64(header->cols);
+    header->checksum = __builtin_bswap64(header->checksum);
+  } else if (header->endian != MTX_BIN_ENDIAN_TAG) {
+    return 1;
+  }
+
+  return memcmp(header->magic, MTX_BIN_MAGIC, sizeof(header->magic)) != 0 ||
+         header->version != MTX_BIN_VERSION ||
+         header->dtype != MTX_BIN_FLOAT64 || header->rows == 0 ||
+         header->cols == 0 || header->rows > SIZE_MAX ||
+         header->cols > SIZE_MAX;
+}
+
+int mtx_matrix_fread_bin(FILE *stream, mtx_matrix_t *_M) {
+  if (stream == NULL) {
+    MTX_SYSTEM_ERR("fread");
+  }
+
+  mtx_bin_header_t header;
+  int swapped;
+  if (fread(&header, 1, sizeof(header), stream) != sizeof(header)) {
+    if (ferror(stream)) {
+      MTX_SYSTEM_ERR("fread");
+    }
+    return 1;
+  }
+  if (__mtx_bin_check_header(&header, &swapped) != 0 ||
+      header.cols > SIZE_MAX / sizeof(double) / header.rows) {
+    return 1;
+  }
+
+  // The elements of a regular file must be there before the matrix is
+  // allocated, so a bad header can't ask for any amount of memory.
+  struct stat st;
+  off_t at = ftello(stream);
+  if (fstat(fileno(stream), &st) == 0 && S_ISREG(st.st_mode) && at >= 0 &&
+      (st.st_size < at || (uint64_t)(st.st_size - at) <
+                              header.rows * header.cols * sizeof(double))) {
+    return 1;
+  }
+
+  size_t dy = header.rows, dx = header.cols;
+  int initialized = 0;
+  if (_M->data == NULL) {
+    mtx_matrix_init(_M, dy, dx);
+    initialized = 1;
+  } else if (_M->dy != dy || _M->dx != dx) {
+    MTX_DIMEN_ERR(_M);
+  } else {
+    MTX_ENSURE_UNIT_COLUMNS(_M);
+  }
+
+  if (__mtx_bin_read_elements(stream, _M, &header, swapped) != 0) {
+    if (initialized) {
+      mtx_matrix_free(_M);
+    }
+    return 1;
+  }
+
+  return 0;
+}
+
+int mtx_matrix_mmap(mtx_matrix_t *_M, const char *path, int mode) {
+  int writable = mode & (MTX_MMAP_WRITE | MTX_MMAP_PRIVATE);
+
+  int fd = open(path, mode & MTX_MMAP_WRITE ? O_RDWR : O_RDONLY);
+  if (fd < 0) {
+    MTX_SYSTEM_ERR("open");
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    MTX_SYSTEM_ERR("fstat");
+  }
+
+  // The header is read before mapping to know the size of the mapping.
+  mtx_bin_header_t header;
+  int swapped;
+  if (pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+      __mtx_bin_check_header(&header, &swapped) != 0 || swapped ||
+      header.cols > (SIZE_MAX - sizeof(header)) / sizeof(double) /
+                        header.rows ||
+      (uint64_t)st.st_size <
+          sizeof(header) + header.rows * header.cols * sizeof(double)) {
+    close(fd);
+    return 1;
+  }
+
+  size_t dy = header.rows, dx = header.cols;
+  size_t length = sizeof(header) + dy * dx * sizeof(double);
+  void *map = mmap(NULL, length, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                   mode & MTX_MMAP_PRIVATE ? MAP_PRIVATE : MAP_SHARED, fd, 0);
+  // The mapping stays valid after the descriptor is closed.
+  close(fd);
+  if (map == MAP_FAILED) {
+    MTX_SYSTEM_ERR("mmap");
+  }
+
+  double *m = (double *)((char *)map + sizeof(header));
+  if ((mode & MTX_MMAP_VERIFY) && (header.flags & MTX_BIN_CHECKSUM) &&
+      mtx_fnv1a(MTX_FNV1A_INIT, m, length - sizeof(header)) !=
+          header.checksum) {
+    munmap(map, length);
+    return 1;
+  }
+
+  mtx_matrix_ref_a(_M, m, dy, dx);
+  _M->data->flags |= MTX_MATRIX_DATA_MAPPED;
+
+  return 0;
+}
+
+void mtx_matrix_munmap(mtx_matrix_t *__M) {
+  if (__M == NULL || __M->data == NULL) {
+    return;
+  }
+  if (!(__M->data->flags & MTX_MATRIX_DATA_MAPPED) || MTX_MATRIX_IS_VIEW(__M)) {
+    MTX_INVALID_ERR(__M);
+  }
+
+  // The mapping starts at the page where the header of the file (or, for big
+  // headers, the elements) begins.
+  uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+  char *m = (char *)__M->data->m;
+  char *base = (char *)((uintptr_t)m & ~(page - 1));
+  size_t length =
+      (m - base) + __M->data->size1 * __M->data->size2 * sizeof(double);
+  if (munmap(base, length) != 0) {
+    MTX_SYSTEM_ERR("munmap");
+  }
+
+  free(__M->data);
+  __M->data = NULL;
+}
+
+// Files smaller than this are parsed by the calling thread alone.
+#define TEXT_CHUNK_MIN (1 << 20)
+
+// A piece of a text file that starts at the beginning of a line and ends after
+// a line break (or at the end of the file).
+typedef struct mtx_text_chunk {
+  const char *begin, *end;
+  // Non empty lines and their number of elements.
+  size_t rows, cols;
+  // Row of the matrix where the chunk starts.
+  size_t first_row;
+  int invalid;
+} mtx_text_chunk_t;
+
+typedef struct mtx_text_job {
+  mtx_text_chunk_t *chunks;
+  // NULL while counting the rows and columns of the chunks.
+  mtx_matrix_t *M;
+} mtx_text_job_t;
+
+// Counts the rows and columns of a chunk or, once M is allocated, parses its
+// elements into the rows of M. Lines with a different number of elements or
+// with anything other than numbers and delimiters make the chunk invalid.
+static void __mtx_text_chunk(mtx_text_chunk_t *chunk, mtx_matrix_t *M) {
+  const char *p = chunk->begin, *end = chunk->end;
+  size_t rows = 0, row_cols = 0;
+  double *row = NULL;
+  ptrdiff_t cs = M != NULL ? mtx_matrix_col_stride(M) : 1;
+
+  for (;;) {
+    int char_class = p < end ? _mtx_text_char_class(*p) : MTX_TEXT_LINE_END;
+
+    if (char_class == MTX_TEXT_NUMBER) {
+      const char *q = p + 1;
+      while (q < end && _mtx_text_char_class(*q) == MTX_TEXT_NUMBER) {
+        ++q;
+      }
+      if (M != NULL) {
+        if (row_cols == 0) {
+          row = mtx_matrix_row(M, chunk->first_row + rows);
+        }
+        if (row_cols >= M->dx ||
+            _mtx_parse_double(p, q, &row[row_cols * cs]) != q) {
+          chunk->invalid = 1;
+          return;
+        }
+      }
+      ++row_cols;
+      p = q;
+    } else if (char_class == MTX_TEXT_DELIMITER) {
+      ++p;
+    } else if (char_class == MTX_TEXT_LINE_END) {
+      if (row_cols > 0) {
+        if (rows == 0 && M == NULL) {
+          chunk->cols = row_cols;
+        } else if (row_cols != chunk->cols) {
+          chunk->invalid = 1;
+          return;
+        }
+        ++rows;
+        row_cols = 0;
+      }
+      if (p++ >= end) {
+        break;
+      }
+    } else {
+      chunk->invalid = 1;
+      return;
+    }
+  }
+
+  chunk->rows = rows;
+}
+
+static void __mtx_text_task(void *arg, size_t begin, size_t end) {
+  mtx_text_job_t *job = (mtx_text_job_t *)arg;
+  for (size_t i = begin; i < end; ++i) {
+    __mtx_text_chunk(&job->chunks[i], job->M);
+  }
+}
+
+// Parses the n chunks on the threads of the pool, or on the calling thread if
+// there's only one. Returns 1 if any of them is invalid.
+static int __mtx_text_run(mtx_text_job_t *job, size_t n) {
+  if (n > 1) {
+    mtx_parallel_for(0, n, 1, __mtx_text_task, job);
+  } else {
+    __mtx_text_task(job, 0, n);
+  }
+
+  for (size_t i = 0; i < n; ++i) {
+    if (job->chunks[i].invalid) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Splits text into chunks, counts their rows and columns and, if they all have
+// the same number of columns, parses them into _M.
+static int __mtx_text_load(mtx_matrix_t *_M, const char *text, size_t size) {
+  size_t n = 1;
+  if (size >= TEXT_CHUNK_MIN) {
+    // A few chunks per thread so the pool can balance them.
+    n = size / (TEXT_CHUNK_MIN / 4);
+    size_t max_chunks = 4 * (size_t)mtx_cfg_get_num_threads();
+    n = n < max_chunks ? n : max_chunks;
+  }
+
+  mtx_text_chunk_t *chunks =
+      (mtx_text_chunk_t *)mtx_mem_alloc(sizeof(mtx_text_chunk_t) * n);
+  const char *end = text + size;
+  size_t used = 0;
+  for (const char *begin = text; begin < end; ++used) {
+    // Each chunk ends after the first line break past its share of the text.
+    const char *chunk_end = text + size / n * (used + 1);
+    if (used == n - 1 || chunk_end >= end) {
+      chunk_end = end;
+    } else {
+      if (chunk_end < begin) {
+        chunk_end = begin;
+      }
+      const char *nl = (const char *)memchr(chunk_end, '\n', end - chunk_end);
+      chunk_end = nl != NULL ? nl + 1 : end;
+    }
+
+    chunks[used] = (mtx_text_chunk_t){.begin = begin, .end = chunk_end};
+    begin = chunk_end;
+  }
+  n = used;
+
+  mtx_text_job_t job = {.chunks = chunks, .M = NULL};
+  int ret = __mtx_text_run(&job, n);
+
+  // Stitches the chunks: all of them must have the same number of columns.
+  size_t dy = 0, dx = 0;
+  for (size_t i = 0; ret == 0 && i < n; ++i) {
+    if (chunks[i].rows == 0) {
+      continue;
+    }
+    if (dx == 0) {
+      dx = chunks[i].cols;
+    } else if (chunks[i].cols != dx) {
+      ret = 1;
+    }
+    chunks[i].first_row = dy;
+    dy += chunks[i].rows;
+  }
+  if (ret != 0 || dy == 0) {
+    free(chunks);
+    return 1;
+  }
+
+  int initialized = 0;
+  if (_M->data == NULL) {
+    mtx_matrix_init(_M, dy, dx);
+    initialized = 1;
+  } else if (_M->dy != dy || _M->dx != dx) {
+    free(chunks);
+    MTX_DIMEN_ERR(_M);
+  }
+
+  job.M = _M;
+  for (size_t i = 0; i < n; ++i) {
+    chunks[i].cols = dx;
+  }
+  ret = __mtx_text_run(&job, n);
+
+  free(chunks);
+  if (ret != 0 && initialized) {
+    mtx_matrix_free(_M);
+  }
+  return ret;
+}
+
+#undef TEXT_CHUNK_MIN
+
+int mtx_matrix_load_text(mtx_matrix_t *_M, const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    MTX_SYSTEM_ERR("open");
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    MTX_SYSTEM_ERR("fstat");
+  }
+  if (st.st_size == 0) {
+    close(fd);
+    return 1;
+  }
+
+  size_t size = st.st_size;
+  void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    MTX_SYSTEM_ERR("mmap");
+  }
+  madvise(map, size, MADV_SEQUENTIAL);
+
+  int ret = __mtx_text_load(_M, (const char *)map, size);
+
+  munmap(map, size);
+  return ret;
+}
+
+// Initial size of the read buffer of text streams, which grows to fit the
+// longest line.
+#define STREAM_BUFFER_SIZE (64 * 1024)
+
+// Reads more of the file into the buffer of a text stream, after the bytes not
+// read yet, growing the buffer if they fill it.
+static void __mtx_stream_fill(mtx_matrix_stream_t *S) {
+  size_t pending = S->end - S->begin;
+  if (S->begin > 0) {
+    memmove(S->buffer, S->buffer + S->begin, pending);
+    S->begin = 0;
+    S->end = pending;
+  }
+  if (S->end == S->capacity) {
+    char *grown = (char *)realloc(S->buffer, 2 * S->capacity);
+    if (grown == NULL) {
+      MTX_SYSTEM_ERR("realloc");
+    }
+    S->buffer = grown;
+    S->capacity *= 2;
+  }
+
+  size_t n = fread(S->buffer + S->end, 1, S->capacity - S->end, S->file);
+  if (n == 0) {
+    if (ferror(S->file)) {
+      MTX_SYSTEM_ERR("fread");
+    }
+    S->eof = 1;
+  }
+  S->end += n;
+}
+
+// Makes the block of S hold at least max_rows rows.
+static void __mtx_stream_reserve(mtx_matrix_stream_t *S, size_t max_rows) {
+  if (S->block.data != NULL) {
+    if (S->block.dy >= max_rows) {
+      return;
+    }
+    mtx_matrix_free(&S->block);
+  }
+  mtx_matrix_init(&S->block, max_rows, S->cols);
+}
+
+// Finds the next line of a read stream, up to the next line break (not
+// included) or the end of the file, and consumes it. The line stays valid until
+// the buffer is filled again. Returns 0 at the end of the file.
+static int __mtx_stream_line(mtx_matrix_stream_t *S, const char **line,
+                             const char **line_end) {
+  size_t scanned = 0;
+
+  for (;;) {
+    const char *begin = S->buffer + S->begin, *end = S->buffer + S->end;
+    const char *p = begin + scanned;
+    while (p < end && _mtx_text_char_class(*p) != MTX_TEXT_LINE_END) {
+      ++p;
+    }
+    if (p == end && !S->eof) {
+      scanned = p - begin;
+      __mtx_stream_fill(S);
+      continue;
+    }
+    if (begin == end) {
+      return 0;
+    }
+
+    *line = begin;
+    *line_end = p;
+    S->begin += (p - begin) + (p < end);
+    return 1;
+  }
+}
+
+// Parses up to max_rows lines of a text stream into its block, one at a time
+// with the chunk parser of mtx_matrix_load_text(). Returns the number of rows.
+static size_t __mtx_stream_text_rows(mtx_matrix_stream_t *S, size_t max_rows) {
+  size_t rows = 0;
+  mtx_text_chunk_t chunk = {0};
+
+  while (rows < max_rows && __mtx_stream_line(S, &chunk.begin, &chunk.end)) {
+    if (S->cols == 0) {
+      __mtx_text_chunk(&chunk, NULL);
+      if (chunk.invalid) {
+        S->invalid = 1;
+        return 0;
+      }
+      if (chunk.rows == 0) {
+        continue;
+      }
+      S->cols = chunk.cols;
+      __mtx_stream_reserve(S, max_rows);
+    }
+
+    chunk.cols = S->cols;
+    chunk.first_row = rows;
+    __mtx_text_chunk(&chunk, &S->block);
+    if (chunk.invalid) {
+      S->invalid = 1;
+      return 0;
+    }
+    rows += chunk.rows;
+  }
+
+  return rows;
+}
+
+// Reads up to max_rows rows of a binary stream into its block and, after the
+// last one, checks the checksum of the file. Returns the number of rows.
+static size_t __mtx_stream_bin_rows(mtx_matrix_stream_t *S, size_t max_rows) {
+  size_t left = S->header.rows - S->rows;
+  size_t rows = max_rows < left ? max_rows : left;
+  if (rows == 0) {
+    return 0;
+  }
+
+  int checked = S->header.flags & MTX_BIN_CHECKSUM;
+  mtx_matrix_view_t part = mtx_matrix_view_of(&S->block, 0, 0, rows, S->cols);
+  if (__mtx_bin_read_rows(S->file, &part.matrix, checked ? &S->checksum : NULL,
+                          S->swapped) != 0 ||
+      (checked && rows == left && S->checksum != S->header.checksum)) {
+    S->invalid = 1;
+    return 0;
+  }
+
+  return rows;
+}
+
+int mtx_matrix_stream_open(mtx_matrix_stream_t *S, const char *path) {
+  *S = (mtx_matrix_stream_t){.format = MTX_STREAM_TEXT};
+  S->file = fopen(path, "rb");
+  if (S->file == NULL) {
+    MTX_SYSTEM_ERR("fopen");
+  }
+  S->buffer = (char *)mtx_mem_alloc(STREAM_BUFFER_SIZE);
+  S->capacity = STREAM_BUFFER_SIZE;
+
+  // The format is detected by the magic of the binary header.
+  __mtx_stream_fill(S);
+  if (S->end < sizeof(S->header.magic) ||
+      memcmp(S->buffer, MTX_BIN_MAGIC, sizeof(S->header.magic)) != 0) {
+    return 0;
+  }
+
+  S->format = MTX_STREAM_BINARY;
+  if (S->end < sizeof(S->header)) {
+    mtx_matrix_stream_close(S);
+    return 1;
+  }
+  memcpy(&S->header, S->buffer, sizeof(S->header));
+  free(S->buffer);
+  S->buffer = NULL;
+  if (__mtx_bin_check_header(&S->header, &S->swapped) != 0) {
+    mtx_matrix_stream_close(S);
+    return 1;
+  }
+  if (fseek(S->file, sizeof(S->header), SEEK_SET) != 0) {
+    mtx_matrix_stream_close(S);
+    MTX_SYSTEM_ERR("fseek");
+  }
+  S->cols = S->header.cols;
+  S->checksum = MTX_FNV1A_INIT;
+
+  return 0;
+}
+
+void mtx_matrix_stream_create(mtx_matrix_stream_t *S, const char *path,
+                              int format) {
+  *S = (mtx_matrix_stream_t){.format = format, .writing = 1};
+  S->file = fopen(path, "wb");
+  if (S->file == NULL) {
+    MTX_SYSTEM_ERR("fopen");
+  }
+
+  if (format == MTX_STREAM_BINARY) {
+    // Rewritten with the dimensions and the checksum once the stream is closed.
+    S->header = (mtx_bin_header_t){
+        .magic = MTX_BIN_MAGIC,
+        .version = MTX_BIN_VERSION,
+        .dtype = MTX_BIN_FLOAT64,
+        .flags = MTX_BIN_CHECKSUM,
+        .endian = MTX_BIN_ENDIAN_TAG,
+    };
+    S->checksum = MTX_FNV1A_INIT;
+    if (fwrite(&S->header, 1, sizeof(S->header), S->file) !=
+        sizeof(S->header)) {
+      MTX_SYSTEM_ERR("fwrite");
+    }
+  }
+}
+
+size_t mtx_matrix_stream_next_block(mtx_matrix_stream_t *S,
+                                    mtx_matrix_view_t *view, size_t max_rows) {
+  if (S->file == NULL || S->writing) {
+    MTX_SYSTEM_ERR("fread");
+  }
+  if (S->invalid || max_rows == 0) {
+    return 0;
+  }
+
+  size_t rows;
+  if (S->format == MTX_STREAM_BINARY) {
+    __mtx_stream_reserve(S, max_rows < S->header.rows ? max_rows
+                                                      : S->header.rows);
+    rows = __mtx_stream_bin_rows(S, max_rows);
+  } else {
+    if (S->cols > 0) {
+      __mtx_stream_reserve(S, max_rows);
+    }
+    rows = __mtx_stream_text_rows(S, max_rows);
+  }
+
+  if (rows > 0) {
+    *view = mtx_matrix_view_of(&S->block, 0, 0, rows, S->cols);
+    S->rows += rows;
+  }
+  return rows;
+}
+
+void mtx_matrix_stream_write_block(mtx_matrix_stream_t *S,
+                                   const mtx_matrix_t *M) {
+  MTX_ENSURE_INIT(M);
+  if (S->file == NULL || !S->writing) {
+    MTX_SYSTEM_ERR("fwrite");
+  }
+  if (S->cols == 0) {
+    S->cols = M->dx;
+  } else if (M->dx != S->cols) {
+    MTX_DIMEN_ERR(M);
+  }
+
+  if (S->format == MTX_STREAM_BINARY) {
+    S->checksum = __mtx_bin_checksum(S->checksum, M);
+    __mtx_bin_write_rows(S->file, M);
+  } else {
+    mtx_matrix_fprint(S->file, M);
+  }
+  S->rows += M->dy;
+}
+
+int mtx_matrix_stream_close(mtx_matrix_stream_t *S) {
+  int ret = S->invalid;
+
+  free(S->buffer);
+  S->buffer = NULL;
+  if (S->block.data != NULL) {
+    mtx_matrix_free(&S->block);
+  }
+  if (S->file == NULL) {
+    return ret;
+  }
+
+  FILE *file = S->file;
+  S->file = NULL;
+  int written = 1;
+  if (S->writing && S->format == MTX_STREAM_BINARY) {
+    S->header.rows = S->rows;
+    S->header.cols = S->cols;
+    S->header.checksum = S->checksum;
+    written = fseek(file, 0, SEEK_SET) == 0 &&
+              fwrite(&S->header, 1, sizeof(S->header), file) ==
+                  sizeof(S->header);
+  }
+  if (fclose(file) != 0 || !written) {
+    MTX_SYSTEM_ERR(written ? "fclose" : "fwrite");
+  }
+
+  return ret;
+}
+
+// Matrix Market (https://math.nist.gov/MatrixMarket/formats.html).
+
+#define MM_BANNER "%%MatrixMarket"
+
+typedef struct mtx_mm_info {
+  int coordinate;
+  int pattern;
+  int symmetry;
+  size_t rows, cols;
+  // Entries stored in the file.
+  size_t entries;
+} mtx_mm_info_t;
+
+// Destination of the entries: the dense matrix M or the coordinates of a sparse
+// one, which grow as the entries are read.
+typedef struct mtx_mm_target {
+  mtx_matrix_t *M;
+  size_t *rows, *cols;
+  double *vals;
+  size_t n, capacity;
+} mtx_mm_target_t;
+
+static const char *__mtx_mm_skip(const char *p, const char *end) {
+  while (p < end && (*p == ' ' || *p == '\t')) {
+    ++p;
+  }
+  return p;
+}
+
+// Returns 1 if the next word of [*p, end) is word (ignoring the case) and
+// consumes it.
+static int __mtx_mm_word(const char **p, const char *end, const char *word) {
+  const char *begin = __mtx_mm_skip(*p, end), *q = begin;
+  while (q < end && *q != ' ' && *q != '\t') {
+    ++q;
+  }
+  size_t len = strlen(word);
+  if ((size_t)(q - begin) != len || strncasecmp(begin, word, len) != 0) {
+    return 0;
+  }
+  *p = q;
+  return 1;
+}
+
+// Parses an unsigned decimal integer. Returns the pointer after it or NULL.
+static const char *__mtx_mm_size(const char *p, const char *end, size_t *x) {
+  p = __mtx_mm_skip(p, end);
+  const char *begin = p;
+  size_t v = 0;
+  for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+    size_t digit = *p - '0';
+    if (v > (SIZE_MAX - digit) / 10) {
+      return NULL;
+    }
+    v = v * 10 + digit;
+  }
+  *x = v;
+  return p > begin ? p : NULL;
+}
+
+// Parses a number ending at a delimiter or at the end of the line.
+static const char *__mtx_mm_value(const char *p, const char *end, double *x) {
+  p = __mtx_mm_skip(p, end);
+  p = _mtx_parse_double(p, end, x);
+  return p != NULL && (p == end || *p == ' ' || *p == '\t') ? p : NULL;
+}
+
+// Next line that isn't empty nor a comment. Returns 0 at the end of the file.
+static int __mtx_mm_line(mtx_matrix_stream_t *S, const char **line,
+                         const char **end) {
+  while (__mtx_stream_line(S, line, end)) {
+    const char *p = __mtx_mm_skip(*line, *end);
+    if (p < *end && *p != '%') {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Reads the banner and the size line. Returns 1 if they are invalid or not
+// supported.
+static int __mtx_mm_read_info(mtx_matrix_stream_t *S, mtx_mm_info_t *info) {
+  const char *p, *end;
+  if (!__mtx_stream_line(S, &p, &end) ||
+      (size_t)(end - p) < strlen(MM_BANNER) ||
+      strncmp(p, MM_BANNER, strlen(MM_BANNER)) != 0) {
+    return 1;
+  }
+  p += strlen(MM_BANNER);
+
+  if (!__mtx_mm_word(&p, end, "matrix")) {
+    return 1;
+  }
+  if (__mtx_mm_word(&p, end, "coordinate")) {
+    info->coordinate = 1;
+  } else if (__mtx_mm_word(&p, end, "array")) {
+    info->coordinate = 0;
+  } else {
+    return 1;
+  }
+
+  info->pattern = __mtx_mm_word(&p, end, "pattern");
+  if (!(info->pattern && info->coordinate) &&
+      !__mtx_mm_word(&p, end, "real") && !__mtx_mm_word(&p, end, "double") &&
+      !__mtx_mm_word(&p, end, "integer")) {
+    return 1;
+  }
+
+  if (__mtx_mm_word(&p, end, "general")) {
+    info->symmetry = MTX_MM_GENERAL;
+  } else if (__mtx_mm_word(&p, end, "symmetric")) {
+    info->symmetry = MTX_MM_SYMMETRIC;
+  } else if (__mtx_mm_word(&p, end, "skew-symmetric")) {
+    info->symmetry = MTX_MM_SKEW_SYMMETRIC;
+  } else {
+    return 1;
+  }
+
+  if (!__mtx_mm_line(S, &p, &end) ||
+      (p = __mtx_mm_size(p, end, &info->rows)) == NULL ||
+      (p = __mtx_mm_size(p, end, &info->cols)) == NULL ||
+      (info->coordinate &&
+       (p = __mtx_mm_size(p, end, &info->entries)) == NULL) ||
+      __mtx_mm_skip(p, end) != end || info->rows == 0 || info->cols == 0 ||
+      (info->symmetry != MTX_MM_GENERAL && info->rows != info->cols)) {
+    return 1;
+  }
+
+  if (!info->coordinate) {
+    size_t n = info->rows;
+    if (info->symmetry == MTX_MM_GENERAL) {
+      if (info->cols > SIZE_MAX / n) {
+        return 1;
+      }
+      info->entries = n * info->cols;
+    } else {
+      if (n > SIZE_MAX / n) {
+        return 1;
+      }
+      info->entries = info->symmetry == MTX_MM_SYMMETRIC ? n * (n + 1) / 2
+                                                         : n * (n - 1) / 2;
+    }
+  }
+
+  return 0;
+}
+
+static void __mtx_mm_put(mtx_mm_target_t *T, size_t i, size_t j, double x) {
+  if (T->M != NULL) {
+    mtx_matrix_at(T->M, i, j) += x;
+    return;
+  }
+  if (x == 0) {
+    return;
+  }
+
+  if (T->n == T->capacity) {
+    size_t capacity = T->capacity > 0 ? 2 * T->capacity : 1024;
+    size_t *rows = (size_t *)realloc(T->rows, capacity * sizeof(size_t));
+    if (rows != NULL) {
+      T->rows = rows;
+    }
+    size_t *cols = (size_t *)realloc(T->cols, capacity * sizeof(size_t));
+    if (cols != NULL) {
+      T->cols = cols;
+    }
+    double *vals = (double *)realloc(T->vals, capacity * sizeof(double));
+    if (vals != NULL) {
+      T->vals = vals;
+    }
+    if (rows == NULL || cols == NULL || vals == NULL) {
+      MTX_SYSTEM_ERR("realloc");
+    }
+    T->capacity = capacity;
+  }
+  T->rows[T->n] = i;
+  T->cols[T->n] = j;
+  T->vals[T->n] = x;
+  ++T->n;
+}
+
+// Puts the entry (i, j) and its mirror on symmetric matrices.
+static void __mtx_mm_put_entry(mtx_mm_target_t *T, const mtx_mm_info_t *info,
+                               size_t i, size_t j, double x) {
+  __mtx_mm_put(T, i, j, x);
+  if (info->symmetry != MTX_MM_GENERAL && i != j) {
+    __mtx_mm_put(T, j, i, info->symmetry == MTX_MM_SYMMETRIC ? x : -x);
+  }
+}
+
+// Reads the entries of the file into T. Returns 1 if they are invalid.
+static int __mtx_mm_read_entries(mtx_matrix_stream_t *S,
+                                 const mtx_mm_info_t *info,
+                                 mtx_mm_target_t *T) {
+  // Position of the next element of array files, in column-major order
+  // through the stored triangle.
+  size_t i = info->symmetry == MTX_MM_SKEW_SYMMETRIC, j = 0;
+
+  for (size_t k = 0; k < info->entries; ++k) {
+    const char *p, *end;
+    if (!__mtx_mm_line(S, &p, &end)) {
+      return 1;
+    }
+
+    double x = 1;
+    if (info->coordinate) {
+      if ((p = __mtx_mm_size(p, end, &i)) == NULL ||
+          (p = __mtx_mm_size(p, end, &j)) == NULL || i == 0 ||
+          i > info->rows || j == 0 || j > info->cols ||
+          (info->symmetry != MTX_MM_GENERAL && i < j) ||
+          (info->symmetry == MTX_MM_SKEW_SYMMETRIC && i == j)) {
+        return 1;
+      }
+      --i;
+      --j;
+    }
+    if (!info->pattern && (p = __mtx_mm_value(p, end, &x)) == NULL) {
+      return 1;
+    }
+    if (__mtx_mm_skip(p, end) != end) {
+      return 1;
+    }
+
+    __mtx_mm_put_entry(T, info, i, j, x);
+
+    if (!info->coordinate && ++i == info->rows) {
+      ++j;
+      i = info->symmetry == MTX_MM_GENERAL ? 0
+          : info->symmetry == MTX_MM_SYMMETRIC ? j
+                                               : j + 1;
+    }
+  }
+
+  return 0;
+}
+
+// Reads a Matrix Market file from stream into M or, if M is NULL, into the
+// sparse matrix S.
+static int __mtx_mm_read(FILE *stream, mtx_matrix_t *M, mtx_sparse_t *SP) {
+  if (stream == NULL) {
+    MTX_SYSTEM_ERR("fread");
+  }
+
+  // Only the buffer of the stream is used; the FILE belongs to the caller.
+  mtx_matrix_stream_t S = {.file = stream};
+  S.buffer = (char *)mtx_mem_alloc(STREAM_BUFFER_SIZE);
+  S.capacity = STREAM_BUFFER_SIZE;
+
+  mtx_mm_info_t info = {0};
+  mtx_mm_target_t T = {.M = M};
+  int initialized = 0, ret = __mtx_mm_read_info(&S, &info);
+
+  if (ret == 0 && M != NULL) {
+    if (M->data == NULL) {
+      mtx_matrix_init(M, info.rows, info.cols);
+      initialized = 1;
+    } else if (M->dy != info.rows || M->dx != info.cols) {
+      free(S.buffer);
+      MTX_DIMEN_ERR(M);
+    }
+    for (size_t i = 0; i < M->dy; ++i) {
+      for (size_t j = 0; j < M->dx; ++j) {
+        mtx_matrix_at(M, i, j) = 0;
+      }
+    }
+  }
+
+  if (ret == 0) {
+    ret = __mtx_mm_read_entries(&S, &info, &T);
+  }
+  if (ret == 0 && M == NULL) {
+    ret = mtx_sparse_init_coo(SP, info.rows, info.cols, T.n, T.rows, T.cols,
+                              T.vals);
+  }
+
+  free(T.rows);
+  free(T.cols);
+  free(T.vals);
+  free(S.buffer);
+  if (ret != 0 && initialized) {
+    mtx_matrix_free(M);
+  }
+  return ret;
+}
+
+int mtx_matrix_mm_fread(FILE *stream, mtx_matrix_t *_M) {
+  return __mtx_mm_read(stream, _M, NULL);
+}
+
+int mtx_sparse_mm_fread(FILE *stream, mtx_sparse_t *_S) {
+  return __mtx_mm_read(stream, NULL, _S);
+}
+
+static void __mtx_mm_write(FILE *stream, const char *s, size_t n) {
+  if (fwrite(s, 1, n, stream) != n) {
+    MTX_SYSTEM_ERR("fwrite");
+  }
+}
+
+static void __mtx_mm_write_banner(FILE *stream, const char *format,
+                                  int symmetry) {
+  const char *qualifier = symmetry == MTX_MM_SYMMETRIC        ? "symmetric"
+                          : symmetry == MTX_MM_SKEW_SYMMETRIC ? "skew-symmetric"
+                                                              : "general";
+  char line[64];
+  int n = snprintf(line, sizeof(line), "%s matrix %s real %s\n", MM_BANNER,
+                   format, qualifier);
+  __mtx_mm_write(stream, line, n);
+}
+
+void mtx_matrix_mm_fwrite(FILE *stream, const mtx_matrix_t *M, int symmetry) {
+  MTX_ENSURE_INIT(M);
+  if (stream == NULL) {
+    MTX_SYSTEM_ERR("fwrite");
+  }
+  if (symmetry != MTX_MM_GENERAL && M->dy != M->dx) {
+    MTX_DIMEN_ERR(M);
+  }
+
+  __mtx_mm_write_banner(stream, "array", symmetry);
+  char line[2 * MTX_DOUBLE_CHARS_MAX + 2];
+  int n = snprintf(line, sizeof(line), "%zu %zu\n", M->dy, M->dx);
+  __mtx_mm_write(stream, line, n);
+
+  for (size_t j = 0; j < M->dx; ++j) {
+    size_t i = symmetry == MTX_MM_GENERAL     ? 0
+               : symmetry == MTX_MM_SYMMETRIC ? j
+                                              : j + 1;
+    for (; i < M->dy; ++i) {
+      n = _mtx_format_double(line, mtx_matrix_at(M, i, j));
+      line[n++] = '\n';
+      __mtx_mm_write(stream, line, n);
+    }
+  }
+}
+
+void mtx_sparse_mm_fwrite(FILE *stream, const mtx_sparse_t *S, int symmetry) {
+  if (stream == NULL) {
+    MTX_SYSTEM_ERR("fwrite");
+  }
+
+  // Entries kept by the qualifier.
+#define MM_KEPT(i, j)                                                          \
+  (symmetry == MTX_MM_GENERAL || (i) > (j) ||                                  \
+   ((i) == (j) && symmetry == MTX_MM_SYMMETRIC))
+
+  size_t entries = 0;
+  for (size_t i = 0; i < S->dy; ++i) {
+    for (size_t k = S->row_ptr[i]; k < S->row_ptr[i + 1]; ++k) {
+      entries += MM_KEPT(i, S->col[k]);
+    }
+  }
+
+  __mtx_mm_write_banner(stream, "coordinate", symmetry);
+  char line[3 * MTX_DOUBLE_CHARS_MAX + 3];
+  int n = snprintf(line, sizeof(line), "%zu %zu %zu\n", S->dy, S->dx, entries);
+  __mtx_mm_write(stream, line, n);
+
+  for (size_t i = 0; i < S->dy; ++i) {
+    for (size_t k = S->row_ptr[i]; k < S->row_ptr[i + 1]; ++k) {
+      if (MM_KEPT(i, S->col[k])) {
+        n = snprintf(line, sizeof(line), "%zu %zu ", i + 1, S->col[k] + 1);
+        n += _mtx_format_double(line + n, S->val[k]);
+        line[n++] = '\n';
+        __mtx_mm_write(stream, line, n);
+      }
+    }
+  }
+
+#undef MM_KEPT
+}
+
+#undef MM_BANNER
+
+#undef STREAM_BUFFER_SIZE
+
+// NumPy .npy files
+// (https://numpy.org/doc/stable/reference/generated/numpy.lib.format.html).
+
+#define NPY_MAGIC "\x93NUMPY"
+#define NPY_MAGIC_SIZE 6
+// The header is padded so the elements start at a multiple of this.
+#define NPY_ALIGNMENT 64
+
+typedef struct mtx_npy_info {
+  int float32;
+  int fortran;
+  size_t rows, cols;
+  // Offset of the elements in the file.
+  size_t offset;
+} mtx_npy_info_t;
+
+static int __mtx_npy_host_is_big_endian() {
+  return __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__;
+}
+
+// Returns the value of key in the dictionary [h, end) of an npy header.
+static const char *__mtx_npy_value(const char *h, const char *end,
+                                   const char *key) {
+  size_t len = strlen(key);
+  for (const char *p = h; p + len + 2 <= end; ++p) {
+    if ((*p == '\'' || *p == '"') && p[len + 1] == *p &&
+        memcmp(p + 1, key, len) == 0) {
+      p = __mtx_mm_skip(p + len + 2, end);
+      if (p == end || *p != ':') {
+        return NULL;
+      }
+      return __mtx_mm_skip(p + 1, end);
+    }
+  }
+  return NULL;
+}
+
+// Parses the dictionary [h, end) of an npy header. Returns 1 if the array isn't
+// a little-endian float64 or float32 matrix or vector.
+static int __mtx_npy_parse(const char *h, const char *end,
+                           mtx_npy_info_t *info) {
+  const char *descr = __mtx_npy_value(h, end, "descr");
+  if (descr == NULL || end - descr < 5 || (*descr != '\'' && *descr != '"') ||
+      descr[4] != *descr || descr[1] != '<' || descr[2] != 'f') {
+    return 1;
+  }
+  if (descr[3] == '8') {
+    info->float32 = 0;
+  } else if (descr[3] == '4') {
+    info->float32 = 1;
+  } else {
+    return 1;
+  }
+
+  const char *order = __mtx_npy_value(h, end, "fortran_order");
+  if (order != NULL && end - order >= 4 && memcmp(order, "True", 4) == 0) {
+    info->fortran = 1;
+  } else if (order != NULL && end - order >= 5 &&
+             memcmp(order, "False", 5) == 0) {
+    info->fortran = 0;
+  } else {
+    return 1;
+  }
+
+  // (rows, cols) or (rows,) for vectors, which become columns.
+  const char *p = __mtx_npy_value(h, end, "shape");
+  if (p == NULL || *p != '(') {
+    return 1;
+  }
+  size_t dims[2] = {0, 1};
+  int ndim = 0;
+  for (p = __mtx_mm_skip(p + 1, end); p < end && *p != ')';) {
+    if (ndim == 2 || (p = __mtx_mm_size(p, end, &dims[ndim++])) == NULL) {
+      return 1;
+    }
+    p = __mtx_mm_skip(p, end);
+    if (p < end && *p == ',') {
+      p = __mtx_mm_skip(p + 1, end);
+    }
+  }
+  if (p == end || ndim == 0 || dims[0] == 0 || dims[1] == 0) {
+    return 1;
+  }
+  info->rows = dims[0];
+  info->cols = dims[1];
+
+  return 0;
+}
+
+// Reads and parses the header of the npy file fd. Returns 1 if it isn't a
+// supported npy file or if it's shorter than the elements.
+static int __mtx_npy_read_header(int fd, mtx_npy_info_t *info) {
+  unsigned char preamble[NPY_MAGIC_SIZE + 6];
+  if (pread(fd, preamble, sizeof(preamble), 0) != sizeof(preamble) ||
+      memcmp(preamble, NPY_MAGIC, NPY_MAGIC_SIZE) != 0) {
+    return 1;
+  }
+
+  // Version 1.0 has a 2-byte header length, 2.0 and 3.0 a 4-byte one.
+  int major = preamble[NPY_MAGIC_SIZE];
+  const unsigned char *l = preamble + NPY_MAGIC_SIZE + 2;
+  size_t header_len, header_at;
+  if (major == 1) {
+    header_len = l[0] | (size_t)l[1] << 8;
+    header_at = NPY_MAGIC_SIZE + 4;
+  } else if (major == 2 || major == 3) {
+    header_len = l[0] | (size_t)l[1] << 8 | (size_t)l[2] << 16 |
+                 (size_t)l[3] << 24;
+    header_at = NPY_MAGIC_SIZE + 6;
+  } else {
+    return 1;
+  }
+
+  char *header = (char *)mtx_mem_alloc(header_len + 1);
+  int ret = pread(fd, header, header_len, header_at) != (ssize_t)header_len ||
+            __mtx_npy_parse(header, header + header_len, info) != 0;
+  free(header);
+  if (ret != 0) {
+    return 1;
+  }
+  info->offset = header_at + header_len;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    MTX_SYSTEM_ERR("fstat");
+  }
+  size_t elem_size = info->float32 ? sizeof(float) : sizeof(double);
+  return info->cols > (SIZE_MAX - info->offset) / elem_size / info->rows ||
+         (uint64_t)st.st_size <
+             info->offset + info->rows * info->cols * elem_size;
+}
+
+int mtx_matrix_load_npy(mtx_matrix_t *_M, const char *path) {
+  FILE *stream = fopen(path, "rb");
+  if (stream == NULL) {
+    MTX_SYSTEM_ERR("fopen");
+  }
+
+  mtx_npy_info_t info;
+  if (__mtx_npy_read_header(fileno(stream), &info) != 0) {
+    fclose(stream);
+    return 1;
+  }
+  if (fseek(stream, info.offset, SEEK_SET) != 0) {
+    fclose(stream);
+    MTX_SYSTEM_ERR("fseek");
+  }
+
+  int initialized = 0;
+  if (_M->data == NULL) {
+    mtx_matrix_init(_M, info.rows, info.cols);
+    initialized = 1;
+  } else if (_M->dy != info.rows || _M->dx != info.cols) {
+    fclose(stream);
+    MTX_DIMEN_ERR(_M);
+  }
+
+  // The file is read one line at a time: rows of C-order files, which go
+  // straight into the matrix when they hold doubles, or columns of
+  // Fortran-order files.
+  size_t lines = info.fortran ? info.cols : info.rows;
+  size_t len = info.fortran ? info.rows : info.cols;
+  size_t elem_size = info.float32 ? sizeof(float) : sizeof(double);
+  int direct = !info.fortran && !info.float32 &&
+               MTX_MATRIX_HAS_UNIT_COLUMNS(_M);
+  char *buffer = direct ? NULL : (char *)mtx_mem_alloc(len * elem_size);
+  int swapped = __mtx_npy_host_is_big_endian();
+  int ret = 0;
+
+  for (size_t k = 0; ret == 0 && k < lines; ++k) {
+    char *line = direct ? (char *)mtx_matrix_row(_M, k) : buffer;
+    if (fread(line, elem_size, len, stream) != len) {
+      ret = 1;
+      break;
+    }
+    if (direct) {
+      if (swapped) {
+        __mtx_bin_swap((uint64_t *)line, len);
+      }
+      continue;
+    }
+
+    for (size_t t = 0; t < len; ++t) {
+      double x;
+      if (info.float32) {
+        uint32_t u;
+        memcpy(&u, line + t * sizeof(float), sizeof(u));
+        u = swapped ? __builtin_bswap32(u) : u;
+        float f;
+        memcpy(&f, &u, sizeof(f));
+        x = f;
+      } else {
+        uint64_t u;
+        memcpy(&u, line + t * sizeof(double), sizeof(u));
+        u = swapped ? __builtin_bswap64(u) : u;
+        memcpy(&x, &u, sizeof(x));
+      }
+      if (info.fortran) {
+        mtx_matrix_at(_M, t, k) = x;
+      } else {
+        mtx_matrix_at(_M, k, t) = x;
+      }
+    }
+  }
+
+  free(buffer);
+  if (ret != 0 && ferror(stream)) {
+    fclose(stream);
+    MTX_SYSTEM_ERR("fread");
+  }
+  fclose(stream);
+  if (ret != 0 && initialized) {
+    mtx_matrix_free(_M);
+  }
+  return ret;
+}
+
+void mtx_matrix_save_npy(const char *path, const mtx_matrix_t *M, int flags) {
+  MTX_ENSURE_INIT(M);
+
+  int float32 = flags & MTX_NPY_FLOAT32, fortran = flags & MTX_NPY_FORTRAN;
+  char header[256];
+  int n = snprintf(header + NPY_MAGIC_SIZE + 4,
+                   sizeof(header) - NPY_MAGIC_SIZE - 4,
+                   "{'descr': '<f%d', 'fortran_order': %s, 'shape': (%zu, "
+                   "%zu), }",
+                   float32 ? 4 : 8, fortran ? "True" : "False", M->dy, M->dx);
+  // Spaces and a line break up to the alignment of the elements.
+  size_t total = NPY_MAGIC_SIZE + 4 + n + 1;
+  total = (total + NPY_ALIGNMENT - 1) / NPY_ALIGNMENT * NPY_ALIGNMENT;
+  memset(header + NPY_MAGIC_SIZE + 4 + n, ' ', total - NPY_MAGIC_SIZE - 4 - n);
+  header[total - 1] = '\n';
+  memcpy(header, NPY_MAGIC, NPY_MAGIC_SIZE);
+  size_t header_len = total - NPY_MAGIC_SIZE - 4;
+  header[NPY_MAGIC_SIZE] = 1;
+  header[NPY_MAGIC_SIZE + 1] = 0;
+  header[NPY_MAGIC_SIZE + 2] = (char)(header_len & 0xff);
+  header[NPY_MAGIC_SIZE + 3] = (char)(header_len >> 8);
+
+  FILE *stream = fopen(path, "wb");
+  if (stream == NULL) {
+    MTX_SYSTEM_ERR("fopen");
+  }
+  int written = fwrite(header, 1, total, stream) == total;
+
+  int swapped = __mtx_npy_host_is_big_endian();
+  if (written && !float32 && !fortran && !swapped) {
+    __mtx_bin_write_rows(stream, M);
+  } else if (written) {
+    size_t lines = fortran ? M->dx : M->dy;
+    size_t len = fortran ? M->dy : M->dx;
+    size_t elem_size = float32 ? sizeof(float) : sizeof(double);
+    char *buffer = (char *)mtx_mem_alloc(len * elem_size);
+
+    for (size_t k = 0; written && k < lines; ++k) {
+      for (size_t t = 0; t < len; ++t) {
+        double x = fortran ? mtx_matrix_at(M, t, k) : mtx_matrix_at(M, k, t);
+        if (float32) {
+          float f = (float)x;
+          uint32_t u;
+          memcpy(&u, &f, sizeof(u));
+          u = swapped ? __builtin_bswap32(u) : u;
+          memcpy(buffer + t * sizeof(float), &u, sizeof(u));
+        } else {
+          uint64_t u;
+          memcpy(&u, &x, sizeof(u));
+          u = swapped ? __builtin_bswap64(u) : u;
+          memcpy(buffer + t * sizeof(double), &u, sizeof(u));
+        }
+      }
+      written = fwrite(buffer, elem_size, len, stream) == len;
+    }
+    free(buffer);
+  }
+
+  if (fclose(stream) != 0 || !written) {
+    MTX_SYSTEM_ERR(written ? "fclose" : "fwrite");
+  }
+}
+
+int mtx_matrix_mmap_npy(mtx_matrix_t *_M, const char *path, int mode) {
+  int writable = mode & (MTX_MMAP_WRITE | MTX_MMAP_PRIVATE);
+
+  int fd = open(path, mode & MTX_MMAP_WRITE ? O_RDWR : O_RDONLY);
+  if (fd < 0) {
+    MTX_SYSTEM_ERR("open");
+  }
+
+  // Only C-order doubles in the byte order of the host can be wrapped.
+  mtx_npy_info_t info;
+  if (__mtx_npy_read_header(fd, &info) != 0 || info.float32 || info.fortran ||
+      __mtx_npy_host_is_big_endian() || info.offset % sizeof(double) != 0) {
+    close(fd);
+    return 1;
+  }
+
+  // The mapping starts at the page of the first element.
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  size_t map_offset = info.offset / page * page;
+  size_t length =
+      info.offset - map_offset + info.rows * info.cols * sizeof(double);
+  void *map = mmap(NULL, length, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                   mode & MTX_MMAP_PRIVATE ? MAP_PRIVATE : MAP_SHARED, fd,
+                   map_offset);
+  close(fd);
+  if (map == MAP_FAILED) {
+    MTX_SYSTEM_ERR("mmap");
+  }
+
+  double *m = (double *)((char *)map + (info.offset - map_offset));
+  mtx_matrix_ref_a(_M, m, info.rows, info.cols);
+  _M->data->flags |= MTX_MATRIX_DATA_MAPPED;
+
+  return 0;
+}
+
+#undef NPY_MAGIC
+#undef NPY_MAGIC_SIZE
+#undef NPY_ALIGNMENT
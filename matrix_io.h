@@ -0,0 +1,293 @@
+#ifndef MTX_MATRIX_IO_H
+#define MTX_MATRIX_IO_H
+
+#include "matrix.h"
+#include "sparse.h"
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MTX_BIN_MAGIC "MTXB"
+#define MTX_BIN_VERSION 1
+
+// Tag gravado com a ordem de bytes de quem escreveu o arquivo.
+#define MTX_BIN_ENDIAN_TAG 0x01020304u
+
+// Tipos dos elementos.
+#define MTX_BIN_FLOAT64 1
+
+// O campo checksum do cabeçalho contém o FNV-1a de 64 bits dos elementos.
+#define MTX_BIN_CHECKSUM 0x1
+
+// Cabeçalho do formato binário, seguido dos rows * cols elementos em ordem
+// row-major, sem padding entre as linhas. Os campos e os elementos estão na
+// ordem de bytes indicada por endian. O cabeçalho ocupa 64 bytes para que os
+// elementos fiquem alinhados quando o arquivo é mapeado em memória.
+typedef struct mtx_bin_header {
+  char magic[4];
+  uint16_t version;
+  uint8_t dtype;
+  uint8_t flags;
+  uint32_t endian;
+  uint32_t reserved;
+  uint64_t rows;
+  uint64_t cols;
+  uint64_t checksum;
+  uint8_t pad[24];
+} mtx_bin_header_t;
+
+// Escreve a matriz M em stream no formato binário. Caso flags contenha
+// MTX_BIN_CHECKSUM, o checksum dos elementos é gravado no cabeçalho.
+void mtx_matrix_fwrite_bin(FILE *stream, const mtx_matrix_t *M, int flags);
+
+// Lê uma matriz no formato binário de stream para _M. Caso _M não esteja
+// inicializada, ela é inicializada com as dimensões lidas, caso contrário as
+// dimensões têm que ser as mesmas (MTX_DIMEN_ERR). Arquivos gravados com a
+// outra ordem de bytes são convertidos.
+//
+// Retorna 1 caso stream não contenha uma matriz válida (cabeçalho inválido,
+// arquivo truncado ou checksum diferente) e 0 em caso de sucesso.
+int mtx_matrix_fread_bin(FILE *stream, mtx_matrix_t *_M);
+
+// Modos de mtx_matrix_mmap(). Sem MTX_MMAP_WRITE nem MTX_MMAP_PRIVATE a matriz
+// é somente leitura: escrever nos elementos gera SIGSEGV.
+#define MTX_MMAP_READ 0x0
+// Mapeamento compartilhado (MAP_SHARED) de leitura e escrita: as alterações
+// nos elementos são gravadas no arquivo e vistas pelos outros processos.
+#define MTX_MMAP_WRITE 0x1
+// Mapeamento copy-on-write (MAP_PRIVATE): os elementos podem ser alterados,
+// mas as alterações são privadas ao processo.
+#define MTX_MMAP_PRIVATE 0x2
+// Confere o checksum dos elementos, se o arquivo tiver um. Isso lê o arquivo
+// inteiro.
+#define MTX_MMAP_VERIFY 0x4
+
+// Mapeia em memória um arquivo no formato binário e o referencia em _M, sem
+// copiar os elementos. As páginas são lidas sob demanda e compartilhadas pelo
+// page cache entre os processos que mapeiam o mesmo arquivo. A matriz deve
+// ser liberada com mtx_matrix_munmap().
+//
+// Retorna 1 caso o arquivo não contenha uma matriz válida ou tenha sido
+// gravado com a outra ordem de bytes (use mtx_matrix_fread_bin()) e 0 em caso
+// de sucesso.
+int mtx_matrix_mmap(mtx_matrix_t *_M, const char *path, int mode);
+
+// Desfaz o mapeamento de uma matriz criada por mtx_matrix_mmap() ou
+// mtx_matrix_mmap_npy(), liberando os metadados.
+void mtx_matrix_munmap(mtx_matrix_t *__M);
+
+// Carrega para _M a matriz em formato texto do arquivo path (números separados
+// por espaços, tabs ou vírgulas, uma linha por linha da matriz; linhas vazias
+// são ignoradas). O arquivo é mapeado em memória e dividido em pedaços nas
+// quebras de linha, que são lidos em paralelo pelas threads do pool (ver
+// threads.h). Caso _M não esteja inicializada, ela é inicializada com as
+// dimensões lidas, caso contrário as dimensões têm que ser as mesmas
+// (MTX_DIMEN_ERR).
+//
+// Retorna 1 caso o arquivo contenha algo além de números e delimitadores ou
+// linhas com números de elementos diferentes e 0 em caso de sucesso.
+int mtx_matrix_load_text(mtx_matrix_t *_M, const char *path);
+
+// Formatos de arquivo de mtx_matrix_stream_t.
+#define MTX_STREAM_TEXT 0
+#define MTX_STREAM_BINARY 1
+
+// Leitura ou escrita de uma matriz em blocos de linhas, para processar
+// arquivos maiores que a memória. Os campos são de uso interno da lib.
+typedef struct mtx_matrix_stream {
+  FILE *file;
+  int format;
+  int writing;
+  // Colunas da matriz (0 até a primeira linha) e linhas lidas ou escritas até
+  // agora.
+  size_t cols, rows;
+  // Formato binário: cabeçalho do arquivo, checksum dos elementos lidos ou
+  // escritos até agora e se o arquivo está na outra ordem de bytes.
+  mtx_bin_header_t header;
+  uint64_t checksum;
+  int swapped;
+  // Formato texto: buffer de leitura com os bytes de begin a end ainda não
+  // lidos.
+  char *buffer;
+  size_t begin, end, capacity;
+  int eof;
+  // Bloco de onde saem as views de mtx_matrix_stream_next_block().
+  mtx_matrix_t block;
+  // Conteúdo inválido encontrado durante a leitura.
+  int invalid;
+} mtx_matrix_stream_t;
+
+// Abre o arquivo path para leitura em blocos, detectando se ele está no
+// formato binário ou texto. Retorna 1 caso o arquivo binário tenha um
+// cabeçalho inválido e 0 em caso de sucesso.
+int mtx_matrix_stream_open(mtx_matrix_stream_t *S, const char *path);
+
+// Cria o arquivo path para escrita em blocos no formato format
+// (MTX_STREAM_TEXT ou MTX_STREAM_BINARY). O arquivo binário é gravado com
+// checksum e as dimensões são escritas no cabeçalho por
+// mtx_matrix_stream_close().
+void mtx_matrix_stream_create(mtx_matrix_stream_t *S, const char *path,
+                              int format);
+
+// Lê as próximas max_rows linhas (ou as que restarem) de S para um bloco
+// interno do stream e faz de view uma view delas, válida até a próxima chamada.
+// Só os elementos de um bloco ficam em memória. Retorna o número de linhas
+// lidas, 0 no fim do arquivo ou caso ele tenha conteúdo inválido (ver
+// mtx_matrix_stream_close()).
+size_t mtx_matrix_stream_next_block(mtx_matrix_stream_t *S,
+                                    mtx_matrix_view_t *view, size_t max_rows);
+
+// Escreve as linhas de M no fim do arquivo de S. Todos os blocos têm que ter o
+// mesmo número de colunas (MTX_DIMEN_ERR).
+void mtx_matrix_stream_write_block(mtx_matrix_stream_t *S,
+                                   const mtx_matrix_t *M);
+
+// Fecha S, liberando o bloco e os buffers. Retorna 1 caso a leitura tenha
+// parado em conteúdo inválido (linhas com números de elementos diferentes,
+// arquivo binário truncado ou checksum diferente) e 0 caso contrário.
+int mtx_matrix_stream_close(mtx_matrix_stream_t *S);
+
+// Qualificadores de simetria do formato Matrix Market. Nas matrizes simétricas
+// (A[i][j] == A[j][i]) e anti-simétricas (A[i][j] == -A[j][i]) os arquivos só
+// contêm os elementos abaixo da diagonal (e nela, para as simétricas).
+#define MTX_MM_GENERAL 0
+#define MTX_MM_SYMMETRIC 1
+#define MTX_MM_SKEW_SYMMETRIC 2
+
+// Lê para _M uma matriz no formato Matrix Market (.mtx) de stream, nos
+// formatos array ou coordinate (os elementos ausentes valem 0), com os campos
+// real, double, integer ou pattern (os elementos presentes valem 1) e os
+// qualificadores general, symmetric ou skew-symmetric, cuja metade ausente é
+// preenchida durante a leitura. Os números são lidos direto para _M, que é
+// inicializada caso não esteja, caso contrário as dimensões têm que ser as
+// mesmas (MTX_DIMEN_ERR). stream é lido em blocos, então pode ser consumido
+// além do fim da matriz.
+//
+// Retorna 1 caso stream não contenha uma matriz válida (inclusive matrizes
+// complexas ou hermitianas) e 0 em caso de sucesso.
+int mtx_matrix_mm_fread(FILE *stream, mtx_matrix_t *_M);
+
+// Lê para _S (não inicializada) uma matriz no formato Matrix Market de stream,
+// como mtx_matrix_mm_fread(). Os elementos nulos de arquivos array não são
+// guardados.
+int mtx_sparse_mm_fread(FILE *stream, mtx_sparse_t *_S);
+
+// Escreve M em stream no formato Matrix Market array real com o qualificador
+// symmetry. Nas matrizes simétricas e anti-simétricas, que têm que ser
+// quadradas (MTX_DIMEN_ERR), só os elementos abaixo da diagonal (e nela, para
+// as simétricas) são escritos, sem conferir a simetria.
+void mtx_matrix_mm_fwrite(FILE *stream, const mtx_matrix_t *M, int symmetry);
+
+// Escreve S em stream no formato Matrix Market coordinate real com o
+// qualificador symmetry. Nas matrizes simétricas e anti-simétricas só os
+// elementos abaixo da diagonal (e nela, para as simétricas) são escritos.
+void mtx_sparse_mm_fwrite(FILE *stream, const mtx_sparse_t *S, int symmetry);
+
+// Flags de mtx_matrix_save_npy(): elementos float32 (o padrão é float64) e
+// ordem Fortran, column-major (o padrão é a ordem C, row-major).
+#define MTX_NPY_FLOAT32 0x1
+#define MTX_NPY_FORTRAN 0x2
+
+// Carrega para _M o array do arquivo NumPy .npy path, com elementos float64 ou
+// float32 little-endian (convertidos para double) em ordem C ou Fortran. Arrays
+// de uma dimensão são lidos como colunas. Caso _M não esteja inicializada, ela
+// é inicializada com as dimensões lidas, caso contrário as dimensões têm que
+// ser as mesmas (MTX_DIMEN_ERR).
+//
+// Retorna 1 caso o arquivo não seja um .npy suportado (outros tipos, mais de
+// duas dimensões, dimensões nulas ou arquivo truncado) e 0 em caso de sucesso.
+int mtx_matrix_load_npy(mtx_matrix_t *_M, const char *path);
+
+// Grava M no arquivo NumPy .npy path (versão 1.0), em float64 e ordem C a
+// menos que flags contenha MTX_NPY_FLOAT32 ou MTX_NPY_FORTRAN. Os elementos
+// começam em um offset múltiplo de 64 bytes.
+void mtx_matrix_save_npy(const char *path, const mtx_matrix_t *M, int flags);
+
+// Mapeia em memória um arquivo .npy float64 em ordem C e o referencia em _M
+// sem copiar os elementos, como mtx_matrix_mmap() (com os mesmos modos, exceto
+// MTX_MMAP_VERIFY, que é ignorado). A matriz deve ser liberada com
+// mtx_matrix_munmap().
+//
+// Retorna 1 caso o arquivo não seja um .npy suportado ou não seja float64 em
+// ordem C (use mtx_matrix_load_npy()) e 0 em caso de sucesso.
+int mtx_matrix_mmap_npy(mtx_matrix_t *_M, const char *path, int mode);
+
+// Uso interno da lib: classes dos caracteres do formato texto. Os números são
+// separados por sequências de delimitadores e as linhas terminam em quebras
+// de linha. As letras de inf, infinity e nan também fazem parte dos números.
+#define MTX_TEXT_OTHER 0
+#define MTX_TEXT_NUMBER 1
+#define MTX_TEXT_DELIMITER 2
+#define MTX_TEXT_LINE_END 3
+
+static inline int _mtx_text_char_class(int c) {
+  switch (c) {
+  case '0':
+  case '1':
+  case '2':
+  case '3':
+  case '4':
+  case '5':
+  case '6':
+  case '7':
+  case '8':
+  case '9':
+  case '+':
+  case '-':
+  case '.':
+  case 'e':
+  case 'E':
+  case 'a':
+  case 'A':
+  case 'f':
+  case 'F':
+  case 'i':
+  case 'I':
+  case 'n':
+  case 'N':
+  case 't':
+  case 'T':
+  case 'y':
+  case 'Y':
+    return MTX_TEXT_NUMBER;
+  case ' ':
+  case '\t':
+  case ',':
+    return MTX_TEXT_DELIMITER;
+  case '\n':
+  case '\r':
+  case '\v':
+  case '\f':
+    return MTX_TEXT_LINE_END;
+  default:
+    return MTX_TEXT_OTHER;
+  }
+}
+
+// Uso interno da lib: converte o número decimal que começa em s (sem espaços
+// antes) e termina até end para x, com arredondamento correto. Aceita
+// [+-]dígitos[.dígitos][(e|E)[+-]dígitos] e [+-](inf|infinity|nan), sem
+// diferenciar maiúsculas de minúsculas, como os escritos por
+// _mtx_format_double(). Retorna o ponteiro para o primeiro caractere depois do
+// número ou NULL caso s não comece com um número.
+const char *_mtx_parse_double(const char *s, const char *end, double *x);
+
+// Uso interno da lib: escreve x em buf (sem '\0') com o menor número de
+// dígitos que, lido de volta, resulta no mesmo double. Retorna o número de
+// caracteres escritos, no máximo MTX_DOUBLE_CHARS_MAX.
+#define MTX_DOUBLE_CHARS_MAX 32
+int _mtx_format_double(char *buf, double x);
+
+// Calcula o FNV-1a de 64 bits de size bytes, continuando a partir de hash
+// (use MTX_FNV1A_INIT para começar).
+#define MTX_FNV1A_INIT 0xcbf29ce484222325ull
+uint64_t mtx_fnv1a(uint64_t hash, const void *data, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
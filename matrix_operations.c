@@ -2,83 +2,211 @@
 #include "assert.h"
 #include "atomic_operations.h"
 #include "errors.h"
+#include "gemm.h"
 #include "matrix.h"
+#include "simd.h"
+#include "threads.h"
+#include "workspace.h"
 #include <string.h>
 
 void mtx_matrix_set_identity(mtx_matrix_t *M) {
   MTX_ENSURE_INIT(M);
 
-  int d = M->dx < M->dy ? M->dx : M->dy;
-  for (int i = 0; i < d; ++i) {
-    for (int j = 0; j < d; ++j) {
+  size_t d = M->dx < M->dy ? M->dx : M->dy;
+  for (size_t i = 0; i < d; ++i) {
+    for (size_t j = 0; j < d; ++j) {
       mtx_matrix_at(M, i, j) = 0;
     }
     mtx_matrix_at(M, i, i) = 1;
   }
 }
 
-int mtx_matrix_mul(mtx_matrix_t *_C, const mtx_matrix_t *A,
-                   const mtx_matrix_t *B) {
-
+int mtx_matrix_gemm(int transA, int transB, double alpha,
+                    const mtx_matrix_t *A, const mtx_matrix_t *B, double beta,
+                    mtx_matrix_t *C) {
   MTX_ENSURE_INIT(A);
   MTX_ENSURE_INIT(B);
 
+  // op(A) and op(B) are views, the packing reads them transposed.
+  mtx_matrix_view_t A_T, B_T;
+  if (transA) {
+    A_T = mtx_matrix_transposed_of(A);
+    A = &A_T.matrix;
+  }
+  if (transB) {
+    B_T = mtx_matrix_transposed_of(B);
+    B = &B_T.matrix;
+  }
+
   if (A->dx != B->dy) {
     MTX_DIMEN_ERR(B);
   }
 
-  if (_C->data == NULL) {
-    mtx_matrix_init(_C, A->dy, B->dx);
-  } else {
-
-    if (_C->dx != B->dx || _C->dy != A->dy) {
-      MTX_DIMEN_ERR(_C);
-    }
+  if (C->data == NULL) {
+    mtx_matrix_init(C, A->dy, B->dx);
+    beta = 0;
+  } else if (C->dx != B->dx || C->dy != A->dy) {
+    MTX_DIMEN_ERR(C);
   }
 
-  MTX_MAKE_OUTPUT_ALIAS(mul_res, _C);
+  MTX_MAKE_OUTPUT_ALIAS(c, C);
+
+  MTX_ENSURE_SAFE_OUTPUT(c, C, A);
+  MTX_ENSURE_SAFE_OUTPUT(c, C, B);
 
-  MTX_ENSURE_SAFE_OUTPUT(mul_res, _C, A);
-  MTX_ENSURE_SAFE_OUTPUT(mul_res, _C, B);
+  // A temporary output starts with the elements of C to accumulate on.
+  if (c.data != C->data && beta != 0) {
+    mtx_matrix_copy(&c, C);
+  }
 
-  int bx = 0, ay = 0;
+  mtx_gemm(&c, alpha, A, B, beta);
 
-  for (; ay < A->dy; ++ay) {
-    bx = 0;
-    for (; bx < B->dx; ++bx) {
-      int i = 0;
+  MTX_COMMIT_OUTPUT(c, C);
+  return 0;
+}
 
-      double sum = 0;
-      for (; i < A->dx; ++i) {
-        sum += mtx_matrix_at(A, ay, i) * mtx_matrix_at(B, i, bx);
+int mtx_matrix_mul(mtx_matrix_t *_C, const mtx_matrix_t *A,
+                   const mtx_matrix_t *B) {
+  return mtx_matrix_gemm(MTX_NO_TRANS, MTX_NO_TRANS, 1, A, B, 0, _C);
+}
+
+// Blocks up to TRANSPOSE_LEAF x TRANSPOSE_LEAF elements are transposed
+// directly: the rows read and written by them fit in the L1.
+#define TRANSPOSE_LEAF 32
+
+// Splits n close to the half at a multiple of the kernel block.
+#define TRANSPOSE_HALF(n)                                                      \
+  ((n) / 2 >= MTX_SIMD_TRANSPOSE_NB_MAX                                        \
+       ? (n) / 2 / MTX_SIMD_TRANSPOSE_NB_MAX * MTX_SIMD_TRANSPOSE_NB_MAX       \
+       : (n) / 2)
+
+// b (n x m) = a (m x n)^T, with whole kernel blocks in registers.
+static void _mtx_transpose_leaf(const mtx_kernels_t *kernels, double *b,
+                                ptrdiff_t ldb, const double *a, ptrdiff_t lda,
+                                size_t m, size_t n) {
+  const size_t nb = kernels->transpose_nb;
+  size_t m_blocks = m / nb * nb, n_blocks = n / nb * nb;
+
+  for (size_t i = 0; i < m_blocks; i += nb) {
+    for (size_t j = 0; j < n_blocks; j += nb) {
+      kernels->transpose_block(&b[j * ldb + i], ldb, &a[i * lda + j], lda);
+    }
+    for (size_t ii = i; ii < i + nb; ++ii) {
+      for (size_t j = n_blocks; j < n; ++j) {
+        b[j * ldb + ii] = a[ii * lda + j];
       }
-      mtx_matrix_at(&mul_res, ay, bx) = sum;
     }
   }
-
-  MTX_COMMIT_OUTPUT(mul_res, _C);
-  return 0;
+  for (size_t i = m_blocks; i < m; ++i) {
+    for (size_t j = 0; j < n; ++j) {
+      b[j * ldb + i] = a[i * lda + j];
+    }
+  }
 }
 
-int mtx_matrix_s_mul(mtx_matrix_t *_M, const mtx_matrix_t *M, double scalar) {
-  MTX_ENSURE_INIT(M);
+// Cache-oblivious transpose: halves the larger dimension until the blocks fit
+// in the L1, so each cache line and page is brought in once whatever the
+// cache sizes.
+static void _mtx_transpose_rec(const mtx_kernels_t *kernels, double *b,
+                               ptrdiff_t ldb, const double *a, ptrdiff_t lda,
+                               size_t m, size_t n) {
+  if (m <= TRANSPOSE_LEAF && n <= TRANSPOSE_LEAF) {
+    _mtx_transpose_leaf(kernels, b, ldb, a, lda, m, n);
+  } else if (m >= n) {
+    size_t h = TRANSPOSE_HALF(m);
+    _mtx_transpose_rec(kernels, b, ldb, a, lda, h, n);
+    _mtx_transpose_rec(kernels, b + h, ldb, a + h * lda, lda, m - h, n);
+  } else {
+    size_t h = TRANSPOSE_HALF(n);
+    _mtx_transpose_rec(kernels, b, ldb, a, lda, m, h);
+    _mtx_transpose_rec(kernels, b + h * ldb, ldb, a + h, lda, m, n - h);
+  }
+}
 
-  if (_M->data == NULL) {
-    mtx_matrix_init(_M, M->dy, M->dx);
-  } else if (!MTX_MATRIX_SAME_DIMENSIONS(_M, M)) {
-    MTX_DIMEN_ERR(_M);
+// Exchanges the m x n block a with the transpose of the n x m block b (both
+// with leading dimension ld, not overlapping), going through the registers
+// one pair of kernel blocks at a time.
+static void _mtx_transpose_swap(const mtx_kernels_t *kernels, double *a,
+                                double *b, ptrdiff_t ld, size_t m, size_t n) {
+  if (m > TRANSPOSE_LEAF || n > TRANSPOSE_LEAF) {
+    if (m >= n) {
+      size_t h = TRANSPOSE_HALF(m);
+      _mtx_transpose_swap(kernels, a, b, ld, h, n);
+      _mtx_transpose_swap(kernels, a + h * ld, b + h, ld, m - h, n);
+    } else {
+      size_t h = TRANSPOSE_HALF(n);
+      _mtx_transpose_swap(kernels, a, b, ld, m, h);
+      _mtx_transpose_swap(kernels, a + h, b + h * ld, ld, m, n - h);
+    }
+    return;
   }
 
-  MTX_MAKE_OUTPUT_ALIAS(m_res, _M);
+  const size_t nb = kernels->transpose_nb;
+  double ta[MTX_SIMD_TRANSPOSE_NB_MAX * MTX_SIMD_TRANSPOSE_NB_MAX];
+  double tb[MTX_SIMD_TRANSPOSE_NB_MAX * MTX_SIMD_TRANSPOSE_NB_MAX];
+  size_t m_blocks = m / nb * nb, n_blocks = n / nb * nb;
+
+  for (size_t i = 0; i < m_blocks; i += nb) {
+    for (size_t j = 0; j < n_blocks; j += nb) {
+      double *a_ij = &a[i * ld + j], *b_ji = &b[j * ld + i];
+      kernels->transpose_block(ta, nb, a_ij, ld);
+      kernels->transpose_block(tb, nb, b_ji, ld);
+      for (size_t k = 0; k < nb; ++k) {
+        for (size_t l = 0; l < nb; ++l) {
+          a_ij[k * ld + l] = tb[k * nb + l];
+          b_ji[k * ld + l] = ta[k * nb + l];
+        }
+      }
+    }
+  }
+  for (size_t i = 0; i < m; ++i) {
+    for (size_t j = i < m_blocks ? n_blocks : 0; j < n; ++j) {
+      double x = a[i * ld + j];
+      a[i * ld + j] = b[j * ld + i];
+      b[j * ld + i] = x;
+    }
+  }
+}
 
-  MTX_ENSURE_SAFE_OUTPUT_RULES(m_res, _M, M, MTX_MATRIX_OVERLAP_AFTER(M, _M));
-  for (int i = 0; i < _M->dy; ++i) {
-    for (int j = 0; j < _M->dx; ++j) {
-      mtx_matrix_at(_M, i, j) = mtx_matrix_at(M, i, j) * scalar;
+// Transposes the n x n block a in place: the diagonal blocks recursively and
+// the blocks above the diagonal exchanged with the ones below.
+static void _mtx_transpose_square(const mtx_kernels_t *kernels, double *a,
+                                  ptrdiff_t ld, size_t n) {
+  if (n <= TRANSPOSE_LEAF) {
+    for (size_t i = 1; i < n; ++i) {
+      for (size_t j = 0; j < i; ++j) {
+        double x = a[i * ld + j];
+        a[i * ld + j] = a[j * ld + i];
+        a[j * ld + i] = x;
+      }
     }
+    return;
   }
 
-  return 0;
+  size_t h = TRANSPOSE_HALF(n);
+  _mtx_transpose_square(kernels, a, ld, h);
+  _mtx_transpose_square(kernels, a + h * ld + h, ld, n - h);
+  _mtx_transpose_swap(kernels, a + h, a + h * ld, ld, h, n - h);
+}
+
+#undef TRANSPOSE_HALF
+#undef TRANSPOSE_LEAF
+
+// Transposes the square M in place.
+static void _mtx_matrix_transpose_square(mtx_matrix_t *M) {
+  if (MTX_MATRIX_HAS_UNIT_COLUMNS(M)) {
+    _mtx_transpose_square(mtx_kernels(), mtx_matrix_row(M, 0),
+                          mtx_matrix_row_stride(M), M->dy);
+    return;
+  }
+
+  for (size_t i = 1; i < M->dy; ++i) {
+    for (size_t j = 0; j < i; ++j) {
+      double x = mtx_matrix_at(M, i, j);
+      mtx_matrix_at(M, i, j) = mtx_matrix_at(M, j, i);
+      mtx_matrix_at(M, j, i) = x;
+    }
+  }
 }
 
 int mtx_matrix_transpose(mtx_matrix_t *_M, const mtx_matrix_t *M) {
@@ -89,11 +217,91 @@ int mtx_matrix_transpose(mtx_matrix_t *_M, const mtx_matrix_t *M) {
     MTX_DIMEN_ERR(_M);
   }
 
-  for (int i = 0; i < _M->dy; ++i) {
-    for (int j = 0; j < _M->dx; ++j) {
-      mtx_matrix_at(_M, i, j) = mtx_matrix_at(M, j, i);
+  if (MTX_MATRIX_ARE_SAME(_M, M)) {
+    _mtx_matrix_transpose_square(_M);
+    return 0;
+  }
+
+  MTX_MAKE_OUTPUT_ALIAS(m_t, _M);
+  MTX_ENSURE_SAFE_OUTPUT(m_t, _M, M);
+
+  if (MTX_MATRIX_HAS_UNIT_COLUMNS(&m_t) && MTX_MATRIX_HAS_UNIT_COLUMNS(M)) {
+    _mtx_transpose_rec(mtx_kernels(), mtx_matrix_row(&m_t, 0),
+                       mtx_matrix_row_stride(&m_t), mtx_matrix_row(M, 0),
+                       mtx_matrix_row_stride(M), M->dy, M->dx);
+  } else {
+    for (size_t i = 0; i < m_t.dy; ++i) {
+      for (size_t j = 0; j < m_t.dx; ++j) {
+        mtx_matrix_at(&m_t, i, j) = mtx_matrix_at(M, j, i);
+      }
+    }
+  }
+
+  MTX_COMMIT_OUTPUT(m_t, _M);
+  return 0;
+}
+
+int mtx_matrix_transpose_in_place(mtx_matrix_t *M) {
+  MTX_ENSURE_INIT(M);
+
+  if (MTX_MATRIX_IS_SQUARE(M)) {
+    _mtx_matrix_transpose_square(M);
+    return 0;
+  }
+  if (!MTX_MATRIX_IS_CONTIGUOUS(M)) {
+    if (MTX_MATRIX_IS_VIEW(M) || !MTX_MATRIX_HAS_UNIT_COLUMNS(M)) {
+      MTX_INVALID_ERR(M);
+    }
+    // The padding of a matrix's own rows is dropped: its rows are moved to the
+    // front, one after the other, and the result gets ld = dy.
+    double *m = mtx_matrix_row(M, 0);
+    for (size_t i = 1; i < M->dy; ++i) {
+      memmove(&m[i * M->dx], mtx_matrix_row(M, i), sizeof(double) * M->dx);
+    }
+    M->data->ld = M->dx;
+  }
+
+  // Follows the cycles of the permutation that takes the element k = i * dx +
+  // j to j * dy + i, marking the positions already written.
+  size_t dy = M->dy, dx = M->dx, n = dy * dx;
+  double *a = mtx_matrix_row(M, 0);
+  unsigned char *done = (unsigned char *)_mtx_scratch_alloc((n + 7) / 8);
+  memset(done, 0, (n + 7) / 8);
+
+  for (size_t start = 1; start + 1 < n; ++start) {
+    if (done[start / 8] & (1u << (start % 8))) {
+      continue;
     }
+    double x = a[start];
+    size_t k = start;
+    do {
+      k = k % dx * dy + k / dx;
+      double y = a[k];
+      a[k] = x;
+      x = y;
+      done[k / 8] |= 1u << (k % 8);
+    } while (k != start);
+  }
+
+  _mtx_scratch_free(done);
+
+  if (!MTX_MATRIX_IS_VIEW(M)) {
+    M->data->size1 = dx;
+    M->data->size2 = dy;
+    M->data->ld = dy;
+  } else {
+    // Views keep the leading dimension of the matrix they come from, so they
+    // become a reshape of its elements.
+    size_t at = _mtx_matrix_index(M, 0, 0);
+    M->offY = at / M->data->ld;
+    M->offX = at % M->data->ld;
+    M->flags = MTX_MATRIX_VIEW_STRIDED;
+    M->row_stride = (ptrdiff_t)dy;
+    M->col_stride = 1;
   }
+  M->dy = dx;
+  M->dx = dy;
+
   return 0;
 }
 
@@ -110,10 +318,19 @@ double mtx_matrix_distance(const mtx_matrix_t *A, const mtx_matrix_t *B) {
 
   double dt = 0;
 
-  for (int i = 0; i < A->dy; ++i) {
-    for (int j = 0; j < A->dx; ++j) {
-      dt += _mod(mtx_matrix_at(A, i, j) - mtx_matrix_at(B, i, j));
+  if (!MTX_MATRIX_HAS_UNIT_COLUMNS(A) || !MTX_MATRIX_HAS_UNIT_COLUMNS(B)) {
+    for (size_t i = 0; i < A->dy; ++i) {
+      for (size_t j = 0; j < A->dx; ++j) {
+        double d = mtx_matrix_at(A, i, j) - mtx_matrix_at(B, i, j);
+        dt += d < 0 ? -d : d;
+      }
     }
+    return dt;
+  }
+
+  for (size_t i = 0; i < A->dy; ++i) {
+    dt += mtx_kernels()->distance(mtx_matrix_row(A, i), mtx_matrix_row(B, i),
+                                  A->dx);
   }
 
   return dt;
@@ -143,13 +360,23 @@ double mtx_matrix_distance_each(mtx_matrix_t *_M_D, const mtx_matrix_t *A,
 
   double dt = 0;
 
-  double diff;
-  for (int i = 0; i < A->dy; ++i) {
-    for (int j = 0; j < A->dx; ++j) {
-      diff = mtx_matrix_at(A, i, j) - mtx_matrix_at(B, i, j);
-      mtx_matrix_at(&m_d, i, j) = diff;
-      dt += _mod(diff);
+  if (!MTX_MATRIX_HAS_UNIT_COLUMNS(&m_d) || !MTX_MATRIX_HAS_UNIT_COLUMNS(A) ||
+      !MTX_MATRIX_HAS_UNIT_COLUMNS(B)) {
+    for (size_t i = 0; i < A->dy; ++i) {
+      for (size_t j = 0; j < A->dx; ++j) {
+        double d = mtx_matrix_at(A, i, j) - mtx_matrix_at(B, i, j);
+        mtx_matrix_at(&m_d, i, j) = d;
+        dt += d < 0 ? -d : d;
+      }
     }
+    MTX_COMMIT_OUTPUT(m_d, _M_D);
+    return dt;
+  }
+
+  for (size_t i = 0; i < A->dy; ++i) {
+    dt += mtx_kernels()->distance_each(mtx_matrix_row(&m_d, i),
+                                       mtx_matrix_row(A, i),
+                                       mtx_matrix_row(B, i), A->dx);
   }
 
   MTX_COMMIT_OUTPUT(m_d, _M_D);
@@ -177,20 +404,22 @@ int mtx_matrix_get_upper(mtx_matrix_t *_M, const mtx_matrix_t *M) {
   }
 
   if (!MTX_MATRIX_ARE_SAME(_M, M)) {
+    MTX_ENSURE_UNIT_COLUMNS(_M);
+    MTX_ENSURE_UNIT_COLUMNS(M);
 
     SET_MEM_COPY(_M, M);
 
-    int u_max = _M->dy < _M->dx ? _M->dy : _M->dx;
-    for (int i = 0; i < u_max; ++i) {
+    size_t u_max = _M->dy < _M->dx ? _M->dy : _M->dx;
+    for (size_t i = 0; i < u_max; ++i) {
       copy(&mtx_matrix_at(_M, i, i), &mtx_matrix_at(M, i, i),
            (_M->dx - i) * sizeof(double));
     }
   }
 
   // Fill zeroes in the lower
-  for (int i = 1; i < _M->dy; ++i) {
-    int max_zero = i < _M->dx ? i : _M->dx;
-    for (int j = 0; j < max_zero; ++j) {
+  for (size_t i = 1; i < _M->dy; ++i) {
+    size_t max_zero = i < _M->dx ? i : _M->dx;
+    for (size_t j = 0; j < max_zero; ++j) {
       mtx_matrix_at(_M, i, j) = 0;
     }
   }
@@ -209,20 +438,22 @@ int mtx_matrix_get_lower(mtx_matrix_t *_M, const mtx_matrix_t *M) {
   }
 
   if (!MTX_MATRIX_ARE_SAME(_M, M)) {
+    MTX_ENSURE_UNIT_COLUMNS(_M);
+    MTX_ENSURE_UNIT_COLUMNS(M);
 
     SET_MEM_COPY(_M, M);
 
-    int l_max = _M->dx;
-    for (int i = 0; i < _M->dy; ++i) {
-      int els = i + 1 < _M->dx ? i + 1 : _M->dx;
+    size_t l_max = _M->dx;
+    for (size_t i = 0; i < _M->dy; ++i) {
+      size_t els = i + 1 < _M->dx ? i + 1 : _M->dx;
       copy(mtx_matrix_row(_M, i), mtx_matrix_row(M, i), els * sizeof(double));
     }
   }
 
   // Fill zeroes in the upper
-  int u_max = _M->dy < _M->dx ? _M->dy : _M->dx;
-  for (int i = 0; i < u_max - 1; ++i) {
-    for (int j = i + 1; j < _M->dx; ++j) {
+  size_t u_max = _M->dy < _M->dx ? _M->dy : _M->dx;
+  for (size_t i = 0; i < u_max - 1; ++i) {
+    for (size_t j = i + 1; j < _M->dx; ++j) {
       mtx_matrix_at(_M, i, j) = 0;
     }
   }
@@ -232,7 +463,152 @@ int mtx_matrix_get_lower(mtx_matrix_t *_M, const mtx_matrix_t *M) {
 
 #undef SET_MEM_COPY
 
-#define DEF_MTX_MATRIX_SIMPLE_OP(name, operation)                              \
+// Scalar form of the kernels, for operands whose rows aren't contiguous.
+typedef enum mtx_element_op {
+  MTX_ELEMENT_ADD,
+  MTX_ELEMENT_SUB,
+  MTX_ELEMENT_MUL,
+  MTX_ELEMENT_DIV,
+  // C = A * scalar, without B.
+  MTX_ELEMENT_SCALE,
+} mtx_element_op_t;
+
+typedef struct mtx_row_op_job {
+  const mtx_kernels_t *kernels;
+  mtx_element_op_t element_op;
+  double scalar;
+  // Some operand is a view with non-unit column stride.
+  int strided;
+  mtx_matrix_t *C;
+  const mtx_matrix_t *A, *B;
+} mtx_row_op_job_t;
+
+// c[i] = a[i] (op) b[i] over n contiguous elements.
+static void _mtx_row_op_kernel(const mtx_row_op_job_t *job, double *c,
+                               const double *a, const double *b, size_t n) {
+  const mtx_kernels_t *kernels = job->kernels;
+  switch (job->element_op) {
+  case MTX_ELEMENT_ADD:
+    kernels->add(c, a, b, n);
+    break;
+  case MTX_ELEMENT_SUB:
+    kernels->sub(c, a, b, n);
+    break;
+  case MTX_ELEMENT_MUL:
+    kernels->mul(c, a, b, n);
+    break;
+  case MTX_ELEMENT_DIV:
+    kernels->div(c, a, b, n);
+    break;
+  case MTX_ELEMENT_SCALE:
+    kernels->scale(c, a, job->scalar, n);
+    break;
+  }
+}
+
+static void _mtx_row_op_strided(const mtx_row_op_job_t *job, size_t i) {
+  mtx_matrix_t *C = job->C;
+  const mtx_matrix_t *A = job->A, *B = job->B;
+
+#define ROW_LOOP(op)                                                           \
+  for (size_t j = 0; j < A->dx; ++j) {                                         \
+    mtx_matrix_at(C, i, j) = mtx_matrix_at(A, i, j) op mtx_matrix_at(B, i, j); \
+  }
+
+  switch (job->element_op) {
+  case MTX_ELEMENT_ADD:
+    ROW_LOOP(+);
+    break;
+  case MTX_ELEMENT_SUB:
+    ROW_LOOP(-);
+    break;
+  case MTX_ELEMENT_MUL:
+    ROW_LOOP(*);
+    break;
+  case MTX_ELEMENT_DIV:
+    ROW_LOOP(/);
+    break;
+  case MTX_ELEMENT_SCALE:
+    for (size_t j = 0; j < A->dx; ++j) {
+      mtx_matrix_at(C, i, j) = mtx_matrix_at(A, i, j) * job->scalar;
+    }
+    break;
+  }
+
+#undef ROW_LOOP
+}
+
+static void _mtx_row_op_task(void *arg, size_t begin, size_t end) {
+  mtx_row_op_job_t *job = (mtx_row_op_job_t *)arg;
+  for (size_t i = begin; i < end; ++i) {
+    if (job->strided) {
+      _mtx_row_op_strided(job, i);
+    } else {
+      _mtx_row_op_kernel(job, mtx_matrix_row(job->C, i),
+                         mtx_matrix_row(job->A, i),
+                         job->B != NULL ? mtx_matrix_row(job->B, i) : NULL,
+                         job->A->dx);
+    }
+  }
+}
+
+// Elements [begin, end) of contiguous operands, taken as a single row.
+static void _mtx_flat_op_task(void *arg, size_t begin, size_t end) {
+  mtx_row_op_job_t *job = (mtx_row_op_job_t *)arg;
+  _mtx_row_op_kernel(job, mtx_matrix_row(job->C, 0) + begin,
+                     mtx_matrix_row(job->A, 0) + begin,
+                     job->B != NULL ? mtx_matrix_row(job->B, 0) + begin : NULL,
+                     end - begin);
+}
+
+// The elements can be computed in any order only when C doesn't overwrite
+// elements of the input other than its own. An overlapping input (a view
+// shifted by some columns, ...) relies on the serial forward loop.
+#define _MTX_ROWS_INDEPENDENT(C, M)                                            \
+  ((M) == NULL || !MTX_MATRIX_OVERLAP(M, C) || MTX_MATRIX_ARE_SAME(M, C))
+
+// C = A (op) B, split between the threads for large matrices. B is NULL for
+// MTX_ELEMENT_SCALE. When every operand is contiguous the whole buffers are
+// passed to the kernel at once; otherwise it runs row by row, or element by
+// element for views with non-unit column stride.
+static void _mtx_matrix_row_op(mtx_element_op_t element_op, double scalar,
+                               mtx_matrix_t *C, const mtx_matrix_t *A,
+                               const mtx_matrix_t *B) {
+  mtx_row_op_job_t job = {
+      .kernels = mtx_kernels(),
+      .element_op = element_op,
+      .scalar = scalar,
+      .strided = !MTX_MATRIX_HAS_UNIT_COLUMNS(C) ||
+                 !MTX_MATRIX_HAS_UNIT_COLUMNS(A) ||
+                 (B != NULL && !MTX_MATRIX_HAS_UNIT_COLUMNS(B)),
+      .C = C,
+      .A = A,
+      .B = B};
+
+  const size_t size = (size_t)A->dy * A->dx;
+  const int parallel = size >= MTX_PARALLEL_MIN_ELEMENTS &&
+                       _MTX_ROWS_INDEPENDENT(C, A) &&
+                       _MTX_ROWS_INDEPENDENT(C, B);
+
+  if (MTX_MATRIX_IS_CONTIGUOUS(C) && MTX_MATRIX_IS_CONTIGUOUS(A) &&
+      (B == NULL || MTX_MATRIX_IS_CONTIGUOUS(B))) {
+    if (parallel) {
+      mtx_parallel_for(0, size, MTX_PARALLEL_GRAIN_ELEMENTS, _mtx_flat_op_task,
+                       &job);
+    } else {
+      _mtx_flat_op_task(&job, 0, size);
+    }
+  } else if (parallel) {
+    mtx_parallel_for(0, A->dy, MTX_PARALLEL_ROWS_GRAIN(A->dx),
+                     _mtx_row_op_task, &job);
+  } else {
+    _mtx_row_op_task(&job, 0, A->dy);
+  }
+}
+
+#undef _MTX_ROWS_INDEPENDENT
+
+#define DEF_MTX_MATRIX_SIMPLE_OP(name, element_op)                             \
   int mtx_matrix_##name(mtx_matrix_t *_C, const mtx_matrix_t *A,               \
                         const mtx_matrix_t *B) {                               \
                                                                                \
@@ -251,18 +627,33 @@ int mtx_matrix_get_lower(mtx_matrix_t *_M, const mtx_matrix_t *M) {
     MTX_ENSURE_SAFE_OUTPUT_RULES(c, _C, A, MTX_MATRIX_OVERLAP_AFTER(A, _C));   \
     MTX_ENSURE_SAFE_OUTPUT_RULES(c, _C, B, MTX_MATRIX_OVERLAP_AFTER(B, _C));   \
                                                                                \
-    for (int i = 0; i < A->dy; ++i) {                                          \
-      for (int j = 0; j < A->dx; ++j) {                                        \
-        mtx_matrix_at(_C, i, j) =                                              \
-            mtx_matrix_at(A, i, j) operation mtx_matrix_at(B, i, j);           \
-      }                                                                        \
-    }                                                                          \
+    _mtx_matrix_row_op(element_op, 0, &c, A, B);                               \
+                                                                               \
+    MTX_COMMIT_OUTPUT(c, _C);                                                  \
     return 0;                                                                  \
   }
 
-DEF_MTX_MATRIX_SIMPLE_OP(add, +);
-DEF_MTX_MATRIX_SIMPLE_OP(sub, -);
-DEF_MTX_MATRIX_SIMPLE_OP(mul_elements, *);
-DEF_MTX_MATRIX_SIMPLE_OP(div_elements, /);
+DEF_MTX_MATRIX_SIMPLE_OP(add, MTX_ELEMENT_ADD);
+DEF_MTX_MATRIX_SIMPLE_OP(sub, MTX_ELEMENT_SUB);
+DEF_MTX_MATRIX_SIMPLE_OP(mul_elements, MTX_ELEMENT_MUL);
+DEF_MTX_MATRIX_SIMPLE_OP(div_elements, MTX_ELEMENT_DIV);
 
 #undef DEF_MTX_MATRIX_SIMPLE_OP
+
+int mtx_matrix_s_mul(mtx_matrix_t *_M, const mtx_matrix_t *M, double scalar) {
+  MTX_ENSURE_INIT(M);
+
+  if (_M->data == NULL) {
+    mtx_matrix_init(_M, M->dy, M->dx);
+  } else if (!MTX_MATRIX_SAME_DIMENSIONS(_M, M)) {
+    MTX_DIMEN_ERR(_M);
+  }
+
+  MTX_MAKE_OUTPUT_ALIAS(m_res, _M);
+  MTX_ENSURE_SAFE_OUTPUT_RULES(m_res, _M, M, MTX_MATRIX_OVERLAP_AFTER(M, _M));
+
+  _mtx_matrix_row_op(MTX_ELEMENT_SCALE, scalar, &m_res, M, NULL);
+
+  MTX_COMMIT_OUTPUT(m_res, _M);
+  return 0;
+}
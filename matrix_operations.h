@@ -15,6 +15,19 @@ void mtx_matrix_set_identity(mtx_matrix_t *_M);
 int mtx_matrix_mul(mtx_matrix_t *_C, const mtx_matrix_t *A,
                    const mtx_matrix_t *B);
 
+// Operação aplicada a um operando de mtx_matrix_gemm().
+#define MTX_NO_TRANS 0
+#define MTX_TRANS 1
+
+// Calcula C = alpha * op(A) x op(B) + beta * C, sendo op(X) = X^T caso trans
+// seja MTX_TRANS (sem copiar X). O resultado é acumulado diretamente em C, sem
+// temporários, exceto quando C converge com A ou B. Caso C não esteja
+// inicializada, é criada com as dimensões do produto e beta é ignorado; com
+// beta == 0, os elementos de C não são lidos.
+int mtx_matrix_gemm(int transA, int transB, double alpha,
+                    const mtx_matrix_t *A, const mtx_matrix_t *B, double beta,
+                    mtx_matrix_t *C);
+
 // Multiplica todos os elementos de M com scalar e salva na matriz _M.
 int mtx_matrix_s_mul(mtx_matrix_t *_M, const mtx_matrix_t *M, double scalar);
 
@@ -34,9 +47,19 @@ int mtx_matrix_mul_elements(mtx_matrix_t *_C, const mtx_matrix_t *A,
 int mtx_matrix_div_elements(mtx_matrix_t *_C, const mtx_matrix_t *A,
                             const mtx_matrix_t *B);
 
-// Salva a matriz transposta de M em _M.
+// Salva a matriz transposta de M em _M. Caso _M e M sejam a mesma matriz
+// (quadrada), a transposição é feita no lugar; caso só se sobreponham, através
+// de uma matriz temporária.
 int mtx_matrix_transpose(mtx_matrix_t *_M, const mtx_matrix_t *M);
 
+// Transpõe M no lugar, trocando as suas dimensões. Os elementos de matrizes
+// retangulares são permutados seguindo os ciclos da transposição: as linhas
+// de uma matriz com padding (mtx_matrix_init()) são antes juntadas, e ela
+// passa a ter ld = dy. Views retangulares têm que ter os elementos contíguos
+// (MTX_MATRIX_IS_CONTIGUOUS, senão MTX_INVALID_ERR) e passam a ser um reshape
+// deles (ver mtx_matrix_reshape_of()).
+int mtx_matrix_transpose_in_place(mtx_matrix_t *M);
+
 // Calcula e retorna o grau de diferença entre as matrizes A e B. Retorna
 // sempre um número positivo, exceto na falha na qual o número retornado é
 // negativo.
@@ -0,0 +1,875 @@
+#include "simd.h"
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MTX_SIMD_X86
+#include <immintrin.h>
+#endif
+
+#define _abs(x) ((x) < 0 ? -(x) : (x))
+
+// SCALAR
+
+static void _mtx_gemm_micro_scalar(int kc, const double *restrict Ap,
+                                   const double *restrict Bp,
+                                   double *restrict ab) {
+  double c[4][8] = {{0}};
+
+  for (int p = 0; p < kc; ++p) {
+    for (int i = 0; i < 4; ++i) {
+      double a = Ap[i];
+      for (int j = 0; j < 8; ++j) {
+        c[i][j] += a * Bp[j];
+      }
+    }
+    Ap += 4;
+    Bp += 8;
+  }
+
+  memcpy(ab, c, sizeof(c));
+}
+
+static void _mtx_sum_multiple_scalar(double *r, const double *mul_r,
+                                     double mul, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    r[i] += mul_r[i] * mul;
+  }
+}
+
+#define DEF_SCALAR_OP(name, operation)                                         \
+  static void _mtx_##name##_scalar(double *c, const double *a,                 \
+                                   const double *b, size_t n) {                \
+    for (size_t i = 0; i < n; ++i) {                                           \
+      c[i] = a[i] operation b[i];                                              \
+    }                                                                          \
+  }
+
+DEF_SCALAR_OP(add, +);
+DEF_SCALAR_OP(sub, -);
+DEF_SCALAR_OP(mul, *);
+DEF_SCALAR_OP(div, /);
+
+#undef DEF_SCALAR_OP
+
+static void _mtx_scale_scalar(double *c, const double *a, double s, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    c[i] = a[i] * s;
+  }
+}
+
+static double _mtx_dot_scalar(const double *a, const double *b, size_t n) {
+  double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    s0 += a[i] * b[i];
+    s1 += a[i + 1] * b[i + 1];
+    s2 += a[i + 2] * b[i + 2];
+    s3 += a[i + 3] * b[i + 3];
+  }
+  for (; i < n; ++i) {
+    s0 += a[i] * b[i];
+  }
+  return (s0 + s1) + (s2 + s3);
+}
+
+static double _mtx_asum_scalar(const double *a, size_t n) {
+  double s = 0;
+  for (size_t i = 0; i < n; ++i) {
+    s += _abs(a[i]);
+  }
+  return s;
+}
+
+static double _mtx_amax_scalar(const double *a, size_t n) {
+  double max = 0;
+  for (size_t i = 0; i < n; ++i) {
+    double v = _abs(a[i]);
+    max = v > max ? v : max;
+  }
+  return max;
+}
+
+static double _mtx_distance_scalar(const double *a, const double *b, size_t n) {
+  double dt = 0;
+  for (size_t i = 0; i < n; ++i) {
+    dt += _abs(a[i] - b[i]);
+  }
+  return dt;
+}
+
+static double _mtx_distance_each_scalar(double *d, const double *a,
+                                        const double *b, size_t n) {
+  double dt = 0;
+  for (size_t i = 0; i < n; ++i) {
+    double diff = a[i] - b[i];
+    d[i] = diff;
+    dt += _abs(diff);
+  }
+  return dt;
+}
+
+static void _mtx_gemv_scalar(double *y, const double *a, ptrdiff_t lda,
+                             const double *x, size_t m, size_t k) {
+  size_t i = 0;
+  for (; i + 4 <= m; i += 4) {
+    const double *a0 = &a[(ptrdiff_t)i * lda], *a1 = a0 + lda, *a2 = a1 + lda,
+                 *a3 = a2 + lda;
+    double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    for (size_t p = 0; p < k; ++p) {
+      s0 += a0[p] * x[p];
+      s1 += a1[p] * x[p];
+      s2 += a2[p] * x[p];
+      s3 += a3[p] * x[p];
+    }
+    y[i] = s0;
+    y[i + 1] = s1;
+    y[i + 2] = s2;
+    y[i + 3] = s3;
+  }
+  for (; i < m; ++i) {
+    const double *a0 = &a[(ptrdiff_t)i * lda];
+    double s = 0;
+    for (size_t p = 0; p < k; ++p) {
+      s += a0[p] * x[p];
+    }
+    y[i] = s;
+  }
+}
+
+static void _mtx_gemv_t_scalar(double *y, const double *a, ptrdiff_t lda,
+                               const double *x, size_t k, size_t n) {
+  size_t p = 0;
+  for (; p + 4 <= k; p += 4) {
+    const double *a0 = &a[(ptrdiff_t)p * lda], *a1 = a0 + lda, *a2 = a1 + lda,
+                 *a3 = a2 + lda;
+    for (size_t j = 0; j < n; ++j) {
+      y[j] += x[p] * a0[j] + x[p + 1] * a1[j] + x[p + 2] * a2[j] +
+              x[p + 3] * a3[j];
+    }
+  }
+  for (; p < k; ++p) {
+    _mtx_sum_multiple_scalar(y, &a[(ptrdiff_t)p * lda], x[p], n);
+  }
+}
+
+static void _mtx_transpose_block_scalar(double *restrict b, ptrdiff_t ldb,
+                                        const double *restrict a,
+                                        ptrdiff_t lda) {
+  for (int i = 0; i < 4; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      b[j * ldb + i] = a[i * lda + j];
+    }
+  }
+}
+
+static const mtx_kernels_t __mtx_kernels_scalar = {
+    .simd = MTX_SIMD_SCALAR,
+    .gemm_mr = 4,
+    .gemm_nr = 8,
+    .gemm_micro = _mtx_gemm_micro_scalar,
+    .sum_multiple = _mtx_sum_multiple_scalar,
+    .add = _mtx_add_scalar,
+    .sub = _mtx_sub_scalar,
+    .mul = _mtx_mul_scalar,
+    .div = _mtx_div_scalar,
+    .scale = _mtx_scale_scalar,
+    .distance = _mtx_distance_scalar,
+    .distance_each = _mtx_distance_each_scalar,
+    .dot = _mtx_dot_scalar,
+    .asum = _mtx_asum_scalar,
+    .amax = _mtx_amax_scalar,
+    .gemv = _mtx_gemv_scalar,
+    .gemv_t = _mtx_gemv_t_scalar,
+    .transpose_nb = 4,
+    .transpose_block = _mtx_transpose_block_scalar,
+};
+
+#ifdef MTX_SIMD_X86
+
+// The vector kernels share the same body, only changing the vector type and
+// the intrinsics. Each one handles the tail (n not multiple of the vector
+// width) with the scalar code.
+
+#define DEF_VEC_SUM_MULTIPLE(isa, tgt, vec, w, vset1, vloadu, vstoreu, vadd,   \
+                             vmul)                                             \
+  __attribute__((target(tgt))) static void _mtx_sum_multiple_##isa(            \
+      double *r, const double *mul_r, double mul_, size_t n) {                 \
+    vec m = vset1(mul_);                                                       \
+    size_t i = 0;                                                              \
+    for (; i + 2 * (w) <= n; i += 2 * (w)) {                                   \
+      vec r0 = vadd(vloadu(&r[i]), vmul(vloadu(&mul_r[i]), m));                \
+      vec r1 = vadd(vloadu(&r[i + (w)]), vmul(vloadu(&mul_r[i + (w)]), m));    \
+      vstoreu(&r[i], r0);                                                      \
+      vstoreu(&r[i + (w)], r1);                                                \
+    }                                                                          \
+    for (; i + (w) <= n; i += (w)) {                                           \
+      vstoreu(&r[i], vadd(vloadu(&r[i]), vmul(vloadu(&mul_r[i]), m)));         \
+    }                                                                          \
+    _mtx_sum_multiple_scalar(&r[i], &mul_r[i], mul_, n - i);                   \
+  }
+
+#define DEF_VEC_OP(isa, tgt, name, operation, vec, w, vloadu, vstoreu, op)     \
+  __attribute__((target(tgt))) static void _mtx_##name##_##isa(                \
+      double *c, const double *a, const double *b, size_t n) {                 \
+    size_t i = 0;                                                              \
+    for (; i + 2 * (w) <= n; i += 2 * (w)) {                                   \
+      vec c0 = op(vloadu(&a[i]), vloadu(&b[i]));                               \
+      vec c1 = op(vloadu(&a[i + (w)]), vloadu(&b[i + (w)]));                   \
+      vstoreu(&c[i], c0);                                                      \
+      vstoreu(&c[i + (w)], c1);                                                \
+    }                                                                          \
+    for (; i + (w) <= n; i += (w)) {                                           \
+      vstoreu(&c[i], op(vloadu(&a[i]), vloadu(&b[i])));                        \
+    }                                                                          \
+    for (; i < n; ++i) {                                                       \
+      c[i] = a[i] operation b[i];                                              \
+    }                                                                          \
+  }
+
+#define DEF_VEC_SCALE(isa, tgt, vec, w, vset1, vloadu, vstoreu, vmul)          \
+  __attribute__((target(tgt))) static void _mtx_scale_##isa(                   \
+      double *c, const double *a, double s, size_t n) {                        \
+    vec sv = vset1(s);                                                         \
+    size_t i = 0;                                                              \
+    for (; i + 2 * (w) <= n; i += 2 * (w)) {                                   \
+      vec c0 = vmul(vloadu(&a[i]), sv);                                        \
+      vec c1 = vmul(vloadu(&a[i + (w)]), sv);                                  \
+      vstoreu(&c[i], c0);                                                      \
+      vstoreu(&c[i + (w)], c1);                                                \
+    }                                                                          \
+    for (; i + (w) <= n; i += (w)) {                                           \
+      vstoreu(&c[i], vmul(vloadu(&a[i]), sv));                                 \
+    }                                                                          \
+    _mtx_scale_scalar(&c[i], &a[i], s, n - i);                                 \
+  }
+
+// |x| is computed by clearing the sign bit (andnot with -0.0).
+#define DEF_VEC_DISTANCE(isa, tgt, vec, w, vset1, vzero, vloadu, vstoreu,      \
+                         vadd, vsub, vandnot, vhsum)                           \
+  __attribute__((target(tgt))) static double _mtx_distance_##isa(              \
+      const double *a, const double *b, size_t n) {                            \
+    vec sign = vset1(-0.0);                                                    \
+    vec s0 = vzero(), s1 = vzero();                                            \
+    size_t i = 0;                                                              \
+    for (; i + 2 * (w) <= n; i += 2 * (w)) {                                   \
+      s0 = vadd(s0, vandnot(sign, vsub(vloadu(&a[i]), vloadu(&b[i]))));        \
+      s1 = vadd(s1, vandnot(sign, vsub(vloadu(&a[i + (w)]),                    \
+                                       vloadu(&b[i + (w)]))));                 \
+    }                                                                          \
+    for (; i + (w) <= n; i += (w)) {                                           \
+      s0 = vadd(s0, vandnot(sign, vsub(vloadu(&a[i]), vloadu(&b[i]))));        \
+    }                                                                          \
+    return vhsum(vadd(s0, s1)) + _mtx_distance_scalar(&a[i], &b[i], n - i);    \
+  }                                                                            \
+                                                                               \
+  __attribute__((target(tgt))) static double _mtx_distance_each_##isa(         \
+      double *d, const double *a, const double *b, size_t n) {                 \
+    vec sign = vset1(-0.0);                                                    \
+    vec s0 = vzero();                                                          \
+    size_t i = 0;                                                              \
+    for (; i + (w) <= n; i += (w)) {                                           \
+      vec diff = vsub(vloadu(&a[i]), vloadu(&b[i]));                           \
+      vstoreu(&d[i], diff);                                                    \
+      s0 = vadd(s0, vandnot(sign, diff));                                      \
+    }                                                                          \
+    return vhsum(s0) + _mtx_distance_each_scalar(&d[i], &a[i], &b[i], n - i);  \
+  }
+
+// Four rows of a are walked at the same time: the gemv loads each vector of x
+// once for the 4 dot products and the gemv_t loads and stores each vector of y
+// once for the 4 rows. _mtx_sum_multiple_##isa must be defined before.
+#define DEF_VEC_GEMV(isa, tgt, vec, w, vset1, vzero, vloadu, vstoreu, vfmadd,  \
+                     vhsum)                                                    \
+  __attribute__((target(tgt))) static void _mtx_gemv_##isa(                    \
+      double *y, const double *a, ptrdiff_t lda, const double *x, size_t m,    \
+      size_t k) {                                                              \
+    size_t i = 0;                                                              \
+    for (; i + 4 <= m; i += 4) {                                               \
+      const double *a0 = &a[(ptrdiff_t)i * lda], *a1 = a0 + lda,               \
+                   *a2 = a1 + lda, *a3 = a2 + lda;                             \
+      vec s0 = vzero(), s1 = vzero(), s2 = vzero(), s3 = vzero();              \
+      size_t p = 0;                                                            \
+      for (; p + (w) <= k; p += (w)) {                                         \
+        vec xv = vloadu(&x[p]);                                                \
+        s0 = vfmadd(vloadu(&a0[p]), xv, s0);                                   \
+        s1 = vfmadd(vloadu(&a1[p]), xv, s1);                                   \
+        s2 = vfmadd(vloadu(&a2[p]), xv, s2);                                   \
+        s3 = vfmadd(vloadu(&a3[p]), xv, s3);                                   \
+      }                                                                        \
+      double t0 = vhsum(s0), t1 = vhsum(s1), t2 = vhsum(s2), t3 = vhsum(s3);   \
+      for (; p < k; ++p) {                                                     \
+        t0 += a0[p] * x[p];                                                    \
+        t1 += a1[p] * x[p];                                                    \
+        t2 += a2[p] * x[p];                                                    \
+        t3 += a3[p] * x[p];                                                    \
+      }                                                                        \
+      y[i] = t0;                                                               \
+      y[i + 1] = t1;                                                           \
+      y[i + 2] = t2;                                                           \
+      y[i + 3] = t3;                                                           \
+    }                                                                          \
+    for (; i < m; ++i) {                                                       \
+      const double *a0 = &a[(ptrdiff_t)i * lda];                               \
+      vec s0 = vzero();                                                        \
+      size_t p = 0;                                                            \
+      for (; p + (w) <= k; p += (w)) {                                         \
+        s0 = vfmadd(vloadu(&a0[p]), vloadu(&x[p]), s0);                        \
+      }                                                                        \
+      double t0 = vhsum(s0);                                                   \
+      for (; p < k; ++p) {                                                     \
+        t0 += a0[p] * x[p];                                                    \
+      }                                                                        \
+      y[i] = t0;                                                               \
+    }                                                                          \
+  }                                                                            \
+                                                                               \
+  __attribute__((target(tgt))) static void _mtx_gemv_t_##isa(                  \
+      double *y, const double *a, ptrdiff_t lda, const double *x, size_t k,    \
+      size_t n) {                                                              \
+    size_t p = 0;                                                              \
+    for (; p + 4 <= k; p += 4) {                                               \
+      const double *a0 = &a[(ptrdiff_t)p * lda], *a1 = a0 + lda,               \
+                   *a2 = a1 + lda, *a3 = a2 + lda;                             \
+      vec x0 = vset1(x[p]), x1 = vset1(x[p + 1]), x2 = vset1(x[p + 2]),        \
+          x3 = vset1(x[p + 3]);                                                \
+      size_t j = 0;                                                            \
+      for (; j + (w) <= n; j += (w)) {                                         \
+        vec yv = vfmadd(vloadu(&a0[j]), x0, vloadu(&y[j]));                    \
+        yv = vfmadd(vloadu(&a1[j]), x1, yv);                                   \
+        yv = vfmadd(vloadu(&a2[j]), x2, yv);                                   \
+        yv = vfmadd(vloadu(&a3[j]), x3, yv);                                   \
+        vstoreu(&y[j], yv);                                                    \
+      }                                                                        \
+      for (; j < n; ++j) {                                                     \
+        y[j] += x[p] * a0[j] + x[p + 1] * a1[j] + x[p + 2] * a2[j] +           \
+                x[p + 3] * a3[j];                                              \
+      }                                                                        \
+    }                                                                          \
+    for (; p < k; ++p) {                                                       \
+      _mtx_sum_multiple_##isa(y, &a[(ptrdiff_t)p * lda], x[p], n);             \
+    }                                                                          \
+  }
+
+// |x| is computed by clearing the sign bit, as in the distances.
+#define DEF_VEC_BLAS1(isa, tgt, vec, w, vset1, vzero, vloadu, vstoreu, vadd,   \
+                      vfmadd, vandnot, vmax, vhsum)                            \
+  __attribute__((target(tgt))) static double _mtx_dot_##isa(                   \
+      const double *a, const double *b, size_t n) {                            \
+    vec s0 = vzero(), s1 = vzero(), s2 = vzero(), s3 = vzero();                \
+    size_t i = 0;                                                              \
+    for (; i + 4 * (w) <= n; i += 4 * (w)) {                                   \
+      s0 = vfmadd(vloadu(&a[i]), vloadu(&b[i]), s0);                           \
+      s1 = vfmadd(vloadu(&a[i + (w)]), vloadu(&b[i + (w)]), s1);               \
+      s2 = vfmadd(vloadu(&a[i + 2 * (w)]), vloadu(&b[i + 2 * (w)]), s2);       \
+      s3 = vfmadd(vloadu(&a[i + 3 * (w)]), vloadu(&b[i + 3 * (w)]), s3);       \
+    }                                                                          \
+    for (; i + (w) <= n; i += (w)) {                                           \
+      s0 = vfmadd(vloadu(&a[i]), vloadu(&b[i]), s0);                           \
+    }                                                                          \
+    double dot = vhsum(vadd(vadd(s0, s1), vadd(s2, s3)));                      \
+    return dot + _mtx_dot_scalar(&a[i], &b[i], n - i);                         \
+  }                                                                            \
+                                                                               \
+  __attribute__((target(tgt))) static double _mtx_asum_##isa(const double *a,  \
+                                                             size_t n) {       \
+    vec sign = vset1(-0.0);                                                    \
+    vec s0 = vzero(), s1 = vzero();                                            \
+    size_t i = 0;                                                              \
+    for (; i + 2 * (w) <= n; i += 2 * (w)) {                                   \
+      s0 = vadd(s0, vandnot(sign, vloadu(&a[i])));                             \
+      s1 = vadd(s1, vandnot(sign, vloadu(&a[i + (w)])));                       \
+    }                                                                          \
+    for (; i + (w) <= n; i += (w)) {                                           \
+      s0 = vadd(s0, vandnot(sign, vloadu(&a[i])));                             \
+    }                                                                          \
+    return vhsum(vadd(s0, s1)) + _mtx_asum_scalar(&a[i], n - i);               \
+  }                                                                            \
+                                                                               \
+  __attribute__((target(tgt))) static double _mtx_amax_##isa(const double *a,  \
+                                                             size_t n) {       \
+    vec sign = vset1(-0.0);                                                    \
+    vec m0 = vzero(), m1 = vzero();                                            \
+    size_t i = 0;                                                              \
+    for (; i + 2 * (w) <= n; i += 2 * (w)) {                                   \
+      m0 = vmax(m0, vandnot(sign, vloadu(&a[i])));                             \
+      m1 = vmax(m1, vandnot(sign, vloadu(&a[i + (w)])));                       \
+    }                                                                          \
+    for (; i + (w) <= n; i += (w)) {                                           \
+      m0 = vmax(m0, vandnot(sign, vloadu(&a[i])));                             \
+    }                                                                          \
+    double lanes[w];                                                           \
+    vstoreu(lanes, vmax(m0, m1));                                              \
+    double max = _mtx_amax_scalar(&a[i], n - i);                               \
+    for (int l = 0; l < (w); ++l) {                                            \
+      max = lanes[l] > max ? lanes[l] : max;                                   \
+    }                                                                          \
+    return max;                                                                \
+  }
+
+#define DEF_VEC_KERNELS(isa, tgt, vec, w, vset1, vzero, vloadu, vstoreu, vadd, \
+                        vsub, vmul, vdiv, vandnot, vhsum)                      \
+  DEF_VEC_SUM_MULTIPLE(isa, tgt, vec, w, vset1, vloadu, vstoreu, vadd, vmul)   \
+  DEF_VEC_OP(isa, tgt, add, +, vec, w, vloadu, vstoreu, vadd)                  \
+  DEF_VEC_OP(isa, tgt, sub, -, vec, w, vloadu, vstoreu, vsub)                  \
+  DEF_VEC_OP(isa, tgt, mul, *, vec, w, vloadu, vstoreu, vmul)                  \
+  DEF_VEC_OP(isa, tgt, div, /, vec, w, vloadu, vstoreu, vdiv)                  \
+  DEF_VEC_SCALE(isa, tgt, vec, w, vset1, vloadu, vstoreu, vmul)                \
+  DEF_VEC_DISTANCE(isa, tgt, vec, w, vset1, vzero, vloadu, vstoreu, vadd,      \
+                   vsub, vandnot, vhsum)
+
+// SSE2
+
+__attribute__((target("sse2"))) static inline double
+_mtx_hsum_sse2(__m128d v) {
+  return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+}
+
+DEF_VEC_KERNELS(sse2, "sse2", __m128d, 2, _mm_set1_pd, _mm_setzero_pd,
+                _mm_loadu_pd, _mm_storeu_pd, _mm_add_pd, _mm_sub_pd,
+                _mm_mul_pd, _mm_div_pd, _mm_andnot_pd, _mtx_hsum_sse2);
+
+// SSE2 has no fused multiply-add.
+__attribute__((target("sse2"))) static inline __m128d
+_mtx_fmadd_sse2(__m128d a, __m128d b, __m128d c) {
+  return _mm_add_pd(_mm_mul_pd(a, b), c);
+}
+
+DEF_VEC_GEMV(sse2, "sse2", __m128d, 2, _mm_set1_pd, _mm_setzero_pd,
+             _mm_loadu_pd, _mm_storeu_pd, _mtx_fmadd_sse2, _mtx_hsum_sse2);
+DEF_VEC_BLAS1(sse2, "sse2", __m128d, 2, _mm_set1_pd, _mm_setzero_pd,
+              _mm_loadu_pd, _mm_storeu_pd, _mm_add_pd, _mtx_fmadd_sse2,
+              _mm_andnot_pd, _mm_max_pd, _mtx_hsum_sse2);
+
+// 4x4 block: 8 accumulators, 2 for each row of A.
+__attribute__((target("sse2"))) static void
+_mtx_gemm_micro_sse2(int kc, const double *restrict Ap,
+                     const double *restrict Bp, double *restrict ab) {
+  __m128d c00 = _mm_setzero_pd(), c01 = _mm_setzero_pd();
+  __m128d c10 = _mm_setzero_pd(), c11 = _mm_setzero_pd();
+  __m128d c20 = _mm_setzero_pd(), c21 = _mm_setzero_pd();
+  __m128d c30 = _mm_setzero_pd(), c31 = _mm_setzero_pd();
+
+  for (int p = 0; p < kc; ++p) {
+    __m128d b0 = _mm_loadu_pd(&Bp[0]);
+    __m128d b1 = _mm_loadu_pd(&Bp[2]);
+    __m128d a;
+
+#define ROW(i)                                                                 \
+  a = _mm_set1_pd(Ap[i]);                                                      \
+  c##i##0 = _mm_add_pd(c##i##0, _mm_mul_pd(a, b0));                            \
+  c##i##1 = _mm_add_pd(c##i##1, _mm_mul_pd(a, b1))
+
+    ROW(0);
+    ROW(1);
+    ROW(2);
+    ROW(3);
+#undef ROW
+
+    Ap += 4;
+    Bp += 4;
+  }
+
+#define STORE_ROW(i)                                                           \
+  _mm_storeu_pd(&ab[(i) * 4], c##i##0);                                        \
+  _mm_storeu_pd(&ab[(i) * 4 + 2], c##i##1)
+
+  STORE_ROW(0);
+  STORE_ROW(1);
+  STORE_ROW(2);
+  STORE_ROW(3);
+#undef STORE_ROW
+}
+
+// 4x4 block as four 2x2 blocks, each one transposed by an unpack.
+__attribute__((target("sse2"))) static void
+_mtx_transpose_block_sse2(double *restrict b, ptrdiff_t ldb,
+                          const double *restrict a, ptrdiff_t lda) {
+  for (int i = 0; i < 4; i += 2) {
+    for (int j = 0; j < 4; j += 2) {
+      __m128d r0 = _mm_loadu_pd(&a[i * lda + j]);
+      __m128d r1 = _mm_loadu_pd(&a[(i + 1) * lda + j]);
+      _mm_storeu_pd(&b[j * ldb + i], _mm_unpacklo_pd(r0, r1));
+      _mm_storeu_pd(&b[(j + 1) * ldb + i], _mm_unpackhi_pd(r0, r1));
+    }
+  }
+}
+
+static const mtx_kernels_t __mtx_kernels_sse2 = {
+    .simd = MTX_SIMD_SSE2,
+    .gemm_mr = 4,
+    .gemm_nr = 4,
+    .gemm_micro = _mtx_gemm_micro_sse2,
+    .sum_multiple = _mtx_sum_multiple_sse2,
+    .add = _mtx_add_sse2,
+    .sub = _mtx_sub_sse2,
+    .mul = _mtx_mul_sse2,
+    .div = _mtx_div_sse2,
+    .scale = _mtx_scale_sse2,
+    .distance = _mtx_distance_sse2,
+    .distance_each = _mtx_distance_each_sse2,
+    .dot = _mtx_dot_sse2,
+    .asum = _mtx_asum_sse2,
+    .amax = _mtx_amax_sse2,
+    .gemv = _mtx_gemv_sse2,
+    .gemv_t = _mtx_gemv_t_sse2,
+    .transpose_nb = 4,
+    .transpose_block = _mtx_transpose_block_sse2,
+};
+
+// AVX2 + FMA
+
+__attribute__((target("avx2,fma"))) static inline double
+_mtx_hsum_avx2(__m256d v) {
+  __m128d s = _mm_add_pd(_mm256_castpd256_pd128(v),
+                         _mm256_extractf128_pd(v, 1));
+  return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+}
+
+// sum_multiple is a fused multiply-add, so it's defined apart from the other
+// kernels.
+__attribute__((target("avx2,fma"))) static void
+_mtx_sum_multiple_avx2(double *r, const double *mul_r, double mul, size_t n) {
+  __m256d m = _mm256_set1_pd(mul);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256d r0 = _mm256_fmadd_pd(_mm256_loadu_pd(&mul_r[i]), m,
+                                 _mm256_loadu_pd(&r[i]));
+    __m256d r1 = _mm256_fmadd_pd(_mm256_loadu_pd(&mul_r[i + 4]), m,
+                                 _mm256_loadu_pd(&r[i + 4]));
+    _mm256_storeu_pd(&r[i], r0);
+    _mm256_storeu_pd(&r[i + 4], r1);
+  }
+  for (; i + 4 <= n; i += 4) {
+    _mm256_storeu_pd(&r[i], _mm256_fmadd_pd(_mm256_loadu_pd(&mul_r[i]), m,
+                                            _mm256_loadu_pd(&r[i])));
+  }
+  _mtx_sum_multiple_scalar(&r[i], &mul_r[i], mul, n - i);
+}
+
+DEF_VEC_OP(avx2, "avx2,fma", add, +, __m256d, 4, _mm256_loadu_pd,
+           _mm256_storeu_pd, _mm256_add_pd);
+DEF_VEC_OP(avx2, "avx2,fma", sub, -, __m256d, 4, _mm256_loadu_pd,
+           _mm256_storeu_pd, _mm256_sub_pd);
+DEF_VEC_OP(avx2, "avx2,fma", mul, *, __m256d, 4, _mm256_loadu_pd,
+           _mm256_storeu_pd, _mm256_mul_pd);
+DEF_VEC_OP(avx2, "avx2,fma", div, /, __m256d, 4, _mm256_loadu_pd,
+           _mm256_storeu_pd, _mm256_div_pd);
+DEF_VEC_SCALE(avx2, "avx2,fma", __m256d, 4, _mm256_set1_pd, _mm256_loadu_pd,
+              _mm256_storeu_pd, _mm256_mul_pd);
+DEF_VEC_DISTANCE(avx2, "avx2,fma", __m256d, 4, _mm256_set1_pd,
+                 _mm256_setzero_pd, _mm256_loadu_pd, _mm256_storeu_pd,
+                 _mm256_add_pd, _mm256_sub_pd, _mm256_andnot_pd,
+                 _mtx_hsum_avx2);
+DEF_VEC_GEMV(avx2, "avx2,fma", __m256d, 4, _mm256_set1_pd, _mm256_setzero_pd,
+             _mm256_loadu_pd, _mm256_storeu_pd, _mm256_fmadd_pd,
+             _mtx_hsum_avx2);
+DEF_VEC_BLAS1(avx2, "avx2,fma", __m256d, 4, _mm256_set1_pd, _mm256_setzero_pd,
+              _mm256_loadu_pd, _mm256_storeu_pd, _mm256_add_pd,
+              _mm256_fmadd_pd, _mm256_andnot_pd, _mm256_max_pd,
+              _mtx_hsum_avx2);
+
+// 6x8 block: 12 accumulators, 2 for each row of A.
+__attribute__((target("avx2,fma"))) static void
+_mtx_gemm_micro_avx2(int kc, const double *restrict Ap,
+                     const double *restrict Bp, double *restrict ab) {
+  __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+  __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+  __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+  __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+  __m256d c40 = _mm256_setzero_pd(), c41 = _mm256_setzero_pd();
+  __m256d c50 = _mm256_setzero_pd(), c51 = _mm256_setzero_pd();
+
+  for (int p = 0; p < kc; ++p) {
+    __m256d b0 = _mm256_loadu_pd(&Bp[0]);
+    __m256d b1 = _mm256_loadu_pd(&Bp[4]);
+    __m256d a;
+
+#define ROW(i)                                                                 \
+  a = _mm256_broadcast_sd(&Ap[i]);                                             \
+  c##i##0 = _mm256_fmadd_pd(a, b0, c##i##0);                                   \
+  c##i##1 = _mm256_fmadd_pd(a, b1, c##i##1)
+
+    ROW(0);
+    ROW(1);
+    ROW(2);
+    ROW(3);
+    ROW(4);
+    ROW(5);
+#undef ROW
+
+    Ap += 6;
+    Bp += 8;
+  }
+
+#define STORE_ROW(i)                                                           \
+  _mm256_storeu_pd(&ab[(i) * 8], c##i##0);                                     \
+  _mm256_storeu_pd(&ab[(i) * 8 + 4], c##i##1)
+
+  STORE_ROW(0);
+  STORE_ROW(1);
+  STORE_ROW(2);
+  STORE_ROW(3);
+  STORE_ROW(4);
+  STORE_ROW(5);
+#undef STORE_ROW
+}
+
+// Pairs of rows are interleaved inside the 128-bit lanes, then the lanes are
+// exchanged between the pairs.
+__attribute__((target("avx2,fma"))) static void
+_mtx_transpose_block_avx2(double *restrict b, ptrdiff_t ldb,
+                          const double *restrict a, ptrdiff_t lda) {
+  __m256d r0 = _mm256_loadu_pd(&a[0]);
+  __m256d r1 = _mm256_loadu_pd(&a[lda]);
+  __m256d r2 = _mm256_loadu_pd(&a[2 * lda]);
+  __m256d r3 = _mm256_loadu_pd(&a[3 * lda]);
+
+  __m256d t0 = _mm256_unpacklo_pd(r0, r1);
+  __m256d t1 = _mm256_unpackhi_pd(r0, r1);
+  __m256d t2 = _mm256_unpacklo_pd(r2, r3);
+  __m256d t3 = _mm256_unpackhi_pd(r2, r3);
+
+  _mm256_storeu_pd(&b[0], _mm256_permute2f128_pd(t0, t2, 0x20));
+  _mm256_storeu_pd(&b[ldb], _mm256_permute2f128_pd(t1, t3, 0x20));
+  _mm256_storeu_pd(&b[2 * ldb], _mm256_permute2f128_pd(t0, t2, 0x31));
+  _mm256_storeu_pd(&b[3 * ldb], _mm256_permute2f128_pd(t1, t3, 0x31));
+}
+
+static const mtx_kernels_t __mtx_kernels_avx2 = {
+    .simd = MTX_SIMD_AVX2,
+    .gemm_mr = 6,
+    .gemm_nr = 8,
+    .gemm_micro = _mtx_gemm_micro_avx2,
+    .sum_multiple = _mtx_sum_multiple_avx2,
+    .add = _mtx_add_avx2,
+    .sub = _mtx_sub_avx2,
+    .mul = _mtx_mul_avx2,
+    .div = _mtx_div_avx2,
+    .scale = _mtx_scale_avx2,
+    .distance = _mtx_distance_avx2,
+    .distance_each = _mtx_distance_each_avx2,
+    .dot = _mtx_dot_avx2,
+    .asum = _mtx_asum_avx2,
+    .amax = _mtx_amax_avx2,
+    .gemv = _mtx_gemv_avx2,
+    .gemv_t = _mtx_gemv_t_avx2,
+    .transpose_nb = 4,
+    .transpose_block = _mtx_transpose_block_avx2,
+};
+
+// AVX-512
+
+__attribute__((target("avx512f"))) static inline double
+_mtx_hsum_avx512(__m512d v) {
+  return _mm512_reduce_add_pd(v);
+}
+
+// AVX512F has no andnot for doubles (it's in AVX512DQ), so it's done in the
+// integer domain.
+__attribute__((target("avx512f"))) static inline __m512d
+_mtx_andnot_avx512(__m512d a, __m512d b) {
+  return _mm512_castsi512_pd(
+      _mm512_andnot_si512(_mm512_castpd_si512(a), _mm512_castpd_si512(b)));
+}
+
+__attribute__((target("avx512f"))) static void
+_mtx_sum_multiple_avx512(double *r, const double *mul_r, double mul, size_t n) {
+  __m512d m = _mm512_set1_pd(mul);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m512d r0 = _mm512_fmadd_pd(_mm512_loadu_pd(&mul_r[i]), m,
+                                 _mm512_loadu_pd(&r[i]));
+    __m512d r1 = _mm512_fmadd_pd(_mm512_loadu_pd(&mul_r[i + 8]), m,
+                                 _mm512_loadu_pd(&r[i + 8]));
+    _mm512_storeu_pd(&r[i], r0);
+    _mm512_storeu_pd(&r[i + 8], r1);
+  }
+  for (; i + 8 <= n; i += 8) {
+    _mm512_storeu_pd(&r[i], _mm512_fmadd_pd(_mm512_loadu_pd(&mul_r[i]), m,
+                                            _mm512_loadu_pd(&r[i])));
+  }
+  _mtx_sum_multiple_scalar(&r[i], &mul_r[i], mul, n - i);
+}
+
+DEF_VEC_OP(avx512, "avx512f", add, +, __m512d, 8, _mm512_loadu_pd,
+           _mm512_storeu_pd, _mm512_add_pd);
+DEF_VEC_OP(avx512, "avx512f", sub, -, __m512d, 8, _mm512_loadu_pd,
+           _mm512_storeu_pd, _mm512_sub_pd);
+DEF_VEC_OP(avx512, "avx512f", mul, *, __m512d, 8, _mm512_loadu_pd,
+           _mm512_storeu_pd, _mm512_mul_pd);
+DEF_VEC_OP(avx512, "avx512f", div, /, __m512d, 8, _mm512_loadu_pd,
+           _mm512_storeu_pd, _mm512_div_pd);
+DEF_VEC_SCALE(avx512, "avx512f", __m512d, 8, _mm512_set1_pd, _mm512_loadu_pd,
+              _mm512_storeu_pd, _mm512_mul_pd);
+DEF_VEC_DISTANCE(avx512, "avx512f", __m512d, 8, _mm512_set1_pd,
+                 _mm512_setzero_pd, _mm512_loadu_pd, _mm512_storeu_pd,
+                 _mm512_add_pd, _mm512_sub_pd, _mtx_andnot_avx512,
+                 _mtx_hsum_avx512);
+DEF_VEC_GEMV(avx512, "avx512f", __m512d, 8, _mm512_set1_pd,
+             _mm512_setzero_pd, _mm512_loadu_pd, _mm512_storeu_pd,
+             _mm512_fmadd_pd, _mtx_hsum_avx512);
+DEF_VEC_BLAS1(avx512, "avx512f", __m512d, 8, _mm512_set1_pd,
+              _mm512_setzero_pd, _mm512_loadu_pd, _mm512_storeu_pd,
+              _mm512_add_pd, _mm512_fmadd_pd, _mtx_andnot_avx512,
+              _mm512_max_pd, _mtx_hsum_avx512);
+
+// 8x16 block: 16 accumulators, 2 for each row of A.
+__attribute__((target("avx512f"))) static void
+_mtx_gemm_micro_avx512(int kc, const double *restrict Ap,
+                       const double *restrict Bp, double *restrict ab) {
+  __m512d c00 = _mm512_setzero_pd(), c01 = _mm512_setzero_pd();
+  __m512d c10 = _mm512_setzero_pd(), c11 = _mm512_setzero_pd();
+  __m512d c20 = _mm512_setzero_pd(), c21 = _mm512_setzero_pd();
+  __m512d c30 = _mm512_setzero_pd(), c31 = _mm512_setzero_pd();
+  __m512d c40 = _mm512_setzero_pd(), c41 = _mm512_setzero_pd();
+  __m512d c50 = _mm512_setzero_pd(), c51 = _mm512_setzero_pd();
+  __m512d c60 = _mm512_setzero_pd(), c61 = _mm512_setzero_pd();
+  __m512d c70 = _mm512_setzero_pd(), c71 = _mm512_setzero_pd();
+
+  for (int p = 0; p < kc; ++p) {
+    __m512d b0 = _mm512_loadu_pd(&Bp[0]);
+    __m512d b1 = _mm512_loadu_pd(&Bp[8]);
+    __m512d a;
+
+#define ROW(i)                                                                 \
+  a = _mm512_set1_pd(Ap[i]);                                                   \
+  c##i##0 = _mm512_fmadd_pd(a, b0, c##i##0);                                   \
+  c##i##1 = _mm512_fmadd_pd(a, b1, c##i##1)
+
+    ROW(0);
+    ROW(1);
+    ROW(2);
+    ROW(3);
+    ROW(4);
+    ROW(5);
+    ROW(6);
+    ROW(7);
+#undef ROW
+
+    Ap += 8;
+    Bp += 16;
+  }
+
+#define STORE_ROW(i)                                                           \
+  _mm512_storeu_pd(&ab[(i) * 16], c##i##0);                                    \
+  _mm512_storeu_pd(&ab[(i) * 16 + 8], c##i##1)
+
+  STORE_ROW(0);
+  STORE_ROW(1);
+  STORE_ROW(2);
+  STORE_ROW(3);
+  STORE_ROW(4);
+  STORE_ROW(5);
+  STORE_ROW(6);
+  STORE_ROW(7);
+#undef STORE_ROW
+}
+
+// 8x8 block: pairs of rows are interleaved inside the 128-bit lanes, then two
+// rounds of lane shuffles gather each column.
+__attribute__((target("avx512f"))) static void
+_mtx_transpose_block_avx512(double *restrict b, ptrdiff_t ldb,
+                            const double *restrict a, ptrdiff_t lda) {
+  __m512d t[8], u[8];
+  for (int i = 0; i < 8; i += 2) {
+    __m512d r0 = _mm512_loadu_pd(&a[(ptrdiff_t)i * lda]);
+    __m512d r1 = _mm512_loadu_pd(&a[(i + 1) * lda]);
+    t[i] = _mm512_unpacklo_pd(r0, r1);
+    t[i + 1] = _mm512_unpackhi_pd(r0, r1);
+  }
+
+  // u[k] and u[k + 4] hold the columns k and k + 4 of the rows 0-3 and 4-7.
+  for (int h = 0; h < 8; h += 4) {
+    u[h] = _mm512_shuffle_f64x2(t[h], t[h + 2], 0x88);
+    u[h + 1] = _mm512_shuffle_f64x2(t[h + 1], t[h + 3], 0x88);
+    u[h + 2] = _mm512_shuffle_f64x2(t[h], t[h + 2], 0xdd);
+    u[h + 3] = _mm512_shuffle_f64x2(t[h + 1], t[h + 3], 0xdd);
+  }
+
+  for (int k = 0; k < 4; ++k) {
+    _mm512_storeu_pd(&b[k * ldb], _mm512_shuffle_f64x2(u[k], u[k + 4], 0x88));
+    _mm512_storeu_pd(&b[(k + 4) * ldb],
+                     _mm512_shuffle_f64x2(u[k], u[k + 4], 0xdd));
+  }
+}
+
+static const mtx_kernels_t __mtx_kernels_avx512 = {
+    .simd = MTX_SIMD_AVX512,
+    .gemm_mr = 8,
+    .gemm_nr = 16,
+    .gemm_micro = _mtx_gemm_micro_avx512,
+    .sum_multiple = _mtx_sum_multiple_avx512,
+    .add = _mtx_add_avx512,
+    .sub = _mtx_sub_avx512,
+    .mul = _mtx_mul_avx512,
+    .div = _mtx_div_avx512,
+    .scale = _mtx_scale_avx512,
+    .distance = _mtx_distance_avx512,
+    .distance_each = _mtx_distance_each_avx512,
+    .dot = _mtx_dot_avx512,
+    .asum = _mtx_asum_avx512,
+    .amax = _mtx_amax_avx512,
+    .gemv = _mtx_gemv_avx512,
+    .gemv_t = _mtx_gemv_t_avx512,
+    .transpose_nb = 8,
+    .transpose_block = _mtx_transpose_block_avx512,
+};
+
+#undef DEF_VEC_KERNELS
+#undef DEF_VEC_GEMV
+#undef DEF_VEC_BLAS1
+#undef DEF_VEC_DISTANCE
+#undef DEF_VEC_SCALE
+#undef DEF_VEC_OP
+#undef DEF_VEC_SUM_MULTIPLE
+
+#endif
+
+static mtx_simd_t __mtx_cpu_simd = MTX_SIMD_SCALAR;
+
+const mtx_kernels_t *__mtx_cfg_kernels = &__mtx_kernels_scalar;
+
+static const mtx_kernels_t *__mtx_kernels_of(mtx_simd_t simd) {
+  switch (simd) {
+#ifdef MTX_SIMD_X86
+  case MTX_SIMD_AVX512:
+    return &__mtx_kernels_avx512;
+  case MTX_SIMD_AVX2:
+    return &__mtx_kernels_avx2;
+  case MTX_SIMD_SSE2:
+    return &__mtx_kernels_sse2;
+#endif
+  default:
+    return &__mtx_kernels_scalar;
+  }
+}
+
+#ifdef __GNUC__
+__attribute__((constructor))
+#endif
+static void __mtx_simd_init() {
+#ifdef MTX_SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    __mtx_cpu_simd = MTX_SIMD_AVX512;
+  } else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    __mtx_cpu_simd = MTX_SIMD_AVX2;
+  } else if (__builtin_cpu_supports("sse2")) {
+    __mtx_cpu_simd = MTX_SIMD_SSE2;
+  }
+#endif
+  __mtx_cfg_kernels = __mtx_kernels_of(__mtx_cpu_simd);
+}
+
+mtx_simd_t mtx_cpu_simd_support() { return __mtx_cpu_simd; }
+
+void mtx_cfg_set_simd(mtx_simd_t simd) {
+  if (simd == MTX_SIMD_AUTO || simd > __mtx_cpu_simd) {
+    simd = __mtx_cpu_simd;
+  }
+  __mtx_cfg_kernels = __mtx_kernels_of(simd); // TODO: Make thread safe.
+}
+
+mtx_simd_t mtx_cfg_get_simd() { return __mtx_cfg_kernels->simd; }
+
+#undef _abs
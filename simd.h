@@ -0,0 +1,102 @@
+#ifndef MTX_SIMD_H
+#define MTX_SIMD_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum mtx_simd {
+  MTX_SIMD_AUTO = -1,
+  MTX_SIMD_SCALAR = 0,
+  MTX_SIMD_SSE2,
+  MTX_SIMD_AVX2,
+  MTX_SIMD_AVX512,
+} mtx_simd_t;
+
+// Maior valor de MR e NR entre os micro-kernels de GEMM.
+#define MTX_SIMD_GEMM_MR_MAX 8
+#define MTX_SIMD_GEMM_NR_MAX 16
+
+// Maior valor de transpose_nb.
+#define MTX_SIMD_TRANSPOSE_NB_MAX 8
+
+// Tabela de kernels de uma das implementações (escalar, SSE2, AVX2+FMA ou
+// AVX-512). Todos os kernels percorrem os arrays do início para o fim, então
+// a saída pode ser a mesma memória de uma das entradas ou vir antes dela.
+typedef struct mtx_kernels {
+  mtx_simd_t simd;
+
+  // Dimensões do bloco de registradores do micro-kernel de GEMM.
+  int gemm_mr, gemm_nr;
+
+  // Calcula o bloco ab (gemm_mr x gemm_nr, row-major) = Ap x Bp, sendo Ap e
+  // Bp micro-painéis empacotados de profundidade kc.
+  void (*gemm_micro)(int kc, const double *Ap, const double *Bp, double *ab);
+
+  // r[i] += mul_r[i] * mul.
+  void (*sum_multiple)(double *r, const double *mul_r, double mul, size_t n);
+
+  // c[i] = a[i] (op) b[i].
+  void (*add)(double *c, const double *a, const double *b, size_t n);
+  void (*sub)(double *c, const double *a, const double *b, size_t n);
+  void (*mul)(double *c, const double *a, const double *b, size_t n);
+  void (*div)(double *c, const double *a, const double *b, size_t n);
+
+  // c[i] = a[i] * s.
+  void (*scale)(double *c, const double *a, double s, size_t n);
+
+  // Retorna o somatório de |a[i] - b[i]|.
+  double (*distance)(const double *a, const double *b, size_t n);
+
+  // d[i] = a[i] - b[i] e retorna o somatório de |d[i]|.
+  double (*distance_each)(double *d, const double *a, const double *b,
+                          size_t n);
+
+  // Retornam o somatório de a[i] * b[i], o somatório de |a[i]| e o maior
+  // |a[i]| (0 com n == 0).
+  double (*dot)(const double *a, const double *b, size_t n);
+  double (*asum)(const double *a, size_t n);
+  double (*amax)(const double *a, size_t n);
+
+  // y[i] = somatório de a[i * lda + p] * x[p], para i < m e p < k
+  // (matriz-vetor, percorrendo 4 linhas de a por vez).
+  void (*gemv)(double *y, const double *a, ptrdiff_t lda, const double *x,
+               size_t m, size_t k);
+
+  // y[j] += somatório de x[p] * a[p * lda + j], para j < n e p < k
+  // (transposta-vetor, acumulando 4 linhas de a por vez em y).
+  void (*gemv_t)(double *y, const double *a, ptrdiff_t lda, const double *x,
+                 size_t k, size_t n);
+
+  // Ordem dos blocos de transpose_block (4 ou 8).
+  int transpose_nb;
+
+  // Transpõe um bloco transpose_nb x transpose_nb nos registradores:
+  // b[j * ldb + i] = a[i * lda + j]. a e b não podem se sobrepor.
+  void (*transpose_block)(double *b, ptrdiff_t ldb, const double *a,
+                          ptrdiff_t lda);
+} mtx_kernels_t;
+
+extern const mtx_kernels_t *__mtx_cfg_kernels;
+
+#define mtx_kernels() (__mtx_cfg_kernels)
+
+// Retorna o maior conjunto de instruções suportado pela CPU (detectado através
+// do cpuid na inicialização da lib).
+mtx_simd_t mtx_cpu_simd_support();
+
+// Seta o conjunto de instruções usado pelos kernels. MTX_SIMD_AUTO seleciona o
+// maior suportado; um conjunto não suportado pela CPU é reduzido ao maior
+// suportado. MTX_SIMD_SCALAR força as implementações em C puro.
+void mtx_cfg_set_simd(mtx_simd_t simd);
+
+// Retorna o conjunto de instruções em uso.
+mtx_simd_t mtx_cfg_get_simd();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,95 @@
+#include "sparse.h"
+#include "errors.h"
+#include <stdlib.h>
+#include <string.h>
+
+int mtx_sparse_init_coo(mtx_sparse_t *_S, size_t dy, size_t dx, size_t nnz,
+                        const size_t *rows, const size_t *cols,
+                        const double *vals) {
+  for (size_t k = 0; k < nnz; ++k) {
+    if (rows[k] >= dy || cols[k] >= dx) {
+      return 1;
+    }
+  }
+
+  // mtx_mem_alloc() doesn't take empty allocations.
+  size_t size = nnz > 0 ? nnz : 1;
+  _S->dy = dy;
+  _S->dx = dx;
+  _S->nnz = nnz;
+  _S->row_ptr = (size_t *)mtx_mem_alloc(sizeof(size_t) * (dy + 1));
+  _S->col = (size_t *)mtx_mem_alloc(sizeof(size_t) * size);
+  _S->val = (double *)mtx_mem_alloc(sizeof(double) * size);
+
+  // Two stable counting sorts, by column and then by row, leave the columns of
+  // each row in increasing order.
+  size_t *col_ptr = (size_t *)mtx_mem_alloc(sizeof(size_t) * (dx + 1));
+  size_t *by_col = (size_t *)mtx_mem_alloc(sizeof(size_t) * size);
+
+  memset(col_ptr, 0, sizeof(size_t) * (dx + 1));
+  for (size_t k = 0; k < nnz; ++k) {
+    ++col_ptr[cols[k] + 1];
+  }
+  for (size_t j = 0; j < dx; ++j) {
+    col_ptr[j + 1] += col_ptr[j];
+  }
+  for (size_t k = 0; k < nnz; ++k) {
+    by_col[col_ptr[cols[k]]++] = k;
+  }
+
+  size_t *row_ptr = _S->row_ptr;
+  memset(row_ptr, 0, sizeof(size_t) * (dy + 1));
+  for (size_t k = 0; k < nnz; ++k) {
+    ++row_ptr[rows[k] + 1];
+  }
+  for (size_t i = 0; i < dy; ++i) {
+    row_ptr[i + 1] += row_ptr[i];
+  }
+  // row_ptr[i] is used as the position of the next entry of row i, ending at
+  // the beginning of row i + 1.
+  for (size_t n = 0; n < nnz; ++n) {
+    size_t k = by_col[n];
+    size_t at = row_ptr[rows[k]]++;
+    _S->col[at] = cols[k];
+    _S->val[at] = vals[k];
+  }
+  for (size_t i = dy; i > 0; --i) {
+    row_ptr[i] = row_ptr[i - 1];
+  }
+  row_ptr[0] = 0;
+
+  free(by_col);
+  free(col_ptr);
+  return 0;
+}
+
+void mtx_sparse_free(mtx_sparse_t *__S) {
+  if (__S == NULL) {
+    return;
+  }
+
+  free(__S->row_ptr);
+  free(__S->col);
+  free(__S->val);
+  __S->row_ptr = NULL;
+  __S->col = NULL;
+  __S->val = NULL;
+  __S->nnz = 0;
+}
+
+void mtx_sparse_to_dense(mtx_matrix_t *M, const mtx_sparse_t *S) {
+  if (M->data == NULL) {
+    mtx_matrix_init(M, S->dy, S->dx);
+  } else if (M->dy != S->dy || M->dx != S->dx) {
+    MTX_DIMEN_ERR(M);
+  }
+
+  for (size_t i = 0; i < S->dy; ++i) {
+    for (size_t j = 0; j < S->dx; ++j) {
+      mtx_matrix_at(M, i, j) = 0;
+    }
+    for (size_t k = S->row_ptr[i]; k < S->row_ptr[i + 1]; ++k) {
+      mtx_matrix_at(M, i, S->col[k]) += S->val[k];
+    }
+  }
+}
@@ -0,0 +1,43 @@
+#ifndef MTX_SPARSE_H
+#define MTX_SPARSE_H
+
+#include "matrix.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Matriz esparsa no formato CSR (compressed sparse row): os elementos não
+// nulos da linha i são val[row_ptr[i]] até val[row_ptr[i + 1] - 1], nas
+// colunas col[row_ptr[i]] até col[row_ptr[i + 1] - 1], em ordem crescente.
+typedef struct mtx_sparse {
+  size_t dy, dx;
+  size_t nnz;
+  size_t *row_ptr;
+  size_t *col;
+  double *val;
+} mtx_sparse_t;
+
+// Inicializa _S com dy linhas e dx colunas a partir de nnz elementos em
+// coordenadas (rows[k], cols[k], vals[k]), em qualquer ordem. Elementos na
+// mesma posição são mantidos separados.
+//
+// Retorna 1 caso alguma coordenada esteja fora da matriz (_S não é
+// inicializada) e 0 em caso de sucesso.
+int mtx_sparse_init_coo(mtx_sparse_t *_S, size_t dy, size_t dx, size_t nnz,
+                         const size_t *rows, const size_t *cols,
+                         const double *vals);
+
+// Libera os arrays de __S.
+void mtx_sparse_free(mtx_sparse_t *__S);
+
+// Copia S para a matriz densa M, que é inicializada caso não esteja, com os
+// demais elementos iguais a 0. Elementos na mesma posição são somados.
+void mtx_sparse_to_dense(mtx_matrix_t *M, const mtx_sparse_t *S);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
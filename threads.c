@@ -0,0 +1,250 @@
+#include "threads.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <unistd.h>
+
+// Each thread owns a deque of chunk indexes [lo, hi), packed in a single
+// 64-bit word (lo in the low half, hi in the high half) so the owner and the
+// thieves can update it with one compare-and-swap. The owner takes chunks from
+// the front and the thieves steal half of the remaining chunks from the back.
+typedef struct mtx_deque {
+  _Atomic uint64_t range;
+  char pad[64 - sizeof(uint64_t)]; // One deque per cache line.
+} mtx_deque_t;
+
+#define RANGE(lo, hi) (((uint64_t)(hi) << 32) | (uint32_t)(lo))
+#define RANGE_LO(r) ((uint32_t)(r))
+#define RANGE_HI(r) ((uint32_t)((r) >> 32))
+
+static struct mtx_pool {
+  // Held while a parallel job runs, other callers run their work serially.
+  pthread_mutex_t busy;
+
+  // Protects generation, active and shutdown.
+  pthread_mutex_t lock;
+  pthread_cond_t wake, done;
+
+  int num_threads;
+  int num_workers;
+  pthread_t workers[MTX_THREADS_MAX];
+  // Generation seen by each worker when it was created.
+  unsigned long start_generation[MTX_THREADS_MAX];
+
+  unsigned long generation;
+  int active;
+  int shutdown;
+
+  // Current job.
+  mtx_parallel_task_t task;
+  void *arg;
+  size_t begin, end, grain;
+  mtx_deque_t deques[MTX_THREADS_MAX];
+} __mtx_pool = {
+    .busy = PTHREAD_MUTEX_INITIALIZER,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+static _Thread_local int __mtx_thread_id = 0;
+static _Thread_local int __mtx_in_task = 0;
+
+int mtx_thread_id() { return __mtx_thread_id; }
+
+static int __mtx_deque_pop(mtx_deque_t *d, uint32_t *chunk) {
+  uint64_t r = atomic_load(&d->range);
+  while (RANGE_LO(r) < RANGE_HI(r)) {
+    if (atomic_compare_exchange_weak(&d->range, &r,
+                                     RANGE(RANGE_LO(r) + 1, RANGE_HI(r)))) {
+      *chunk = RANGE_LO(r);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Steals half of the chunks of some other deque into the (empty) deque of
+// thread id. Returns 0 if every deque was found empty.
+static int __mtx_deque_steal(int id) {
+  struct mtx_pool *pool = &__mtx_pool;
+  for (int k = 1; k < pool->num_threads; ++k) {
+    mtx_deque_t *victim = &pool->deques[(id + k) % pool->num_threads];
+    uint64_t r = atomic_load(&victim->range);
+    while (RANGE_LO(r) < RANGE_HI(r)) {
+      uint32_t lo = RANGE_LO(r), hi = RANGE_HI(r);
+      uint32_t stolen = (hi - lo + 1) / 2;
+      if (atomic_compare_exchange_weak(&victim->range, &r,
+                                       RANGE(lo, hi - stolen))) {
+        atomic_store(&pool->deques[id].range, RANGE(hi - stolen, hi));
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+static void __mtx_run_job(int id) {
+  struct mtx_pool *pool = &__mtx_pool;
+  uint32_t chunk;
+
+  __mtx_in_task = 1;
+  do {
+    while (__mtx_deque_pop(&pool->deques[id], &chunk)) {
+      size_t b = pool->begin + chunk * pool->grain;
+      size_t e = pool->end - b > pool->grain ? b + pool->grain : pool->end;
+      pool->task(pool->arg, b, e);
+    }
+  } while (__mtx_deque_steal(id));
+  __mtx_in_task = 0;
+}
+
+static void *__mtx_worker(void *p) {
+  struct mtx_pool *pool = &__mtx_pool;
+  __mtx_thread_id = (int)(intptr_t)p;
+  unsigned long seen = pool->start_generation[__mtx_thread_id];
+
+  pthread_mutex_lock(&pool->lock);
+  for (;;) {
+    while (!pool->shutdown && pool->generation == seen) {
+      pthread_cond_wait(&pool->wake, &pool->lock);
+    }
+    if (pool->shutdown) {
+      break;
+    }
+    seen = pool->generation;
+    pthread_mutex_unlock(&pool->lock);
+
+    __mtx_run_job(__mtx_thread_id);
+
+    pthread_mutex_lock(&pool->lock);
+    if (--pool->active == 0) {
+      pthread_cond_signal(&pool->done);
+    }
+  }
+  pthread_mutex_unlock(&pool->lock);
+
+  return NULL;
+}
+
+static int __mtx_online_cpus() {
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  if (n < 1) {
+    return 1;
+  }
+  return n > MTX_THREADS_MAX ? MTX_THREADS_MAX : (int)n;
+}
+
+// Must be called with the busy lock held.
+static void __mtx_pool_stop() {
+  struct mtx_pool *pool = &__mtx_pool;
+
+  pthread_mutex_lock(&pool->lock);
+  pool->shutdown = 1;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (int i = 0; i < pool->num_workers; ++i) {
+    pthread_join(pool->workers[i], NULL);
+  }
+  pool->num_workers = 0;
+  pool->shutdown = 0;
+}
+
+// Must be called with the busy lock held.
+static void __mtx_pool_start() {
+  struct mtx_pool *pool = &__mtx_pool;
+
+  if (pool->num_threads == 0) {
+    pool->num_threads = __mtx_online_cpus();
+  }
+  while (pool->num_workers < pool->num_threads - 1) {
+    pool->start_generation[pool->num_workers + 1] = pool->generation;
+    if (pthread_create(&pool->workers[pool->num_workers], NULL, __mtx_worker,
+                       (void *)(intptr_t)(pool->num_workers + 1)) != 0) {
+      // Runs with the threads already created.
+      pool->num_threads = pool->num_workers + 1;
+      break;
+    }
+    ++pool->num_workers;
+  }
+}
+
+void mtx_cfg_set_num_threads(int n) {
+  if (n <= 0) {
+    n = __mtx_online_cpus();
+  } else if (n > MTX_THREADS_MAX) {
+    n = MTX_THREADS_MAX;
+  }
+
+  pthread_mutex_lock(&__mtx_pool.busy);
+  if (n != __mtx_pool.num_threads) {
+    __mtx_pool_stop();
+    __mtx_pool.num_threads = n;
+  }
+  pthread_mutex_unlock(&__mtx_pool.busy);
+}
+
+int mtx_cfg_get_num_threads() {
+  int n = __mtx_pool.num_threads;
+  return n == 0 ? __mtx_online_cpus() : n;
+}
+
+void mtx_parallel_for(size_t begin, size_t end, size_t grain,
+                      mtx_parallel_task_t task, void *arg) {
+  struct mtx_pool *pool = &__mtx_pool;
+
+  if (begin >= end) {
+    return;
+  }
+  if (grain == 0) {
+    grain = 1;
+  }
+  size_t chunks = (end - begin + grain - 1) / grain;
+  if (chunks > UINT32_MAX) {
+    grain = (end - begin + UINT32_MAX - 1) / UINT32_MAX;
+    chunks = (end - begin + grain - 1) / grain;
+  }
+
+  if (chunks == 1 || __mtx_in_task || mtx_cfg_get_num_threads() == 1 ||
+      pthread_mutex_trylock(&pool->busy) != 0) {
+    task(arg, begin, end);
+    return;
+  }
+
+  __mtx_pool_start();
+  int n = pool->num_threads;
+
+  pool->task = task;
+  pool->arg = arg;
+  pool->begin = begin;
+  pool->end = end;
+  pool->grain = grain;
+  for (int i = 0; i < n; ++i) {
+    uint32_t lo = chunks * i / n, hi = chunks * (i + 1) / n;
+    atomic_store(&pool->deques[i].range, RANGE(lo, hi));
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  pool->active = pool->num_workers;
+  ++pool->generation;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+
+  int caller_id = __mtx_thread_id;
+  __mtx_thread_id = 0;
+  __mtx_run_job(0);
+  __mtx_thread_id = caller_id;
+
+  pthread_mutex_lock(&pool->lock);
+  while (pool->active > 0) {
+    pthread_cond_wait(&pool->done, &pool->lock);
+  }
+  pthread_mutex_unlock(&pool->lock);
+
+  pthread_mutex_unlock(&pool->busy);
+}
+
+#undef RANGE
+#undef RANGE_LO
+#undef RANGE_HI
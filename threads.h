@@ -0,0 +1,52 @@
+#ifndef MTX_THREADS_H
+#define MTX_THREADS_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Número máximo de threads do pool (incluindo a thread que o usa).
+#define MTX_THREADS_MAX 256
+
+// Operações sobre menos elementos que isso são executadas em uma única thread.
+#define MTX_PARALLEL_MIN_ELEMENTS (1 << 15)
+
+// Número mínimo de elementos processados por cada bloco de um parallel-for.
+#define MTX_PARALLEL_GRAIN_ELEMENTS (1 << 12)
+
+// Número de linhas de dx elementos por bloco de um parallel-for sobre linhas.
+#define MTX_PARALLEL_ROWS_GRAIN(dx) (MTX_PARALLEL_GRAIN_ELEMENTS / (dx) + 1)
+
+// Tarefa executada sobre o intervalo [begin, end).
+typedef void (*mtx_parallel_task_t)(void *arg, size_t begin, size_t end);
+
+// Seta o número de threads usadas pelas operações pesadas, contando com a
+// thread que as chama. Caso n <= 0, usa o número de processadores online (o
+// padrão). Com n = 1 tudo é executado na thread que chama.
+void mtx_cfg_set_num_threads(int n);
+
+// Retorna o número de threads em uso.
+int mtx_cfg_get_num_threads();
+
+// Executa task sobre o intervalo [begin, end), dividido em blocos de até grain
+// elementos. Os blocos são distribuídos entre as threads do pool e as threads
+// que terminarem seus blocos roubam os blocos pendentes das outras
+// (work-stealing). Retorna somente quando todos os blocos forem executados.
+//
+// Chamadas aninhadas (de dentro de uma tarefa) ou feitas enquanto o pool está
+// ocupado executam o intervalo inteiro na thread que chama.
+void mtx_parallel_for(size_t begin, size_t end, size_t grain,
+                      mtx_parallel_task_t task, void *arg);
+
+// Retorna o índice da thread que executa a tarefa atual: 0 para a thread que
+// chamou mtx_parallel_for() e de 1 até mtx_cfg_get_num_threads() - 1 para as
+// threads do pool.
+int mtx_thread_id();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,11 +1,19 @@
 #include <CppUTest/TestHarness_c.h>
 #include <CppUTestExt/MockSupport_c.h>
 
+#include "../backend.h"
+#include "../blas1.h"
+#include "../cblas.h"
 #include "../linalg.h"
 #include "../matrix.h"
 #include "../matrix_operations.h"
+#include "../simd.h"
+#include "../threads.h"
+#include "../workspace.h"
 #include "routines.h"
 #include "test_utils.h"
+#include <math.h>
+#include <string.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -23,6 +31,671 @@ MAKE_TEST(linalg, permutate) {
   CALL_ROUTINE(check_3m_i, mtx_linalg_permutate, 0, 3);
 }
 
+MAKE_TEST(linalg, workspace) {
+  int n = 64;
+  mtx_matrix_t A, B, Y, P = {0}, LU = {0}, X = {0}, W = {0};
+  mtx_matrix_init(&A, n, n);
+  mtx_matrix_init(&B, n, 1);
+  mtx_matrix_init(&Y, n, 1);
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) {
+      mtx_matrix_at(&A, i, j) = (double)rand() / RAND_MAX - 0.5 + (i == j) * n;
+    }
+    mtx_matrix_at(&B, i, 0) = i;
+  }
+
+  mtx_workspace_t ws;
+  mtx_workspace_init(&ws, 0);
+  mtx_workspace_t *previous = mtx_workspace_attach(&ws);
+
+  double det = 0;
+  for (int it = 0; it < 3; ++it) {
+    if (it == 2) {
+      // The workspace already holds every temporary of an iteration.
+      mock_c()->enable();
+      mock_c()->expectNoCall("malloc_mock");
+      mock_c()->expectNoCall("posix_memalign_mock");
+      mock_c()->expectNoCall("free_mock");
+      mock_c()->ignoreOtherCalls();
+    }
+
+    CHECK_C(mtx_linalg_LU_decomposition(&P, &LU, &A, 1) >= 0);
+    CHECK_C(mtx_linalg_LU_solve(&X, &P, &LU, &B) == 0);
+    mtx_linalg_LU_refine(&W, &X, &P, &LU, &A, &B);
+    mtx_matrix_mul(&W, &A, &X);
+    CHECK_C(mtx_matrix_distance(&W, &B) < MAXIMUM_ERROR);
+    // Overlapping output, computed on a scratch matrix.
+    mtx_matrix_copy(&Y, &X);
+    mtx_matrix_mul(&Y, &A, &Y);
+    CHECK_C(mtx_matrix_distance(&Y, &B) < MAXIMUM_ERROR);
+
+    double d = mtx_matrix_det(&A);
+    CHECK_C(it == 0 || d == det);
+    det = d;
+  }
+  mock_c()->checkExpectations();
+  mock_c()->disable();
+
+  CHECK_C(ws.used == 0 && ws.blocks == NULL && ws.size >= ws.peak);
+  CHECK_C(mtx_workspace_attach(previous) == &ws);
+  mtx_workspace_free(&ws);
+
+  mtx_matrix_free(&A);
+  mtx_matrix_free(&B);
+  mtx_matrix_free(&Y);
+  mtx_matrix_free(&P);
+  mtx_matrix_free(&LU);
+  mtx_matrix_free(&X);
+  mtx_matrix_free(&W);
+}
+
+MAKE_TEST(linalg, blas1) {
+  // Lengths crossing the unrolled loops and the tails, with the vectorized
+  // (unit) and the element by element strides.
+  int lengths[] = {0, 1, 7, 33, 257};
+  ptrdiff_t incs[][2] = {{1, 1}, {3, -2}, {-1, 1}};
+  double x[3 * 257], y[3 * 257], y0[3 * 257];
+  for (int i = 0; i < 3 * 257; ++i) {
+    x[i] = (double)rand() / RAND_MAX - 0.5;
+    y0[i] = (double)rand() / RAND_MAX - 0.5;
+  }
+  x[2 * 257] = 4; // The largest |x[i]| shows up twice.
+  x[2 * 257 + 3] = -4;
+
+  for (mtx_simd_t simd = MTX_SIMD_SCALAR; simd <= mtx_cpu_simd_support();
+       ++simd) {
+    mtx_cfg_set_simd(simd);
+    for (int l = 0; l < sizeof(lengths) / sizeof(lengths[0]); ++l) {
+      for (int c = 0; c < sizeof(incs) / sizeof(incs[0]); ++c) {
+        size_t n = lengths[l];
+        ptrdiff_t incx = incs[c][0], incy = incs[c][1];
+        // First elements such that x[i * inc] stays in the arrays.
+        const double *xp = incx < 0 ? &x[n > 0 ? (n - 1) * -incx : 0] : x;
+        double *yp = incy < 0 ? &y[n > 0 ? (n - 1) * -incy : 0] : y;
+        const double *yp0 = &y0[yp - y];
+
+        double dot = 0, asum = 0, nrm2 = 0, max = 0;
+        size_t iamax = 0;
+        for (size_t i = 0; i < n; ++i) {
+          double xi = xp[(ptrdiff_t)i * incx];
+          dot += xi * yp0[(ptrdiff_t)i * incy];
+          asum += _mod(xi);
+          nrm2 += xi * xi;
+          if (_mod(xi) > max) {
+            max = _mod(xi);
+            iamax = i;
+          }
+        }
+        nrm2 = sqrt(nrm2);
+
+        memcpy(y, y0, sizeof(y));
+        int ok = _mod(_mtx_dot(n, xp, incx, yp0, incy) - dot) < 1e-12 &&
+                 _mod(_mtx_asum(n, xp, incx) - asum) < 1e-12 &&
+                 _mod(_mtx_nrm2(n, xp, incx) - nrm2) < 1e-12 &&
+                 _mtx_iamax(n, xp, incx) == iamax;
+
+        _mtx_axpy(n, -2, xp, incx, yp, incy);
+        for (size_t i = 0; i < n; ++i) {
+          ptrdiff_t iy = (ptrdiff_t)i * incy;
+          ok = ok && _mod(yp[iy] - (yp0[iy] - 2 * xp[(ptrdiff_t)i * incx])) <
+                         1e-12;
+        }
+        _mtx_scal(n, 3, yp, incy);
+        for (size_t i = 0; i < n; ++i) {
+          ptrdiff_t iy = (ptrdiff_t)i * incy;
+          ok = ok &&
+               _mod(yp[iy] - 3 * (yp0[iy] - 2 * xp[(ptrdiff_t)i * incx])) <
+                   1e-12;
+        }
+
+        if (!ok) {
+          mtx_cfg_set_simd(MTX_SIMD_AUTO);
+          throw_error("BLAS-1 routines missed with n = %d and strides %d, %d "
+                      "(instruction set %d).",
+                      (int)n, (int)incx, (int)incy, simd);
+        }
+      }
+    }
+  }
+  mtx_cfg_set_simd(MTX_SIMD_AUTO);
+
+  // The squares of these overflow and underflow.
+  double big[] = {3e200, -4e200}, small[] = {3e-200, 4e-200};
+  CHECK_C(_mod(_mtx_nrm2(2, big, 1) / 5e200 - 1) < 1e-15);
+  CHECK_C(_mod(_mtx_nrm2(2, small, 1) / 5e-200 - 1) < 1e-15);
+}
+
+MAKE_TEST(linalg, subs_columns) {
+  // The single-column substitutions (dot products) against the
+  // multiple-column ones (axpy on whole rows).
+  int n = 90;
+  mtx_matrix_t A, B, P = {0}, LU = {0}, X = {0}, x = {0};
+  mtx_matrix_init(&A, n, n);
+  mtx_matrix_init(&B, n, 3);
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) {
+      mtx_matrix_at(&A, i, j) = (double)rand() / RAND_MAX - 0.5 + (i == j) * 4;
+    }
+    for (int j = 0; j < 3; ++j) {
+      mtx_matrix_at(&B, i, j) = (double)rand() / RAND_MAX - 0.5;
+    }
+  }
+
+  CHECK_C(mtx_linalg_LU_decomposition(&P, &LU, &A, 1) >= 0);
+  CHECK_C(mtx_linalg_LU_solve(&X, &P, &LU, &B) == 0);
+  for (int j = 0; j < 3; ++j) {
+    mtx_matrix_view_t b = mtx_matrix_view_of(&B, 0, j, n, 1);
+    mtx_matrix_view_t x_j = mtx_matrix_view_of(&X, 0, j, n, 1);
+    CHECK_C(mtx_linalg_LU_solve(&x, &P, &LU, &b.matrix) == 0);
+    CHECK_C(mtx_matrix_distance(&x, &x_j.matrix) < 1e-10);
+  }
+
+  mtx_matrix_t R = {0};
+  mtx_matrix_mul(&R, &A, &X);
+  CHECK_C(mtx_matrix_distance(&R, &B) < 1e-10);
+
+  mtx_matrix_free(&A);
+  mtx_matrix_free(&B);
+  mtx_matrix_free(&P);
+  mtx_matrix_free(&LU);
+  mtx_matrix_free(&X);
+  mtx_matrix_free(&x);
+  mtx_matrix_free(&R);
+}
+
+// Element (i, j) of a matrix stored in the given CBLAS order.
+#define EL(order, a, ld, i, j)                                                 \
+  ((order) == CblasRowMajor ? (a)[(i) * (ld) + (j)] : (a)[(i) + (j) * (ld)])
+#define OP_EL(order, trans, a, ld, i, j)                                       \
+  ((trans) ? EL(order, a, ld, j, i) : EL(order, a, ld, i, j))
+
+static double *random_array(int n) {
+  double *a = (double *)malloc(sizeof(double) * n);
+  for (int i = 0; i < n; ++i) {
+    a[i] = (double)rand() / RAND_MAX - 0.5;
+  }
+  return a;
+}
+
+MAKE_TEST(linalg, cblas_level1) {
+  double *x = random_array(40), *y = random_array(40), *y0 = random_array(40);
+  memcpy(y0, y, sizeof(double) * 40);
+
+  // With incX = -2, the vector starts at the end: x[18], x[16], ..., x[0].
+  double dot = 0;
+  for (int i = 0; i < 10; ++i) {
+    dot += x[18 - 2 * i] * y[3 * i];
+  }
+  CHECK_C(_mod(cblas_ddot(10, x, -2, y, 3) - dot) < 1e-12);
+
+  cblas_daxpy(10, 2, x, -2, y, 3);
+  for (int i = 0; i < 40; ++i) {
+    double expected = i % 3 == 0 && i < 30 ? y0[i] + 2 * x[18 - 2 * (i / 3)]
+                                           : y0[i];
+    CHECK_C(_mod(y[i] - expected) < 1e-12);
+  }
+
+  cblas_dscal(20, -3, y, 2);
+  cblas_dscal(20, 5, y, -1); // Nothing with incX <= 0.
+  for (int i = 0; i < 40; i += 2) {
+    double expected = i % 3 == 0 && i < 30 ? y0[i] + 2 * x[18 - 2 * (i / 3)]
+                                           : y0[i];
+    CHECK_C(_mod(y[i] + 3 * expected) < 1e-12);
+  }
+
+  x[13] = 9;
+  x[15] = -9;
+  CHECK_C(cblas_idamax(20, x, 1) == 13);
+  CHECK_C(cblas_idamax(10, x + 1, 2) == 6);
+  double asum = 0, nrm2 = 0;
+  for (int i = 0; i < 40; ++i) {
+    asum += _mod(x[i]);
+    nrm2 += x[i] * x[i];
+  }
+  CHECK_C(_mod(cblas_dasum(40, x, 1) - asum) < 1e-12);
+  CHECK_C(_mod(cblas_dnrm2(40, x, 1) - sqrt(nrm2)) < 1e-12);
+
+  free(x);
+  free(y);
+  free(y0);
+}
+
+MAKE_TEST(linalg, cblas_level2) {
+  enum CBLAS_ORDER orders[] = {CblasRowMajor, CblasColMajor};
+  const int M = 37, N = 23, ld = 40;
+  double *A = random_array(ld * ld), *x = random_array(2 * ld),
+         *y = random_array(ld), *y0 = random_array(ld);
+
+  for (int o = 0; o < 2; ++o) {
+    enum CBLAS_ORDER order = orders[o];
+    for (int trans = 0; trans < 2; ++trans) {
+      int rows = trans ? N : M, cols = trans ? M : N;
+      for (int b = 0; b < 2; ++b) {
+        double beta = b ? 0.5 : 0;
+        memcpy(y, y0, sizeof(double) * ld);
+        if (beta == 0) {
+          y[0] = NAN; // Not read.
+        }
+        // x with stride 2 and y backwards.
+        cblas_dgemv(order, trans ? CblasTrans : CblasNoTrans, M, N, 1.5, A,
+                    ld, x, 2, beta, y, -1);
+        for (int i = 0; i < rows; ++i) {
+          double sum = 0;
+          for (int j = 0; j < cols; ++j) {
+            sum += OP_EL(order, trans, A, ld, i, j) * x[2 * j];
+          }
+          double expected = 1.5 * sum + beta * y0[rows - 1 - i];
+          CHECK_C(_mod(y[rows - 1 - i] - expected) < 1e-12);
+        }
+      }
+    }
+
+    // A + 2 x y^T on a copy.
+    double *G = (double *)malloc(sizeof(double) * ld * ld);
+    memcpy(G, A, sizeof(double) * ld * ld);
+    cblas_dger(order, M, N, 2, x, 1, y0, -1, G, ld);
+    for (int i = 0; i < M; ++i) {
+      for (int j = 0; j < N; ++j) {
+        double expected = EL(order, A, ld, i, j) + 2 * x[i] * y0[N - 1 - j];
+        CHECK_C(_mod(EL(order, G, ld, i, j) - expected) < 1e-12);
+      }
+    }
+    free(G);
+  }
+
+  // Triangular solves, A well conditioned by its diagonal.
+  for (int i = 0; i < ld; ++i) {
+    A[i * ld + i] += 4;
+  }
+  for (int c = 0; c < 16; ++c) {
+    enum CBLAS_ORDER order = orders[c & 1];
+    int upper = (c >> 1) & 1, trans = (c >> 2) & 1, unit = (c >> 3) & 1;
+    memcpy(y, y0, sizeof(double) * ld);
+    cblas_dtrsv(order, upper ? CblasUpper : CblasLower,
+                trans ? CblasTrans : CblasNoTrans,
+                unit ? CblasUnit : CblasNonUnit, N, A, ld, y, -1);
+
+    // op(A) x = b, with the triangle of A given by upper.
+    for (int i = 0; i < N; ++i) {
+      double sum = 0;
+      for (int j = 0; j < N; ++j) {
+        int r = trans ? j : i, s = trans ? i : j;
+        if ((upper && r > s) || (!upper && r < s)) {
+          continue;
+        }
+        double a = r == s && unit ? 1 : EL(order, A, ld, r, s);
+        sum += a * y[N - 1 - j];
+      }
+      if (!(_mod(sum - y0[N - 1 - i]) < 1e-10)) {
+        throw_error("cblas_dtrsv() missed with order %d, upper %d, trans %d "
+                    "and unit %d.",
+                    order, upper, trans, unit);
+      }
+    }
+  }
+
+  free(A);
+  free(x);
+  free(y);
+  free(y0);
+}
+
+MAKE_TEST(linalg, cblas_level3) {
+  enum CBLAS_ORDER orders[] = {CblasRowMajor, CblasColMajor};
+  // Larger than the blocks of rows of dtrsm.
+  const int M = 150, N = 70, K = 29, ld = 160;
+  double *A = random_array(ld * ld), *B = random_array(ld * ld),
+         *C = random_array(ld * ld), *C0 = random_array(ld * ld);
+  memcpy(C0, C, sizeof(double) * ld * ld);
+
+  for (int c = 0; c < 8; ++c) {
+    enum CBLAS_ORDER order = orders[c & 1];
+    int trans_a = (c >> 1) & 1, trans_b = (c >> 2) & 1;
+    memcpy(C, C0, sizeof(double) * ld * ld);
+    cblas_dgemm(order, trans_a ? CblasTrans : CblasNoTrans,
+                trans_b ? CblasTrans : CblasNoTrans, M, N, K, -0.5, A, ld, B,
+                ld, 2, C, ld);
+    for (int i = 0; i < M; ++i) {
+      for (int j = 0; j < N; ++j) {
+        double sum = 0;
+        for (int p = 0; p < K; ++p) {
+          sum += OP_EL(order, trans_a, A, ld, i, p) *
+                 OP_EL(order, trans_b, B, ld, p, j);
+        }
+        double expected = -0.5 * sum + 2 * EL(order, C0, ld, i, j);
+        CHECK_C(_mod(EL(order, C, ld, i, j) - expected) < 1e-10);
+      }
+    }
+  }
+
+  for (int i = 0; i < ld; ++i) {
+    A[i * ld + i] += 8;
+  }
+  for (int c = 0; c < 32; ++c) {
+    enum CBLAS_ORDER order = orders[c & 1];
+    int right = (c >> 1) & 1, upper = (c >> 2) & 1, trans = (c >> 3) & 1,
+        unit = (c >> 4) & 1;
+    int n = right ? N : M;
+    memcpy(C, C0, sizeof(double) * ld * ld);
+    cblas_dtrsm(order, right ? CblasRight : CblasLeft,
+                upper ? CblasUpper : CblasLower,
+                trans ? CblasTrans : CblasNoTrans,
+                unit ? CblasUnit : CblasNonUnit, M, N, 2, A, ld, C, ld);
+
+    // op(A) X = 2 B or X op(A) = 2 B, with the triangle of A given by upper.
+    double dt = 0;
+    for (int i = 0; i < M; ++i) {
+      for (int j = 0; j < N; ++j) {
+        double sum = 0;
+        for (int p = 0; p < n; ++p) {
+          int ai = right ? p : i, aj = right ? j : p;
+          int r = trans ? aj : ai, s = trans ? ai : aj;
+          if ((upper && r > s) || (!upper && r < s)) {
+            continue;
+          }
+          double a = r == s && unit ? 1 : EL(order, A, ld, r, s);
+          sum += a * (right ? EL(order, C, ld, i, p) : EL(order, C, ld, p, j));
+        }
+        dt += _mod(sum - 2 * EL(order, C0, ld, i, j));
+      }
+    }
+    if (!(dt < 1e-8)) {
+      throw_error("cblas_dtrsm() missed with order %d, right %d, upper %d, "
+                  "trans %d and unit %d.",
+                  order, right, upper, trans, unit);
+    }
+  }
+
+  free(A);
+  free(B);
+  free(C);
+  free(C0);
+}
+
+#undef EL
+#undef OP_EL
+
+MAKE_TEST(linalg, lu_threads) {
+  mtx_matrix_t A;
+  mtx_matrix_init(&A, 300, 300);
+  for (int i = 0; i < A.dy; ++i) {
+    for (int j = 0; j < A.dx; ++j) {
+      mtx_matrix_at(&A, i, j) = (double)rand() / RAND_MAX - 0.5;
+    }
+  }
+
+  int num_threads = mtx_cfg_get_num_threads();
+
+  mtx_matrix_t P = {0}, LU = {0};
+  mtx_cfg_set_num_threads(1);
+  int ret = mtx_linalg_LU_decomposition(&P, &LU, &A, 1);
+
+  mtx_matrix_t P_t = {0}, LU_t = {0};
+  mtx_cfg_set_num_threads(4);
+  int ret_t = mtx_linalg_LU_decomposition(&P_t, &LU_t, &A, 1);
+
+  mtx_cfg_set_num_threads(num_threads);
+
+  CHECK_C(ret >= 0 && ret == ret_t);
+  CHECK_C_TEXT(mtx_matrix_distance(&P, &P_t) == 0 &&
+                   mtx_matrix_distance(&LU, &LU_t) < MAXIMUM_ERROR,
+               "multithreaded LU decomposition doesn't agree with the serial "
+               "one.");
+
+  mtx_matrix_free(&A);
+  mtx_matrix_free(&P);
+  mtx_matrix_free(&LU);
+  mtx_matrix_free(&P_t);
+  mtx_matrix_free(&LU_t);
+}
+
+// A backend running on the lib itself (with the backend unset, so the
+// routines don't come back to it), counting the calls routed to it.
+static const mtx_blas_backend_t *test_backend;
+static int test_backend_calls[3];
+
+static void test_dgemm(const enum CBLAS_ORDER Order,
+                       const enum CBLAS_TRANSPOSE TransA,
+                       const enum CBLAS_TRANSPOSE TransB, const int M,
+                       const int N, const int K, const double alpha,
+                       const double *A, const int lda, const double *B,
+                       const int ldb, const double beta, double *C,
+                       const int ldc) {
+  ++test_backend_calls[0];
+  mtx_cfg_set_blas_backend(NULL);
+  cblas_dgemm(Order, TransA, TransB, M, N, K, alpha, A, lda, B, ldb, beta, C,
+              ldc);
+  mtx_cfg_set_blas_backend(test_backend);
+}
+
+static void test_dtrsm(const enum CBLAS_ORDER Order,
+                       const enum CBLAS_SIDE Side, const enum CBLAS_UPLO Uplo,
+                       const enum CBLAS_TRANSPOSE TransA,
+                       const enum CBLAS_DIAG Diag, const int M, const int N,
+                       const double alpha, const double *A, const int lda,
+                       double *B, const int ldb) {
+  ++test_backend_calls[1];
+  mtx_cfg_set_blas_backend(NULL);
+  cblas_dtrsm(Order, Side, Uplo, TransA, Diag, M, N, alpha, A, lda, B, ldb);
+  mtx_cfg_set_blas_backend(test_backend);
+}
+
+// Unblocked column-major LU with partial pivoting, as LAPACK's dgetrf_.
+static void test_dgetrf(const int *m, const int *n, double *a, const int *lda,
+                        int *ipiv, int *info) {
+  ++test_backend_calls[2];
+  int ld = *lda;
+  *info = 0;
+  for (int j = 0; j < *m && j < *n; ++j) {
+    int p = j;
+    for (int i = j + 1; i < *m; ++i) {
+      if (fabs(a[i + j * ld]) > fabs(a[p + j * ld])) {
+        p = i;
+      }
+    }
+    ipiv[j] = p + 1;
+    if (a[p + j * ld] == 0) {
+      *info = *info ? *info : j + 1;
+      continue;
+    }
+    for (int k = 0; k < *n; ++k) {
+      double tmp = a[j + k * ld];
+      a[j + k * ld] = a[p + k * ld];
+      a[p + k * ld] = tmp;
+    }
+    for (int i = j + 1; i < *m; ++i) {
+      a[i + j * ld] /= a[j + j * ld];
+    }
+    for (int k = j + 1; k < *n; ++k) {
+      for (int i = j + 1; i < *m; ++i) {
+        a[i + k * ld] -= a[i + j * ld] * a[j + k * ld];
+      }
+    }
+  }
+}
+
+MAKE_TEST(linalg, blas_backend) {
+  mtx_blas_backend_t missing;
+  CHECK_C(mtx_blas_backend_open(&missing, "libmtx-missing-blas.so") == -1);
+  CHECK_C(missing.dgemm == NULL && missing.handle == NULL);
+  CHECK_C(mtx_cfg_get_blas_backend() == NULL);
+
+  int n = 120;
+  mtx_matrix_t A, B;
+  mtx_matrix_init(&A, n, n);
+  mtx_matrix_init(&B, n, 3);
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) {
+      mtx_matrix_at(&A, i, j) = (double)rand() / RAND_MAX - 0.5;
+    }
+    for (int j = 0; j < 3; ++j) {
+      mtx_matrix_at(&B, i, j) = (double)rand() / RAND_MAX - 0.5;
+    }
+  }
+  mtx_matrix_view_t At = mtx_matrix_transposed_of(&A);
+  mtx_matrix_view_t A_rev = mtx_matrix_strided_of(&A, n - 1, 0, n, n, -1, 1);
+
+  // Results of the lib's own kernels, then of the backend.
+  mtx_matrix_t P[2] = {0}, LU[2] = {0}, X[2] = {0}, C[2] = {0}, D[2] = {0},
+               E[2] = {0};
+  int signum[2];
+  mtx_blas_backend_t backend = {.name = "test",
+                                .dgemm = test_dgemm,
+                                .dtrsm = test_dtrsm,
+                                .dgetrf = test_dgetrf};
+  for (int b = 0; b < 2; ++b) {
+    test_backend = b ? &backend : NULL;
+    mtx_cfg_set_blas_backend(test_backend);
+    signum[b] = mtx_linalg_LU_decomposition(&P[b], &LU[b], &A, 1);
+    CHECK_C(signum[b] >= 0);
+    CHECK_C(mtx_linalg_LU_solve(&X[b], &P[b], &LU[b], &B) == 0);
+    mtx_matrix_mul(&C[b], &At.matrix, &A);
+    mtx_matrix_mul(&D[b], &A, &At.matrix);
+    mtx_matrix_mul(&E[b], &A_rev.matrix, &A);
+  }
+  mtx_cfg_set_blas_backend(NULL);
+
+  // One dgetrf, the forward and back substitutions and the products with
+  // (transposed) row-major operands; A_rev stays on the lib's kernels.
+  CHECK_C(test_backend_calls[0] == 2 && test_backend_calls[1] == 2 &&
+          test_backend_calls[2] == 1);
+  CHECK_C_TEXT(signum[0] == signum[1] &&
+                   mtx_matrix_distance(&P[0], &P[1]) == 0,
+               "the backend's LU permutation differs from the lib's one.");
+  CHECK_C(mtx_matrix_distance(&LU[0], &LU[1]) < 1e-10);
+  CHECK_C(mtx_matrix_distance(&X[0], &X[1]) < 1e-8);
+  CHECK_C(mtx_matrix_distance(&C[0], &C[1]) < 1e-10);
+  CHECK_C(mtx_matrix_distance(&D[0], &D[1]) < 1e-10);
+  CHECK_C(mtx_matrix_distance(&E[0], &E[1]) < 1e-10);
+
+  // A singular matrix fails on the backend too.
+  mtx_matrix_t S = {0}, S_LU = {0};
+  mtx_matrix_clone(&S, &A);
+  memcpy(mtx_matrix_row(&S, 7), mtx_matrix_row(&S, 3), sizeof(double) * n);
+  mtx_cfg_set_blas_backend(&backend);
+  CHECK_C(mtx_linalg_LU_decomposition(NULL, &S_LU, &S, 1) < 0);
+  mtx_cfg_set_blas_backend(NULL);
+  CHECK_C(test_backend_calls[2] == 2);
+
+  for (int b = 0; b < 2; ++b) {
+    mtx_matrix_free(&P[b]);
+    mtx_matrix_free(&LU[b]);
+    mtx_matrix_free(&X[b]);
+    mtx_matrix_free(&C[b]);
+    mtx_matrix_free(&D[b]);
+    mtx_matrix_free(&E[b]);
+  }
+  mtx_matrix_free(&A);
+  mtx_matrix_free(&B);
+  mtx_matrix_free(&S);
+  mtx_matrix_free(&S_LU);
+}
+
+MAKE_TEST(linalg, lu_blocked) {
+  // Several panels of the blocked decomposition, the last one partial.
+  int n = 2 * MTX_LU_NB + 37;
+  mtx_matrix_t A;
+  mtx_matrix_init(&A, n, n);
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) {
+      mtx_matrix_at(&A, i, j) = (double)rand() / RAND_MAX - 0.5;
+    }
+  }
+
+  mtx_matrix_t P = {0}, LU = {0}, L = {0}, U = {0}, R = {0}, PA = {0};
+  int signum = mtx_linalg_LU_decomposition(&P, &LU, &A, 1);
+  CHECK_C(signum >= 0);
+
+  mtx_matrix_get_lower(&L, &LU);
+  for (int i = 0; i < n; ++i) {
+    mtx_matrix_at(&L, i, i) = 1;
+  }
+  mtx_matrix_get_upper(&U, &LU);
+  mtx_matrix_mul(&R, &L, &U);
+  mtx_linalg_permutate(&PA, &A, &P);
+  CHECK_C(mtx_matrix_distance(&R, &PA) < 1e-10);
+
+  // signum is the parity of the permutation: n minus its number of cycles.
+  int *perm = (int *)malloc(sizeof(int) * n), cycles = 0;
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) {
+      if (mtx_matrix_at(&P, i, j) == 1) {
+        perm[i] = j;
+      }
+    }
+  }
+  for (int i = 0; i < n; ++i) {
+    if (perm[i] < 0) {
+      continue;
+    }
+    ++cycles;
+    for (int k = i, next; perm[k] >= 0; k = next) {
+      next = perm[k];
+      perm[k] = -1;
+    }
+  }
+  free(perm);
+  CHECK_C(signum == (n - cycles) % 2);
+
+  // A zero column only shows up in a later panel (rows that are equal or
+  // combinations of others needn't cancel out exactly after the GEMM
+  // updates).
+  for (int i = 0; i < n; ++i) {
+    mtx_matrix_at(&A, i, n - 5) = 0;
+  }
+  mtx_matrix_t S_LU = {0};
+  CHECK_C(mtx_linalg_LU_decomposition(NULL, &S_LU, &A, 1) < 0);
+
+  mtx_matrix_free(&A);
+  mtx_matrix_free(&P);
+  mtx_matrix_free(&LU);
+  mtx_matrix_free(&L);
+  mtx_matrix_free(&U);
+  mtx_matrix_free(&R);
+  mtx_matrix_free(&PA);
+  mtx_matrix_free(&S_LU);
+}
+
+MAKE_TEST(linalg, lu_strided) {
+  // A view of every other row of M2 decomposed in place against a plain copy
+  // of it; the rows of M2 between them must not be touched.
+  mtx_matrix_t M2, M2_0 = {0};
+  mtx_matrix_init(&M2, 10, 5);
+  for (int i = 0; i < M2.dy; ++i) {
+    for (int j = 0; j < M2.dx; ++j) {
+      mtx_matrix_at(&M2, i, j) = (double)rand() / RAND_MAX - 0.5;
+    }
+  }
+  mtx_matrix_clone(&M2_0, &M2);
+
+  for (int perfect = 0; perfect < 2; ++perfect) {
+    mtx_matrix_copy(&M2, &M2_0);
+    mtx_matrix_view_t V = mtx_matrix_strided_of(&M2, 0, 0, 5, 5, 2, 1);
+    mtx_matrix_t M = {0}, P = {0}, LU = {0}, P_v = {0};
+    mtx_matrix_clone(&M, &V.matrix);
+
+    int signum = mtx_linalg_LU_decomposition(&P, &LU, &M, perfect);
+    int signum_v =
+        mtx_linalg_LU_decomposition(&P_v, &V.matrix, &V.matrix, perfect);
+    CHECK_C(signum >= 0 && signum == signum_v);
+    CHECK_C(mtx_matrix_distance(&P, &P_v) == 0);
+    CHECK_C(mtx_matrix_distance(&LU, &V.matrix) == 0);
+    for (int i = 1; i < M2.dy; i += 2) {
+      for (int j = 0; j < M2.dx; ++j) {
+        CHECK_C(mtx_matrix_at(&M2, i, j) == mtx_matrix_at(&M2_0, i, j));
+      }
+    }
+
+    mtx_matrix_free(&M);
+    mtx_matrix_free(&P);
+    mtx_matrix_free(&LU);
+    mtx_matrix_free(&P_v);
+  }
+
+  mtx_matrix_free(&M2);
+  mtx_matrix_free(&M2_0);
+}
+
 // TODO: To test a LU decomposition: since a matrix can have more than one LU
 // decomposition, its better to check its vality using other functions which use
 // a decomposition directly. One simpler method is just check L * U = P * A but
@@ -3,8 +3,11 @@
 
 #include "../matrix.h"
 #include "../matrix_operations.h"
+#include "../simd.h"
+#include "../threads.h"
 #include "routines.h"
 #include "test_utils.h"
+#include <math.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -70,6 +73,444 @@ MAKE_TEST(matrix_arithmetic, mul) {
   CALL_ROUTINE(check_3m_i, mtx_matrix_mul, MAXIMUM_ERROR, 1);
 }
 
+static void fill_random(mtx_matrix_t *M) {
+  for (int i = 0; i < M->dy; ++i) {
+    for (int j = 0; j < M->dx; ++j) {
+      mtx_matrix_at(M, i, j) = (double)rand() / RAND_MAX - 0.5;
+    }
+  }
+}
+
+MAKE_TEST(matrix_arithmetic, mul_blocked) {
+  // Dimensions crossing the micro-kernel and the packed block edges.
+  int dims[][3] = {{97, 129, 257}, {300, 260, 101}, {5, 700, 9}};
+
+  for (int t = 0; t < sizeof(dims) / sizeof(dims[0]); ++t) {
+    mtx_matrix_t A, B, C = {0};
+    mtx_matrix_init(&A, dims[t][0], dims[t][1]);
+    mtx_matrix_init(&B, dims[t][1], dims[t][2]);
+    fill_random(&A);
+    fill_random(&B);
+
+    mtx_matrix_mul(&C, &A, &B);
+
+    double dt = 0;
+    for (int i = 0; i < C.dy; ++i) {
+      for (int j = 0; j < C.dx; ++j) {
+        double sum = 0;
+        for (int p = 0; p < A.dx; ++p) {
+          sum += mtx_matrix_at(&A, i, p) * mtx_matrix_at(&B, p, j);
+        }
+        dt += _mod(sum - mtx_matrix_at(&C, i, j));
+      }
+    }
+
+    mtx_matrix_free(&A);
+    mtx_matrix_free(&B);
+    mtx_matrix_free(&C);
+
+    if (dt > MAXIMUM_ERROR) {
+      throw_error("mtx_matrix_mul() got lost in the blocks of a %dx%d by "
+                  "%dx%d multiplication.",
+                  dims[t][0], dims[t][1], dims[t][1], dims[t][2]);
+    }
+  }
+}
+
+MAKE_TEST(matrix_arithmetic, mul_transposed) {
+  // Small products go through the row loop, the others through the packing.
+  int dims[][3] = {{7, 5, 6}, {97, 129, 67}};
+
+  for (int t = 0; t < sizeof(dims) / sizeof(dims[0]); ++t) {
+    mtx_matrix_t A, B, A_T = {0}, B_T = {0}, expected = {0}, C = {0};
+    mtx_matrix_init(&A, dims[t][1], dims[t][0]);
+    mtx_matrix_init(&B, dims[t][2], dims[t][1]);
+    fill_random(&A);
+    fill_random(&B);
+    mtx_matrix_transpose(&A_T, &A);
+    mtx_matrix_transpose(&B_T, &B);
+    mtx_matrix_mul(&expected, &A_T, &B_T);
+
+    // A^T x B^T, written to the transposed view of C^T.
+    mtx_matrix_view_t a_t = mtx_matrix_transposed_of(&A);
+    mtx_matrix_view_t b_t = mtx_matrix_transposed_of(&B);
+    mtx_matrix_init(&C, dims[t][2], dims[t][0]);
+    mtx_matrix_view_t c_t = mtx_matrix_transposed_of(&C);
+    mtx_matrix_mul(&c_t.matrix, &a_t.matrix, &b_t.matrix);
+
+    double dt = mtx_matrix_distance(&expected, &c_t.matrix);
+
+    mtx_matrix_free(&A);
+    mtx_matrix_free(&B);
+    mtx_matrix_free(&A_T);
+    mtx_matrix_free(&B_T);
+    mtx_matrix_free(&expected);
+    mtx_matrix_free(&C);
+
+    if (dt > MAXIMUM_ERROR) {
+      throw_error("mtx_matrix_mul() lost the transposes of a %dx%d by %dx%d "
+                  "multiplication.",
+                  dims[t][0], dims[t][1], dims[t][1], dims[t][2]);
+    }
+  }
+}
+
+// Checks C = alpha * op(A) x op(B) + beta * C0 element by element.
+static double gemm_error(int transA, int transB, double alpha,
+                         const mtx_matrix_t *A, const mtx_matrix_t *B,
+                         double beta, const mtx_matrix_t *C0,
+                         const mtx_matrix_t *C) {
+  double dt = 0;
+  size_t k = transA ? A->dy : A->dx;
+  for (int i = 0; i < C->dy; ++i) {
+    for (int j = 0; j < C->dx; ++j) {
+      double sum = 0;
+      for (int p = 0; p < k; ++p) {
+        sum += (transA ? mtx_matrix_at(A, p, i) : mtx_matrix_at(A, i, p)) *
+               (transB ? mtx_matrix_at(B, j, p) : mtx_matrix_at(B, p, j));
+      }
+      double expected = alpha * sum;
+      if (beta != 0) {
+        expected += beta * mtx_matrix_at(C0, i, j);
+      }
+      dt += _mod(expected - mtx_matrix_at(C, i, j));
+    }
+  }
+  return dt;
+}
+
+MAKE_TEST(matrix_arithmetic, gemm) {
+  // {m, n, k}: the row loop and the packed blocks.
+  int dims[][3] = {{6, 7, 5}, {101, 67, 130}};
+  double coefs[][2] = {{1, 0}, {-0.5, 2}, {2, 1}, {0, -1}};
+
+  for (int t = 0; t < sizeof(dims) / sizeof(dims[0]); ++t) {
+    int m = dims[t][0], n = dims[t][1], k = dims[t][2];
+    for (int trans = 0; trans < 4; ++trans) {
+      int transA = trans & 1, transB = trans >> 1;
+      mtx_matrix_t A, B, C0, C;
+      mtx_matrix_init(&A, transA ? k : m, transA ? m : k);
+      mtx_matrix_init(&B, transB ? n : k, transB ? k : n);
+      mtx_matrix_init(&C0, m, n);
+      mtx_matrix_init(&C, m, n);
+      fill_random(&A);
+      fill_random(&B);
+      fill_random(&C0);
+
+      for (int c = 0; c < sizeof(coefs) / sizeof(coefs[0]); ++c) {
+        double alpha = coefs[c][0], beta = coefs[c][1];
+        mtx_matrix_copy(&C, &C0);
+        if (beta == 0) {
+          // Not read: NaNs in C can't leak into the result.
+          mtx_matrix_at(&C, m - 1, n - 1) = NAN;
+        }
+        mtx_matrix_gemm(transA, transB, alpha, &A, &B, beta, &C);
+
+        double dt = gemm_error(transA, transB, alpha, &A, &B, beta, &C0, &C);
+        if (!(dt < MAXIMUM_ERROR)) {
+          throw_error("mtx_matrix_gemm() missed C = %g * op(A) op(B) + %g * "
+                      "C with %dx%d by %dx%d operands (trans %d %d).",
+                      alpha, beta, m, k, k, n, transA, transB);
+        }
+      }
+
+      mtx_matrix_free(&A);
+      mtx_matrix_free(&B);
+      mtx_matrix_free(&C0);
+      mtx_matrix_free(&C);
+    }
+  }
+
+  // C = A^T A + C with C being A: the output goes through a temporary that
+  // starts with the elements of C.
+  mtx_matrix_t A, A0 = {0};
+  mtx_matrix_init(&A, 70, 70);
+  fill_random(&A);
+  mtx_matrix_clone(&A0, &A);
+  mtx_matrix_gemm(MTX_TRANS, MTX_NO_TRANS, 1, &A, &A, 1, &A);
+  CHECK_C(gemm_error(1, 0, 1, &A0, &A0, 1, &A0, &A) < MAXIMUM_ERROR);
+
+  mtx_matrix_free(&A);
+  mtx_matrix_free(&A0);
+}
+
+MAKE_TEST(matrix_arithmetic, gemv) {
+  // {m, n, k}: columns, rows and, past MTX_GEMV_PARALLEL, the threaded ones.
+  int dims[][3] = {{37, 1, 45}, {1, 29, 45}, {1, 1, 9}, {700, 1, 400},
+                   {1, 700, 400}};
+  double coefs[][2] = {{1, 0}, {2, 0.5}};
+  int num_threads = mtx_cfg_get_num_threads();
+  mtx_cfg_set_num_threads(4);
+
+  for (int t = 0; t < sizeof(dims) / sizeof(dims[0]); ++t) {
+    int m = dims[t][0], n = dims[t][1], k = dims[t][2];
+    for (int trans = 0; trans < 4; ++trans) {
+      int transA = trans & 1, transB = trans >> 1;
+      mtx_matrix_t A, B, C0, C;
+      mtx_matrix_init(&A, transA ? k : m, transA ? m : k);
+      mtx_matrix_init(&B, transB ? n : k, transB ? k : n);
+      mtx_matrix_init(&C0, m, n);
+      mtx_matrix_init(&C, m, n);
+      fill_random(&A);
+      fill_random(&B);
+      fill_random(&C0);
+
+      for (mtx_simd_t simd = MTX_SIMD_SCALAR; simd <= mtx_cpu_simd_support();
+           ++simd) {
+        mtx_cfg_set_simd(simd);
+        for (int c = 0; c < sizeof(coefs) / sizeof(coefs[0]); ++c) {
+          double alpha = coefs[c][0], beta = coefs[c][1];
+          mtx_matrix_copy(&C, &C0);
+          if (beta == 0) {
+            mtx_matrix_at(&C, m - 1, n - 1) = NAN;
+          }
+          mtx_matrix_gemm(transA, transB, alpha, &A, &B, beta, &C);
+
+          double dt =
+              gemm_error(transA, transB, alpha, &A, &B, beta, &C0, &C);
+          if (!(dt < MAXIMUM_ERROR)) {
+            mtx_cfg_set_simd(MTX_SIMD_AUTO);
+            mtx_cfg_set_num_threads(num_threads);
+            throw_error("GEMV missed C = %g * op(A) op(B) + %g * C with %dx%d "
+                        "by %dx%d operands (trans %d %d, instruction set %d).",
+                        alpha, beta, m, k, k, n, transA, transB, simd);
+          }
+        }
+      }
+      mtx_cfg_set_simd(MTX_SIMD_AUTO);
+
+      mtx_matrix_free(&A);
+      mtx_matrix_free(&B);
+      mtx_matrix_free(&C0);
+      mtx_matrix_free(&C);
+    }
+  }
+  mtx_cfg_set_num_threads(num_threads);
+
+  // A with neither unit columns nor unit rows, through mtx_matrix_mul().
+  mtx_matrix_t A, x, y = {0};
+  mtx_matrix_init(&A, 40, 60);
+  mtx_matrix_init(&x, 30, 1);
+  fill_random(&A);
+  fill_random(&x);
+  mtx_matrix_view_t a = mtx_matrix_strided_of(&A, 39, 0, 20, 30, -2, 2);
+  mtx_matrix_mul(&y, &a.matrix, &x);
+  CHECK_C(y.dy == 20 && y.dx == 1);
+  CHECK_C(gemm_error(0, 0, 1, &a.matrix, &x, 0, &y, &y) < MAXIMUM_ERROR);
+
+  mtx_matrix_free(&A);
+  mtx_matrix_free(&x);
+  mtx_matrix_free(&y);
+}
+
+MAKE_TEST(matrix_arithmetic, element_wise_flat) {
+  // Contiguous operands (one row, rows without padding, past
+  // MTX_PARALLEL_MIN_ELEMENTS, narrow rows) and padded ones, which go row by
+  // row.
+  int dims[][2] = {{1, 1001}, {300, 200}, {70, 13}, {70, 130}};
+  int num_threads = mtx_cfg_get_num_threads();
+  mtx_cfg_set_num_threads(4);
+
+  for (int t = 0; t < sizeof(dims) / sizeof(dims[0]); ++t) {
+    int dy = dims[t][0], dx = dims[t][1];
+    mtx_matrix_t A, B, out[5] = {{0}, {0}, {0}, {0}, {0}};
+    mtx_matrix_init(&A, dy, dx);
+    mtx_matrix_init(&B, dy, dx);
+    fill_random(&A);
+    fill_random(&B);
+    for (int i = 0; i < dy; ++i) {
+      for (int j = 0; j < dx; ++j) {
+        mtx_matrix_at(&B, i, j) += 2;
+      }
+    }
+
+    mtx_matrix_add(&out[0], &A, &B);
+    mtx_matrix_sub(&out[1], &A, &B);
+    mtx_matrix_mul_elements(&out[2], &A, &B);
+    mtx_matrix_div_elements(&out[3], &A, &B);
+    mtx_matrix_s_mul(&out[4], &A, -1.5);
+
+    for (int i = 0; i < dy; ++i) {
+      for (int j = 0; j < dx; ++j) {
+        double a = mtx_matrix_at(&A, i, j), b = mtx_matrix_at(&B, i, j);
+        CHECK_C(mtx_matrix_at(&out[0], i, j) == a + b);
+        CHECK_C(mtx_matrix_at(&out[1], i, j) == a - b);
+        CHECK_C(mtx_matrix_at(&out[2], i, j) == a * b);
+        CHECK_C(mtx_matrix_at(&out[3], i, j) == a / b);
+        CHECK_C(mtx_matrix_at(&out[4], i, j) == a * -1.5);
+      }
+    }
+
+    for (int i = 0; i < 5; ++i) {
+      mtx_matrix_free(&out[i]);
+    }
+    mtx_matrix_free(&A);
+    mtx_matrix_free(&B);
+  }
+  mtx_cfg_set_num_threads(num_threads);
+
+  // s_mul into the rows right after its input: the output goes through a
+  // temporary and is then copied back.
+  mtx_matrix_t M, M0 = {0};
+  mtx_matrix_init(&M, 41, 64);
+  fill_random(&M);
+  mtx_matrix_clone(&M0, &M);
+  mtx_matrix_view_t in = mtx_matrix_view_of(&M, 0, 0, 40, 64);
+  mtx_matrix_view_t out = mtx_matrix_view_of(&M, 1, 0, 40, 64);
+  mtx_matrix_s_mul(&out.matrix, &in.matrix, 3);
+  for (int i = 0; i < 40; ++i) {
+    for (int j = 0; j < 64; ++j) {
+      CHECK_C(mtx_matrix_at(&M, i + 1, j) == 3 * mtx_matrix_at(&M0, i, j));
+    }
+  }
+
+  mtx_matrix_free(&M);
+  mtx_matrix_free(&M0);
+
+  // One long row scaled into itself shifted by a column: the chunks of a
+  // parallel run would read elements already overwritten by the next one.
+  size_t n = (1 << 18) + 1;
+  mtx_matrix_t R, R0 = {0};
+  mtx_matrix_init(&R, 1, n + 1);
+  fill_random(&R);
+  mtx_matrix_clone(&R0, &R);
+  mtx_matrix_view_t r_out = mtx_matrix_view_of(&R, 0, 0, 1, n);
+  mtx_matrix_view_t r_in = mtx_matrix_view_of(&R, 0, 1, 1, n);
+  mtx_cfg_set_num_threads(4);
+  mtx_matrix_s_mul(&r_out.matrix, &r_in.matrix, 2);
+  mtx_cfg_set_num_threads(num_threads);
+  for (size_t j = 0; j < n; ++j) {
+    CHECK_C(mtx_matrix_at(&R, 0, j) == 2 * mtx_matrix_at(&R0, 0, j + 1));
+  }
+
+  mtx_matrix_free(&R);
+  mtx_matrix_free(&R0);
+}
+
+MAKE_TEST(matrix_arithmetic, element_wise_strided) {
+  mtx_matrix_t A, B, C, expected = {0};
+  mtx_matrix_init(&A, 40, 30);
+  mtx_matrix_init(&B, 30, 40);
+  mtx_matrix_init(&C, 60, 40);
+  fill_random(&A);
+  fill_random(&B);
+
+  // B^T - A into every other row of C, in reversed order.
+  mtx_matrix_view_t b_t = mtx_matrix_transposed_of(&B);
+  mtx_matrix_view_t c = mtx_matrix_strided_of(&C, 58, 39, 30, 40, -2, -1);
+  mtx_matrix_view_t c_t = mtx_matrix_transposed_of(&c.matrix);
+  mtx_matrix_sub(&c_t.matrix, &A, &b_t.matrix);
+  mtx_matrix_s_mul(&c_t.matrix, &c_t.matrix, -1);
+
+  mtx_matrix_init(&expected, 40, 30);
+  for (int i = 0; i < 40; ++i) {
+    for (int j = 0; j < 30; ++j) {
+      mtx_matrix_at(&expected, i, j) =
+          mtx_matrix_at(&B, j, i) - mtx_matrix_at(&A, i, j);
+    }
+  }
+  CHECK_C(mtx_matrix_distance(&expected, &c_t.matrix) == 0);
+  for (int i = 0; i < 30; ++i) {
+    for (int j = 0; j < 40; ++j) {
+      CHECK_C(mtx_matrix_at(&C, 58 - 2 * i, 39 - j) ==
+              mtx_matrix_at(&expected, j, i));
+    }
+  }
+
+  // In place on the same view.
+  mtx_matrix_add(&b_t.matrix, &b_t.matrix, &A);
+  for (int i = 0; i < 40; ++i) {
+    for (int j = 0; j < 30; ++j) {
+      double x = mtx_matrix_at(&expected, i, j) + 2 * mtx_matrix_at(&A, i, j);
+      CHECK_C(_mod(mtx_matrix_at(&B, j, i) - x) < 1e-12);
+    }
+  }
+
+  mtx_matrix_free(&A);
+  mtx_matrix_free(&B);
+  mtx_matrix_free(&C);
+  mtx_matrix_free(&expected);
+}
+
+MAKE_TEST(matrix_arithmetic, simd_levels) {
+  mtx_matrix_t A, B, expected[3] = {{0}, {0}, {0}};
+  mtx_matrix_init(&A, 150, 131);
+  mtx_matrix_init(&B, 131, 150);
+  fill_random(&A);
+  fill_random(&B);
+
+  // The scalar kernels are the reference for every instruction set.
+  mtx_cfg_set_simd(MTX_SIMD_SCALAR);
+  CHECK_C(mtx_cfg_get_simd() == MTX_SIMD_SCALAR);
+  mtx_matrix_mul(&expected[0], &A, &B);
+  mtx_matrix_add(&expected[1], &A, &A);
+  double dt = mtx_matrix_distance_each(&expected[2], &A, &expected[1]);
+
+  for (mtx_simd_t simd = MTX_SIMD_SSE2; simd <= mtx_cpu_simd_support();
+       ++simd) {
+    mtx_cfg_set_simd(simd);
+    CHECK_C(mtx_cfg_get_simd() == simd);
+
+    mtx_matrix_t out[3] = {{0}, {0}, {0}};
+    mtx_matrix_mul(&out[0], &A, &B);
+    mtx_matrix_add(&out[1], &A, &A);
+    double dt_simd = mtx_matrix_distance_each(&out[2], &A, &out[1]);
+
+    int ok = _mod(dt - dt_simd) < MAXIMUM_ERROR;
+    for (int i = 0; i < 3; ++i) {
+      ok = ok && mtx_matrix_distance(&out[i], &expected[i]) < MAXIMUM_ERROR;
+      mtx_matrix_free(&out[i]);
+    }
+    if (!ok) {
+      mtx_cfg_set_simd(MTX_SIMD_AUTO);
+      throw_error("kernels of the instruction set %d don't agree with the "
+                  "scalar ones.",
+                  simd);
+    }
+  }
+
+  mtx_cfg_set_simd(MTX_SIMD_AUTO);
+  CHECK_C(mtx_cfg_get_simd() == mtx_cpu_simd_support());
+
+  for (int i = 0; i < 3; ++i) {
+    mtx_matrix_free(&expected[i]);
+  }
+  mtx_matrix_free(&A);
+  mtx_matrix_free(&B);
+}
+
+MAKE_TEST(matrix_arithmetic, threads) {
+  mtx_matrix_t A, B, expected[2] = {{0}, {0}};
+  mtx_matrix_init(&A, 301, 257);
+  mtx_matrix_init(&B, 257, 301);
+  fill_random(&A);
+  fill_random(&B);
+
+  int num_threads = mtx_cfg_get_num_threads();
+
+  mtx_cfg_set_num_threads(1);
+  CHECK_C(mtx_cfg_get_num_threads() == 1);
+  mtx_matrix_mul(&expected[0], &A, &B);
+  mtx_matrix_mul_elements(&expected[1], &A, &A);
+
+  mtx_cfg_set_num_threads(4);
+  CHECK_C(mtx_cfg_get_num_threads() == 4);
+  mtx_matrix_t out[2] = {{0}, {0}};
+  mtx_matrix_mul(&out[0], &A, &B);
+  mtx_matrix_mul_elements(&out[1], &A, &A);
+
+  mtx_cfg_set_num_threads(num_threads);
+
+  for (int i = 0; i < 2; ++i) {
+    CHECK_C_TEXT(mtx_matrix_distance(&out[i], &expected[i]) < MAXIMUM_ERROR,
+                 "multithreaded operation doesn't agree with the serial one.");
+    mtx_matrix_free(&out[i]);
+    mtx_matrix_free(&expected[i]);
+  }
+  mtx_matrix_free(&A);
+  mtx_matrix_free(&B);
+}
+
 MAKE_TEST(matrix_arithmetic, s_mul) {
   mtx_matrix_t A = NEXT_TEST_MTX;
   mtx_matrix_t scalar = RESERVE_MTX(0, 0, 1, 1);
@@ -105,6 +546,106 @@ MAKE_TEST(matrix_arithmetic, transpose) {
   mtx_matrix_free(&A);
   mtx_matrix_free(&_At);
 }
+MAKE_TEST(matrix_arithmetic, transpose_blocked) {
+  // Dimensions crossing the register blocks and the recursion leaves.
+  int dims[][2] = {{1, 1},     {3, 70},   {97, 45},
+                   {130, 130}, {257, 64}, {9, 130}};
+
+  for (mtx_simd_t simd = MTX_SIMD_SCALAR; simd <= mtx_cpu_simd_support();
+       ++simd) {
+    mtx_cfg_set_simd(simd);
+    for (int t = 0; t < sizeof(dims) / sizeof(dims[0]); ++t) {
+      int dy = dims[t][0], dx = dims[t][1];
+      mtx_matrix_t A, A_T = {0}, B;
+      mtx_matrix_init(&A, dy, dx);
+      fill_random(&A);
+      mtx_matrix_transpose(&A_T, &A);
+
+      // Rectangular in place, through the cycles of a contiguous block.
+      double *arr = (double *)malloc(sizeof(double) * dy * dx);
+      mtx_matrix_ref_a(&B, arr, dy, dx);
+      mtx_matrix_copy(&B, &A);
+      mtx_matrix_transpose_in_place(&B);
+
+      // The same with a padded matrix, whose rows are packed first.
+      mtx_matrix_t C = {0};
+      mtx_matrix_clone(&C, &A);
+      mtx_matrix_transpose_in_place(&C);
+
+      int ok = A_T.dy == dx && A_T.dx == dy && B.dy == dx && B.dx == dy &&
+               C.dy == dx && C.dx == dy;
+      for (int i = 0; ok && i < dx; ++i) {
+        for (int j = 0; j < dy; ++j) {
+          ok = ok && mtx_matrix_at(&A_T, i, j) == mtx_matrix_at(&A, j, i) &&
+               mtx_matrix_at(&B, i, j) == mtx_matrix_at(&A, j, i) &&
+               mtx_matrix_at(&C, i, j) == mtx_matrix_at(&A, j, i);
+        }
+      }
+
+      mtx_matrix_free(&C);
+      mtx_matrix_free(&A);
+      mtx_matrix_free(&A_T);
+      mtx_matrix_unref(&B);
+      free(arr);
+
+      if (!ok) {
+        mtx_cfg_set_simd(MTX_SIMD_AUTO);
+        throw_error("mtx_matrix_transpose() lost some blocks of a %dx%d "
+                    "matrix with the instruction set %d.",
+                    dy, dx, simd);
+      }
+    }
+
+    // Square in place: a matrix and a view of it.
+    mtx_matrix_t S, S_T = {0};
+    mtx_matrix_init(&S, 150, 150);
+    fill_random(&S);
+    mtx_matrix_transpose(&S_T, &S);
+    mtx_matrix_transpose(&S, &S);
+    CHECK_C(mtx_matrix_equals(&S, &S_T));
+
+    mtx_matrix_view_t v = mtx_matrix_view_of(&S, 10, 5, 77, 77);
+    mtx_matrix_t v_t = {0};
+    mtx_matrix_transpose(&v_t, &v.matrix);
+    mtx_matrix_transpose_in_place(&v.matrix);
+    CHECK_C(mtx_matrix_equals(&v.matrix, &v_t));
+    mtx_matrix_transpose_in_place(&v.matrix);
+    mtx_matrix_free(&v_t);
+
+    // Overlapping without being the same goes through a temporary.
+    mtx_matrix_view_t w = mtx_matrix_view_of(&S, 1, 0, 149, 149);
+    mtx_matrix_view_t w_t = mtx_matrix_view_of(&S, 0, 1, 149, 149);
+    mtx_matrix_transpose(&w_t.matrix, &w.matrix);
+    for (int i = 0; i < 149; ++i) {
+      for (int j = 0; j < 149; ++j) {
+        CHECK_C(mtx_matrix_at(&S, i, j + 1) == mtx_matrix_at(&S_T, j + 1, i));
+      }
+    }
+
+    mtx_matrix_free(&S);
+    mtx_matrix_free(&S_T);
+  }
+  mtx_cfg_set_simd(MTX_SIMD_AUTO);
+
+  // A block of whole rows of a contiguous matrix becomes a reshaped view.
+  double arr[6 * 4];
+  mtx_matrix_t M;
+  mtx_matrix_ref_a(&M, arr, 6, 4);
+  for (int i = 0; i < 24; ++i) {
+    arr[i] = i;
+  }
+  mtx_matrix_view_t rows = mtx_matrix_view_of(&M, 1, 0, 3, 4);
+  mtx_matrix_transpose_in_place(&rows.matrix);
+  CHECK_C(rows.matrix.dy == 4 && rows.matrix.dx == 3);
+  for (int i = 0; i < 4; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      CHECK_C(mtx_matrix_at(&rows.matrix, i, j) == 4 * (j + 1) + i);
+    }
+  }
+  CHECK_C(arr[0] == 0 && arr[3] == 3 && arr[20] == 20 && arr[23] == 23);
+  mtx_matrix_unref(&M);
+}
+
 static MAKE_ROUTINE(check_identity, const char *m_class) {
 
   mtx_matrix_t A = NEXT_TEST_MTX;
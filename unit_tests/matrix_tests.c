@@ -2,9 +2,17 @@
 #include <CppUTestExt/MockSupport_c.h>
 
 #include "../matrix.h"
+#include "../matrix_io.h"
+#include "../sparse.h"
+#include "../threads.h"
+#include "../workspace.h"
 #include "test_utils.h"
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -24,9 +32,10 @@ TEST_GROUP_C_TEARDOWN(matrix_lifecycle) {
 
 MAKE_TEST(matrix_lifecycle, init) {
 
-  // mtx_default_mem_alloc being tested
-
-  mock_c()->expectNCalls(3, "malloc_mock");
+  // mtx_default_mem_aligned_alloc being tested, header and elements come
+  // from a single allocation.
+  mock_c()->expectNoCall("malloc_mock");
+  mock_c()->expectOneCall("posix_memalign_mock");
 
   mtx_matrix_init(&__M, M_DY, M_DX);
   CHECK_C(__M.data != NULL);
@@ -36,6 +45,11 @@ MAKE_TEST(matrix_lifecycle, init) {
                "Wrong dimensions on initialization!");
   CHECK_C_TEXT(__M.data->size1 == M_DY && __M.data->size2 == M_DX,
                "Wrong matrix_data dimensions on initialization!");
+  CHECK_C_TEXT(__M.data->ld >= M_DX,
+               "Wrong leading dimension on initialization!");
+  CHECK_C_TEXT(__M.data->flags & MTX_MATRIX_DATA_INLINE,
+               "Elements not allocated with the header!");
+  CHECK_C((char *)__M.data->m > (char *)__M.data);
 }
 
 MAKE_TEST(matrix_lifecycle, init_fail) {
@@ -43,8 +57,8 @@ MAKE_TEST(matrix_lifecycle, init_fail) {
 
   int d = 5;
 
-  // Emulate malloc() error
-  mock_c()->expectOneCall("malloc_mock")->andReturnPointerValue(NULL);
+  // Emulate posix_memalign() error
+  mock_c()->expectOneCall("posix_memalign_mock")->andReturnIntValue(ENOMEM);
   mock_c()
       ->expectOneCall("test_fail")
       ->withIntParameters("error", MTX_SYSTEM_ERR);
@@ -53,10 +67,42 @@ MAKE_TEST(matrix_lifecycle, init_fail) {
   CATCH(INTEGER, exp) {}
 }
 
+MAKE_TEST(matrix_lifecycle, init_aligned) {
+  mock_c()->disable();
+
+  // {dy, dx, expected leading dimension}: narrow rows aren't padded.
+  size_t dims[][3] = {{3, 5, 5},     {100000, 1, 1}, {4, 100, 100},
+                      {4, 130, 136}, {2, 512, 520},  {1, 512, 512}};
+  for (int i = 0; i < sizeof(dims) / sizeof(dims[0]); ++i) {
+    mtx_matrix_t m;
+    mtx_matrix_init(&m, dims[i][0], dims[i][1]);
+    CHECK_C(m.data->ld == dims[i][2]);
+    CHECK_C(MTX_MATRIX_IS_CONTIGUOUS(&m) == (dims[i][1] == dims[i][2]));
+    for (size_t r = 0; r < m.dy; ++r) {
+      CHECK_C((uintptr_t)mtx_matrix_row(&m, r) % MTX_MATRIX_ALIGNMENT == 0 ||
+              m.data->ld % (MTX_MATRIX_ALIGNMENT / sizeof(double)) != 0);
+    }
+    mtx_matrix_free(&m);
+  }
+}
+
+MAKE_TEST(matrix_lifecycle, init_overflow) {
+  mtx_matrix_t m = {0};
+
+  // dy * dx doubles don't fit in a size_t.
+  mock_c()->expectNoCall("posix_memalign_mock");
+  mock_c()
+      ->expectOneCall("test_fail")
+      ->withIntParameters("error", MTX_DIMEN_ERR);
+
+  TRY mtx_matrix_init(&m, SIZE_MAX / 4, 3);
+  CATCH(INTEGER, exp) {}
+}
+
 // Last test
 MAKE_TEST(matrix_lifecycle, free) {
 
-  mock_c()->expectNCalls(3, "free_mock");
+  mock_c()->expectOneCall("free_mock");
 
   mtx_matrix_free(&__M);
 }
@@ -82,7 +128,7 @@ MAKE_TEST(matrix_lifecycle, ref_a) {
 
   mtx_matrix_t m;
 
-  mock_c()->expectNCalls(2, "malloc_mock");
+  mock_c()->expectOneCall("malloc_mock");
   mtx_matrix_ref_a(&m, arr, 3, 2);
 
   for (int i = 0; i < m.dy; ++i) {
@@ -102,23 +148,112 @@ MAKE_TEST(matrix_lifecycle, unref) {
 
   mock_c()->enable();
 
-  mock_c()->expectNCalls(2, "free_mock");
+  mock_c()->expectOneCall("free_mock");
   mtx_matrix_unref(&m);
 }
 
+MAKE_TEST(matrix_lifecycle, unref_fail) {
+  mock_c()->disable();
+  mtx_matrix_t m;
+  mtx_matrix_init(&m, 3, 2);
+
+  mock_c()->enable();
+
+  // The elements of an initialized matrix are freed along with its header.
+  mock_c()->expectNoCall("free_mock");
+  mock_c()
+      ->expectOneCall("test_fail")
+      ->withIntParameters("error", MTX_INVALID_ERR);
+
+  TRY mtx_matrix_unref(&m);
+  CATCH(INTEGER, exp) {}
+
+  mock_c()->disable();
+  mtx_matrix_free(&m);
+}
+
+MAKE_TEST(matrix_lifecycle, swap) {
+  mock_c()->disable();
+  mtx_matrix_t m1, m2;
+  mtx_matrix_init(&m1, 3, 2);
+  mtx_matrix_init(&m2, 3, 2);
+  mtx_matrix_at(&m1, 0, 0) = 1;
+  mtx_matrix_at(&m2, 0, 0) = 2;
+
+  mtx_matrix_swap(&m1, &m2);
+  CHECK_C(mtx_matrix_at(&m1, 0, 0) == 2 && mtx_matrix_at(&m2, 0, 0) == 1);
+
+  mock_c()->enable();
+
+  // Each header is still freed with its own elements.
+  mock_c()->expectNCalls(2, "free_mock");
+  mtx_matrix_free(&m1);
+  mtx_matrix_free(&m2);
+}
+
+MAKE_TEST(matrix_lifecycle, init_scratch) {
+  mock_c()->disable();
+  mtx_workspace_t ws;
+  mtx_workspace_init(&ws, 4096);
+  mtx_workspace_attach(&ws);
+
+  mtx_matrix_t a, b, c;
+  mtx_matrix_init_scratch(&a, 3, 2);
+  mtx_matrix_init_scratch(&b, 3, 2);
+  CHECK_C((char *)a.data >= ws.base && (char *)b.data > (char *)a.data);
+  CHECK_C((uintptr_t)mtx_matrix_row(&b, 0) % MTX_MATRIX_ALIGNMENT == 0);
+
+  // Freed out of order, b is only popped along with a.
+  size_t used = ws.used;
+  mtx_matrix_free(&a);
+  CHECK_C(ws.used == used);
+  mtx_matrix_free(&b);
+  CHECK_C(ws.used == 0);
+
+  // Doesn't fit in the buffer: allocated apart and the buffer grows to the
+  // peak once the workspace is empty.
+  mtx_matrix_init_scratch(&c, 100, 100);
+  CHECK_C(ws.blocks != NULL);
+  mtx_matrix_free(&c);
+  CHECK_C(ws.blocks == NULL && ws.size >= 100 * 100 * sizeof(double));
+
+  // Blocks go back to where they came from, whatever is attached when they
+  // are freed.
+  mtx_matrix_init_scratch(&a, 3, 2);
+  mtx_matrix_init_scratch(&c, 200, 200);
+  mtx_workspace_attach(NULL);
+  mtx_matrix_init_scratch(&b, 3, 2);
+  mtx_matrix_free(&a);
+  mtx_matrix_free(&c);
+  CHECK_C(ws.used == 0 && ws.blocks == NULL);
+  mtx_workspace_attach(&ws);
+  mtx_matrix_free(&b);
+  CHECK_C(ws.used == 0);
+
+  mtx_workspace_attach(NULL);
+  mtx_workspace_free(&ws);
+
+  // Without a workspace the block comes from the aligned allocator.
+  mock_c()->enable();
+  mock_c()->expectOneCall("posix_memalign_mock");
+  mock_c()->expectOneCall("free_mock");
+  mtx_matrix_init_scratch(&c, 3, 2);
+  mtx_matrix_free(&c);
+}
+
 MAKE_TEST(matrix_lifecycle, raw_a) {
   mock_c()->disable();
   double arr[6];
   mtx_matrix_t m;
   mtx_matrix_ref_a(&m, arr, 3, 2);
 
-  // swaps row 1 and row 3
-  double *tmp = m.data->m[0];
-  m.data->m[0] = m.data->m[2];
-  m.data->m[2] = tmp;
-
   CHECK_C(mtx_matrix_raw_a(&m) == arr);
 
+  // A view shares the array of the whole matrix.
+  mtx_matrix_view_t v = mtx_matrix_view_of(&m, 1, 1, 2, 1);
+  CHECK_C(mtx_matrix_raw_a(&v.matrix) == arr);
+  CHECK_C(&mtx_matrix_at(&v.matrix, 1, 0) == &arr[2 * m.dx + 1]);
+
   mtx_matrix_unref(&m);
 }
 
@@ -286,6 +421,136 @@ MAKE_TEST(matrix_basic, view_fail) {
   TRY vf = mtx_matrix_view_of(&__M, __M.dy - 1, 0, 1, __M.dx + 1);
   CATCH(INTEGER, exp3) {}
 }
+MAKE_TEST(matrix_basic, strided_view) {
+  mock_c()->disable();
+  mtx_matrix_t m;
+  mtx_matrix_init(&m, 6, 5);
+  for (int i = 0; i < 6; ++i) {
+    for (int j = 0; j < 5; ++j) {
+      mtx_matrix_at(&m, i, j) = 10 * i + j;
+    }
+  }
+
+  // Every other row, columns in reversed order.
+  mtx_matrix_view_t v = mtx_matrix_strided_of(&m, 1, 4, 3, 5, 2, -1);
+  CHECK_C(MTX_MATRIX_IS_VIEW(&v.matrix) && v.matrix.dy == 3 &&
+          v.matrix.dx == 5);
+  CHECK_C(!MTX_MATRIX_HAS_UNIT_COLUMNS(&v.matrix));
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 5; ++j) {
+      CHECK_C(mtx_matrix_at(&v.matrix, i, j) == 10 * (1 + 2 * i) + 4 - j);
+    }
+  }
+
+  // Views of strided views compose the strides.
+  mtx_matrix_view_t w = mtx_matrix_view_of(&v.matrix, 1, 1, 2, 3);
+  CHECK_C(&mtx_matrix_at(&w.matrix, 1, 2) == &mtx_matrix_at(&m, 5, 1));
+  mtx_matrix_view_t s = mtx_matrix_strided_of(&v.matrix, 2, 0, 2, 3, -1, 2);
+  CHECK_C(&mtx_matrix_at(&s.matrix, 1, 2) == &mtx_matrix_at(&m, 3, 0));
+
+  mtx_matrix_view_t d = mtx_matrix_diagonal_of(&m);
+  CHECK_C(d.matrix.dy == 5 && d.matrix.dx == 1);
+  for (int i = 0; i < 5; ++i) {
+    CHECK_C(mtx_matrix_at(&d.matrix, i, 0) == 11 * i);
+  }
+
+  mtx_matrix_view_t t = mtx_matrix_transposed_of(&m);
+  CHECK_C(t.matrix.dy == 5 && t.matrix.dx == 6);
+  CHECK_C(t.matrix.flags & MTX_MATRIX_VIEW_TRANSPOSED);
+  for (int i = 0; i < 5; ++i) {
+    for (int j = 0; j < 6; ++j) {
+      CHECK_C(mtx_matrix_at(&t.matrix, i, j) == 10 * j + i);
+    }
+  }
+  mtx_matrix_view_t tt = mtx_matrix_transposed_of(&t.matrix);
+  CHECK_C(!(tt.matrix.flags & MTX_MATRIX_VIEW_TRANSPOSED));
+  CHECK_C(mtx_matrix_equals(&tt.matrix, &m));
+
+  // Strided copies and views of strided views of transposed views.
+  mtx_matrix_t c = {0};
+  mtx_matrix_clone(&c, &t.matrix);
+  CHECK_C(mtx_matrix_equals(&c, &t.matrix) && c.flags == 0);
+  mtx_matrix_view_t tc = mtx_matrix_view_of(&t.matrix, 1, 2, 3, 2);
+  CHECK_C(mtx_matrix_at(&tc.matrix, 2, 1) == 33);
+
+  // The transpose of the rows in place: overlapping strided copies go through
+  // a temporary.
+  mtx_matrix_view_t sq = mtx_matrix_view_of(&m, 0, 0, 5, 5);
+  mtx_matrix_view_t sq_t = mtx_matrix_transposed_of(&sq.matrix);
+  CHECK_C(MTX_MATRIX_OVERLAP(&sq.matrix, &sq_t.matrix));
+  mtx_matrix_copy(&sq.matrix, &sq_t.matrix);
+  for (int i = 0; i < 5; ++i) {
+    for (int j = 0; j < 5; ++j) {
+      CHECK_C(mtx_matrix_at(&m, i, j) == 10 * j + i);
+    }
+  }
+
+  mtx_matrix_free(&c);
+  mtx_matrix_free(&m);
+}
+
+MAKE_TEST(matrix_basic, strided_view_fail) {
+  mock_c()
+      ->expectNCalls(3, "test_fail")
+      ->withIntParameters("error", MTX_BOUNDS_ERR);
+
+  mtx_matrix_view_t vf;
+  TRY vf = mtx_matrix_strided_of(&__M, 0, 0, M_DY / 2 + 2, 1, 2, 1);
+  CATCH(INTEGER, exp1) {}
+  TRY vf = mtx_matrix_strided_of(&__M, 2, 0, 4, 1, -1, 1);
+  CATCH(INTEGER, exp2) {}
+  TRY vf = mtx_matrix_strided_of(&__M, 0, M_DX, 1, 1, 1, 1);
+  CATCH(INTEGER, exp3) {}
+}
+
+MAKE_TEST(matrix_basic, reshape_view) {
+  mock_c()->disable();
+  mtx_matrix_t m;
+  mtx_matrix_init(&m, 4, 6);
+  for (int i = 0; i < 4; ++i) {
+    for (int j = 0; j < 6; ++j) {
+      mtx_matrix_at(&m, i, j) = 6 * i + j;
+    }
+  }
+
+  // A narrow matrix has no padding between the rows.
+  CHECK_C(MTX_MATRIX_IS_CONTIGUOUS(&m));
+  mtx_matrix_view_t whole = mtx_matrix_reshape_of(&m, 3, 8);
+  for (int k = 0; k < 24; ++k) {
+    CHECK_C(mtx_matrix_at(&whole.matrix, k / 8, k % 8) == k);
+  }
+
+  // So is a single row of it.
+  mtx_matrix_view_t row = mtx_matrix_row_of(&m, 2);
+  CHECK_C(MTX_MATRIX_IS_CONTIGUOUS(&row.matrix));
+  mtx_matrix_view_t r = mtx_matrix_reshape_of(&row.matrix, 3, 2);
+  CHECK_C(r.matrix.dy == 3 && r.matrix.dx == 2);
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 2; ++j) {
+      CHECK_C(mtx_matrix_at(&r.matrix, i, j) == 12 + 2 * i + j);
+    }
+  }
+  mtx_matrix_view_t rr = mtx_matrix_reshape_of(&r.matrix, 1, 6);
+  CHECK_C(mtx_matrix_equals(&rr.matrix, &row.matrix));
+
+  // A view of some of the columns has gaps between its rows.
+  mtx_matrix_view_t cols = mtx_matrix_view_of(&m, 0, 0, 4, 5);
+  mock_c()->enable();
+  mock_c()
+      ->expectOneCall("test_fail")
+      ->withIntParameters("error", MTX_INVALID_ERR);
+  mock_c()
+      ->expectOneCall("test_fail")
+      ->withIntParameters("error", MTX_DIMEN_ERR);
+  TRY r = mtx_matrix_reshape_of(&cols.matrix, 5, 4);
+  CATCH(INTEGER, exp1) {}
+  TRY r = mtx_matrix_reshape_of(&row.matrix, 4, 2);
+  CATCH(INTEGER, exp2) {}
+  mock_c()->disable();
+
+  mtx_matrix_free(&m);
+}
+
 MAKE_TEST(matrix_basic, view_free) {
   mock_c()->expectNoCall("free_mock");
 
@@ -304,24 +569,199 @@ TEST_GROUP_C_TEARDOWN(matrix_io) {
   mock_c()->clear();
 }
 
-#define FIOTEST(variation, sys_fun, ncalls)                                    \
-  mock_c()->disable();                                                         \
-  mtx_matrix_view_t m = mtx_matrix_view_of(&__M, 3, 3, 2, 2);                  \
-                                                                               \
-  mock_c()->enable();                                                          \
-                                                                               \
-  FILE *fake_fd = (FILE *)234828148;                                           \
-  mock_c()                                                                     \
-      ->expectNCalls((ncalls), #sys_fun "_mock")                               \
-      ->withPointerParameters("stream", fake_fd)                               \
-      ->andReturnIntValue(1);                                                  \
-  mtx_matrix_##variation(fake_fd, &m.matrix)
-
 MAKE_TEST(matrix_io, fread) {
-  FIOTEST(fread, fscanf, m.matrix.dx * m.matrix.dy);
+  mock_c()->disable();
+  mtx_matrix_view_t m = mtx_matrix_view_of(&__M, 3, 3, 2, 2);
+
+  // Any run of delimiters or line breaks separates the numbers.
+  FILE *fd = tmpfile();
+  fputs("1.5, -2e3\r\n\n  0.1\t,,7 x", fd);
+  rewind(fd);
+  mtx_matrix_fread(fd, &m.matrix);
+  CHECK_C(mtx_matrix_at(&m.matrix, 0, 0) == 1.5 &&
+          mtx_matrix_at(&m.matrix, 0, 1) == -2e3 &&
+          mtx_matrix_at(&m.matrix, 1, 0) == 0.1 &&
+          mtx_matrix_at(&m.matrix, 1, 1) == 7);
+
+  // The character after the last number is left in the stream.
+  CHECK_C(getc(fd) == ' ');
+
+  mock_c()->enable();
+  mock_c()
+      ->expectOneCall("test_fail")
+      ->withIntParameters("error", MTX_SYSTEM_ERR);
+  TRY mtx_matrix_fread(fd, &m.matrix);
+  CATCH(INTEGER, exp) {}
+  CHECK_C(getc(fd) == 'x');
+
+  fclose(fd);
+}
+
+MAKE_TEST(matrix_io, parse_double) {
+  mock_c()->disable();
+  const char *valid[] = {"0",
+                         "-0",
+                         "+12",
+                         "3.",
+                         ".5",
+                         "1e5",
+                         "1E-5",
+                         "0.1",
+                         "-24.3",
+                         "9007199254740993",
+                         "123456789012345678901234567890",
+                         "0.000000000000000000000000000001",
+                         "2.2250738585072011e-308",
+                         "4.9406564584124654e-324",
+                         "1.7976931348623157e308",
+                         "1e400",
+                         "0.30000000000000004",
+                         "-3.342e+119",
+                         "inf",
+                         "-Infinity",
+                         "+INF",
+                         "nan",
+                         "-NaN"};
+  for (size_t i = 0; i < sizeof(valid) / sizeof(*valid); ++i) {
+    const char *end = valid[i] + strlen(valid[i]);
+    double x;
+    CHECK_C(_mtx_parse_double(valid[i], end, &x) == end);
+    double expected = strtod(valid[i], NULL);
+    CHECK_C(memcmp(&x, &expected, sizeof(x)) == 0);
+  }
+
+  // Stops at the first character that isn't part of the number.
+  const char *s = "12.5e+x";
+  double x;
+  CHECK_C(_mtx_parse_double(s, s + strlen(s), &x) == s + 4 && x == 12.5);
+  s = "-info";
+  CHECK_C(_mtx_parse_double(s, s + strlen(s), &x) == s + 4 && x == -INFINITY);
+  s = "-.e1";
+  CHECK_C(_mtx_parse_double(s, s + strlen(s), &x) == NULL);
+  CHECK_C(_mtx_parse_double(s, s, &x) == NULL);
 }
+
+MAKE_TEST(matrix_io, format_double) {
+  mock_c()->disable();
+  const double values[] = {0.1,  -0.0, 1e21, 1e22, 123456789012345680.0,
+                           1e-7, 1.5e-6, 5e-324, 1.7976931348623157e308,
+                           -24.3, 0.30000000000000004, INFINITY,
+                           -INFINITY, NAN};
+  const char *expected[] = {"0.1",
+                            "-0",
+                            "1e21",
+                            "1e22",
+                            "123456789012345680",
+                            "1e-7",
+                            "0.0000015",
+                            "5e-324",
+                            "1.7976931348623157e308",
+                            "-24.3",
+                            "0.30000000000000004",
+                            "inf",
+                            "-inf",
+                            "nan"};
+  char buf[MTX_DOUBLE_CHARS_MAX];
+  for (size_t i = 0; i < sizeof(values) / sizeof(*values); ++i) {
+    int n = _mtx_format_double(buf, values[i]);
+    CHECK_C(n == (int)strlen(expected[i]) &&
+            memcmp(buf, expected[i], n) == 0);
+  }
+
+  // Random bit patterns read back to the same value.
+  uint64_t state = 88172645463325252ull;
+  for (int i = 0; i < 100000; ++i) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    double x;
+    memcpy(&x, &state, sizeof(x));
+    if (x != x) {
+      continue;
+    }
+    int n = _mtx_format_double(buf, x);
+    buf[n] = '\0';
+    double y = strtod(buf, NULL);
+    CHECK_C(memcmp(&x, &y, sizeof(x)) == 0);
+  }
+
+  // Infinities and NaNs read back through the text readers.
+  mtx_matrix_t m, r = {0};
+  mtx_matrix_init(&m, 2, 3);
+  mtx_matrix_at(&m, 0, 0) = 1;
+  mtx_matrix_at(&m, 0, 1) = -INFINITY;
+  mtx_matrix_at(&m, 0, 2) = 2;
+  mtx_matrix_at(&m, 1, 0) = NAN;
+  mtx_matrix_at(&m, 1, 1) = INFINITY;
+  mtx_matrix_at(&m, 1, 2) = -0.5;
+  FILE *fd = tmpfile();
+  mtx_matrix_fprint(fd, &m);
+  rewind(fd);
+  mtx_matrix_init(&r, 2, 3);
+  mtx_matrix_fread(fd, &r);
+  rewind(fd);
+  size_t dy, dx;
+  double *raw = mtx_matrix_fread_raw(fd, &dy, &dx);
+  fclose(fd);
+  CHECK_C(raw != NULL && dy == 2 && dx == 3);
+  for (int i = 0; i < 2; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      double e = mtx_matrix_at(&m, i, j);
+      double a = mtx_matrix_at(&r, i, j), b = raw[i * 3 + j];
+      CHECK_C(e != e ? a != a && b != b : a == e && b == e);
+    }
+  }
+  free(raw);
+  mtx_matrix_free(&m);
+  mtx_matrix_free(&r);
+}
+
 MAKE_TEST(matrix_io, fprint) {
-  FIOTEST(fprint, fprintf, (m.matrix.dx + 1) * m.matrix.dy);
+  mock_c()->disable();
+  mtx_matrix_view_t v = mtx_matrix_view_of(&__M, 1, 2, 3, 4);
+  mtx_matrix_at(&v.matrix, 0, 0) = 0.1;
+  mtx_matrix_at(&v.matrix, 0, 1) = -1e-300;
+  mtx_matrix_at(&v.matrix, 0, 2) = 1.0 / 3;
+
+  // The default output reads back to the same matrix.
+  FILE *fd = tmpfile();
+  mtx_matrix_fprint(fd, &v.matrix);
+  rewind(fd);
+  mtx_matrix_t m = {0};
+  mtx_matrix_init(&m, 3, 4);
+  mtx_matrix_fread(fd, &m);
+  CHECK_C(mtx_matrix_equals(&m, &v.matrix));
+  fclose(fd);
+
+  // Precision and delimiter.
+  fd = tmpfile();
+  mtx_matrix_view_t row = mtx_matrix_view_of(&v.matrix, 0, 0, 1, 3);
+  mtx_print_opts_t opts = {4, ", "};
+  mtx_matrix_fprint_opt(fd, &row.matrix, &opts);
+  char line[64] = {0};
+  rewind(fd);
+  CHECK_C(fread(line, 1, sizeof(line) - 1, fd) > 0);
+  CHECK_C(strcmp(line, "0.1, -1e-300, 0.3333\n") == 0);
+  fclose(fd);
+
+  // Rows longer than the internal buffer.
+  fd = tmpfile();
+  mtx_matrix_t wide = {0};
+  mtx_matrix_init(&wide, 2, 5000);
+  for (size_t j = 0; j < wide.dx; ++j) {
+    mtx_matrix_at(&wide, 0, j) = j / 7.0;
+    mtx_matrix_at(&wide, 1, j) = -(double)j;
+  }
+  mtx_matrix_fprint(fd, &wide);
+  rewind(fd);
+  mtx_matrix_free(&m);
+  mtx_matrix_init(&m, 2, 5000);
+  mtx_matrix_fread(fd, &m);
+  CHECK_C(mtx_matrix_equals(&m, &wide));
+  fclose(fd);
+
+  mtx_matrix_free(&wide);
+  mtx_matrix_free(&m);
 }
 
 // TODO: Impl better IO errors checks.
@@ -344,6 +784,523 @@ MAKE_TEST(matrix_io, fprint_fail) { FIOTEST_FAIL(fprint, fprintf); }
 
 MAKE_TEST(matrix_io, finit_fail) { FIOTEST_FAIL(finit, fscanf); }
 
+MAKE_TEST(matrix_io, fwrite_bin) {
+  mock_c()->disable();
+  FILE *fd = tmpfile();
+  mtx_matrix_view_t v = mtx_matrix_view_of(&__M, 1, 2, 3, 4);
+
+  // Strided view, with and without checksum.
+  mtx_matrix_fwrite_bin(fd, &v.matrix, MTX_BIN_CHECKSUM);
+  mtx_matrix_fwrite_bin(fd, &v.matrix, 0);
+  CHECK_C(ftell(fd) == 2 * (sizeof(mtx_bin_header_t) + 3 * 4 * sizeof(double)));
+  rewind(fd);
+
+  mtx_matrix_t m = {0};
+  CHECK_C(mtx_matrix_fread_bin(fd, &m) == 0);
+  CHECK_C(mtx_matrix_equals(&m, &v.matrix));
+  mtx_matrix_at(&m, 2, 3) += 1;
+  CHECK_C(mtx_matrix_fread_bin(fd, &m) == 0);
+  CHECK_C(mtx_matrix_equals(&m, &v.matrix));
+
+  // End of the stream.
+  CHECK_C(mtx_matrix_fread_bin(fd, &m) == 1);
+
+  mtx_matrix_free(&m);
+  fclose(fd);
+}
+
+MAKE_TEST(matrix_io, fread_bin_swapped) {
+  mock_c()->disable();
+  FILE *fd = tmpfile();
+
+  // Written by a machine with the other byte order.
+  double elements[2] = {1.5, -2};
+  mtx_bin_header_t header = {.magic = MTX_BIN_MAGIC,
+                             .version = __builtin_bswap16(MTX_BIN_VERSION),
+                             .dtype = MTX_BIN_FLOAT64,
+                             .flags = MTX_BIN_CHECKSUM,
+                             .endian = __builtin_bswap32(MTX_BIN_ENDIAN_TAG),
+                             .rows = __builtin_bswap64(1),
+                             .cols = __builtin_bswap64(2)};
+  for (int i = 0; i < 2; ++i) {
+    uint64_t bits;
+    memcpy(&bits, &elements[i], sizeof(bits));
+    bits = __builtin_bswap64(bits);
+    memcpy(&elements[i], &bits, sizeof(bits));
+  }
+  header.checksum = __builtin_bswap64(
+      mtx_fnv1a(MTX_FNV1A_INIT, elements, sizeof(elements)));
+  fwrite(&header, sizeof(header), 1, fd);
+  fwrite(elements, sizeof(elements), 1, fd);
+  rewind(fd);
+
+  mtx_matrix_t m = {0};
+  CHECK_C(mtx_matrix_fread_bin(fd, &m) == 0);
+  CHECK_C(m.dy == 1 && m.dx == 2);
+  CHECK_C(mtx_matrix_at(&m, 0, 0) == 1.5 && mtx_matrix_at(&m, 0, 1) == -2);
+
+  mtx_matrix_free(&m);
+  fclose(fd);
+}
+
+MAKE_TEST(matrix_io, fread_bin_fail) {
+  mock_c()->disable();
+  FILE *fd = tmpfile();
+  mtx_matrix_view_t v = mtx_matrix_view_of(&__M, 0, 0, 2, 2);
+  mtx_matrix_fwrite_bin(fd, &v.matrix, MTX_BIN_CHECKSUM);
+
+  // Corrupted element.
+  fseek(fd, sizeof(mtx_bin_header_t) + 3, SEEK_SET);
+  int c = getc(fd);
+  fseek(fd, sizeof(mtx_bin_header_t) + 3, SEEK_SET);
+  putc(c ^ 0x10, fd);
+  rewind(fd);
+  mtx_matrix_t m = {0};
+  CHECK_C(mtx_matrix_fread_bin(fd, &m) == 1);
+  CHECK_C(m.data == NULL);
+
+  // Truncated.
+  char buf[sizeof(mtx_bin_header_t) + 4 * sizeof(double)];
+  rewind(fd);
+  CHECK_C(fread(buf, 1, sizeof(buf), fd) == sizeof(buf));
+  fclose(fd);
+  fd = tmpfile();
+  fwrite(buf, 1, sizeof(buf) - 1, fd);
+  rewind(fd);
+  CHECK_C(mtx_matrix_fread_bin(fd, &m) == 1);
+  CHECK_C(m.data == NULL);
+  fclose(fd);
+
+  // Header claiming more elements than the file holds, or than fit in memory.
+  mtx_bin_header_t header;
+  memcpy(&header, buf, sizeof(header));
+  uint64_t dims[][2] = {
+      {3, 2}, {1ull << 40, 1ull << 20}, {1ull << 40, 1ull << 40}};
+  for (size_t i = 0; i < sizeof(dims) / sizeof(dims[0]); ++i) {
+    header.rows = dims[i][0];
+    header.cols = dims[i][1];
+    fd = tmpfile();
+    fwrite(&header, sizeof(header), 1, fd);
+    fwrite(buf + sizeof(header), 4 * sizeof(double), 1, fd);
+    rewind(fd);
+    CHECK_C(mtx_matrix_fread_bin(fd, &m) == 1);
+    CHECK_C(m.data == NULL);
+    fclose(fd);
+  }
+
+  mtx_matrix_t t;
+  mtx_matrix_init(&t, 2, 2);
+
+  // Bad magic.
+  fd = tmpfile();
+  fputs("MTXA and whatever follows it in the file........................", fd);
+  rewind(fd);
+  CHECK_C(mtx_matrix_fread_bin(fd, &t) == 1);
+  fclose(fd);
+
+  // Dimensions differ from an initialized matrix.
+  fd = tmpfile();
+  mtx_matrix_fwrite_bin(fd, &__M, 0);
+  rewind(fd);
+  mock_c()->enable();
+  mock_c()
+      ->expectOneCall("test_fail")
+      ->withIntParameters("error", MTX_DIMEN_ERR);
+  TRY mtx_matrix_fread_bin(fd, &t);
+  CATCH(INTEGER, exp) {}
+  mock_c()->disable();
+
+  mtx_matrix_free(&t);
+  fclose(fd);
+}
+
+MAKE_TEST(matrix_io, mmap) {
+  mock_c()->disable();
+  char path[] = "/tmp/mtx_mmap_XXXXXX";
+  int fd = mkstemp(path);
+  FILE *stream = fdopen(fd, "w+b");
+  mtx_matrix_fwrite_bin(stream, &__M, MTX_BIN_CHECKSUM);
+  fflush(stream);
+
+  mtx_matrix_t m;
+  CHECK_C(mtx_matrix_mmap(&m, path, MTX_MMAP_READ | MTX_MMAP_VERIFY) == 0);
+  CHECK_C(mtx_matrix_equals(&m, &__M));
+  CHECK_C((uintptr_t)mtx_matrix_raw_a(&m) % MTX_MATRIX_ALIGNMENT == 0);
+
+  // Mapped matrices have their own release function.
+  mock_c()->enable();
+  mock_c()
+      ->expectNCalls(2, "test_fail")
+      ->withIntParameters("error", MTX_INVALID_ERR);
+  TRY mtx_matrix_free(&m);
+  CATCH(INTEGER, exp1) {}
+  TRY mtx_matrix_unref(&m);
+  CATCH(INTEGER, exp2) {}
+  mock_c()->disable();
+  mtx_matrix_munmap(&m);
+  CHECK_C(m.data == NULL);
+
+  // Copy-on-write changes stay in the process.
+  CHECK_C(mtx_matrix_mmap(&m, path, MTX_MMAP_PRIVATE) == 0);
+  mtx_matrix_at(&m, 1, 1) += 1;
+  mtx_matrix_munmap(&m);
+
+  // Shared changes go to the file (and break its checksum).
+  CHECK_C(mtx_matrix_mmap(&m, path, MTX_MMAP_WRITE | MTX_MMAP_VERIFY) == 0);
+  mtx_matrix_at(&m, 1, 1) += 1;
+  mtx_matrix_munmap(&m);
+
+  mtx_matrix_t r = {0};
+  rewind(stream);
+  CHECK_C(mtx_matrix_fread_bin(stream, &r) == 1);
+  CHECK_C(mtx_matrix_mmap(&m, path, MTX_MMAP_VERIFY) == 1);
+  CHECK_C(mtx_matrix_mmap(&m, path, MTX_MMAP_READ) == 0);
+  CHECK_C(mtx_matrix_at(&m, 1, 1) == mtx_matrix_at(&__M, 1, 1) + 1);
+  mtx_matrix_munmap(&m);
+
+  // Truncated file.
+  CHECK_C(ftruncate(fd, sizeof(mtx_bin_header_t) + sizeof(double)) == 0);
+  CHECK_C(mtx_matrix_mmap(&m, path, MTX_MMAP_READ) == 1);
+
+  fclose(stream);
+  unlink(path);
+}
+
+// Writes text to a new temporary file, whose path is stored in path.
+static void __write_tmp(char *path, const char *text) {
+  strcpy(path, "/tmp/mtx_text_XXXXXX");
+  FILE *fd = fdopen(mkstemp(path), "w");
+  fputs(text, fd);
+  fclose(fd);
+}
+
+MAKE_TEST(matrix_io, load_text) {
+  mock_c()->disable();
+  char path[32];
+
+  __write_tmp(path, "\n1, 2,3\r\n\n4\t5 6\n-7e1 .5 8");
+  mtx_matrix_t m = {0};
+  CHECK_C(mtx_matrix_load_text(&m, path) == 0);
+  double expected[9] = {1, 2, 3, 4, 5, 6, -70, 0.5, 8};
+  mtx_matrix_t e;
+  mtx_matrix_ref_a(&e, expected, 3, 3);
+  CHECK_C(mtx_matrix_equals(&m, &e));
+  mtx_matrix_unref(&e);
+  mtx_matrix_free(&m);
+  unlink(path);
+
+  const char *invalid[] = {"", "\n\n", "1 2\n3\n", "1 2\n3 x\n",
+                           "1 2\n3 4-\n"};
+  for (int i = 0; i < 5; ++i) {
+    __write_tmp(path, invalid[i]);
+    CHECK_C(mtx_matrix_load_text(&m, path) == 1 && m.data == NULL);
+    unlink(path);
+  }
+
+  // Big enough to be split between threads.
+  int num_threads = mtx_cfg_get_num_threads();
+  mtx_cfg_set_num_threads(4);
+
+  size_t dy = 500, dx = 600;
+  strcpy(path, "/tmp/mtx_text_XXXXXX");
+  FILE *fd = fdopen(mkstemp(path), "w");
+  long middle_row = 0;
+  for (size_t i = 0; i < dy; ++i) {
+    if (i == dy / 2) {
+      middle_row = ftell(fd);
+    }
+    for (size_t j = 0; j < dx; ++j) {
+      fprintf(fd, "%zu ", i * 1000 + j);
+    }
+    fputc('\n', fd);
+  }
+  fclose(fd);
+
+  CHECK_C(mtx_matrix_load_text(&m, path) == 0);
+  CHECK_C(m.dy == dy && m.dx == dx);
+  for (size_t i = 0; i < dy; ++i) {
+    for (size_t j = 0; j < dx; ++j) {
+      CHECK_C(mtx_matrix_at(&m, i, j) == i * 1000 + j);
+    }
+  }
+
+  // Same dimensions into an initialized matrix.
+  CHECK_C(mtx_matrix_load_text(&m, path) == 0);
+
+  // Splits the row in the middle of the file after its first element.
+  fd = fopen(path, "r+");
+  fseek(fd, middle_row + strlen("250000"), SEEK_SET);
+  fputc('\n', fd);
+  fclose(fd);
+  mtx_matrix_t m2 = {0};
+  CHECK_C(mtx_matrix_load_text(&m2, path) == 1 && m2.data == NULL);
+
+  mtx_cfg_set_num_threads(num_threads);
+  mtx_matrix_free(&m);
+  unlink(path);
+}
+
+MAKE_TEST(matrix_io, stream) {
+  mock_c()->disable();
+  char path[32];
+  int formats[] = {MTX_STREAM_TEXT, MTX_STREAM_BINARY};
+
+  for (int f = 0; f < 2; ++f) {
+    // Written in blocks of 3 rows and read back in blocks of 4.
+    __write_tmp(path, "");
+    mtx_matrix_stream_t S;
+    mtx_matrix_stream_create(&S, path, formats[f]);
+    for (size_t i = 0; i < __M.dy; i += 3) {
+      size_t rows = __M.dy - i < 3 ? __M.dy - i : 3;
+      mtx_matrix_view_t block = mtx_matrix_view_of(&__M, i, 0, rows, __M.dx);
+      mtx_matrix_stream_write_block(&S, &block.matrix);
+    }
+    CHECK_C(mtx_matrix_stream_close(&S) == 0);
+
+    CHECK_C(mtx_matrix_stream_open(&S, path) == 0 && S.format == formats[f]);
+    mtx_matrix_view_t view;
+    size_t rows, total = 0;
+    while ((rows = mtx_matrix_stream_next_block(&S, &view, 4)) > 0) {
+      mtx_matrix_view_t expected =
+          mtx_matrix_view_of(&__M, total, 0, rows, __M.dx);
+      CHECK_C(rows <= 4 && mtx_matrix_equals(&view.matrix, &expected.matrix));
+      total += rows;
+    }
+    CHECK_C(total == __M.dy);
+    CHECK_C(mtx_matrix_stream_close(&S) == 0);
+    unlink(path);
+  }
+
+  // Empty lines are skipped; a line with another number of elements stops
+  // the stream.
+  __write_tmp(path, "\n1, 2\r\n\n3\t4\n5 6 7\n");
+  mtx_matrix_stream_t S;
+  CHECK_C(mtx_matrix_stream_open(&S, path) == 0);
+  mtx_matrix_view_t view;
+  CHECK_C(mtx_matrix_stream_next_block(&S, &view, 2) == 2);
+  CHECK_C(mtx_matrix_at(&view.matrix, 0, 1) == 2 &&
+          mtx_matrix_at(&view.matrix, 1, 0) == 3);
+  CHECK_C(mtx_matrix_stream_next_block(&S, &view, 2) == 0);
+  CHECK_C(mtx_matrix_stream_close(&S) == 1);
+  unlink(path);
+
+  // Binary file with a corrupted element.
+  strcpy(path, "/tmp/mtx_text_XXXXXX");
+  FILE *fd = fdopen(mkstemp(path), "wb");
+  mtx_matrix_fwrite_bin(fd, &__M, MTX_BIN_CHECKSUM);
+  fseek(fd, sizeof(mtx_bin_header_t), SEEK_SET);
+  fputc(0x55, fd);
+  fclose(fd);
+  CHECK_C(mtx_matrix_stream_open(&S, path) == 0);
+  CHECK_C(mtx_matrix_stream_next_block(&S, &view, __M.dy) == 0);
+  CHECK_C(mtx_matrix_stream_close(&S) == 1);
+  unlink(path);
+
+  // Invalid binary header.
+  __write_tmp(path, "MTXB1 2 3\n");
+  CHECK_C(mtx_matrix_stream_open(&S, path) == 1);
+  unlink(path);
+}
+
+static FILE *__text_tmpfile(const char *text) {
+  FILE *fd = tmpfile();
+  fputs(text, fd);
+  rewind(fd);
+  return fd;
+}
+
+MAKE_TEST(matrix_io, mm_fread) {
+  mock_c()->disable();
+  mtx_matrix_t m = {0}, e;
+
+  // Symmetric coordinate file, expanded into a dense matrix.
+  FILE *fd = __text_tmpfile("%%MatrixMarket matrix coordinate real symmetric\n"
+                            "% comment\n"
+                            "\n"
+                            "3 3 3\n"
+                            "1 1 1.5\n"
+                            "3 1 -2\n"
+                            "  3 2\t4e1  \n");
+  CHECK_C(mtx_matrix_mm_fread(fd, &m) == 0);
+  double sym[9] = {1.5, 0, -2, 0, 0, 40, -2, 40, 0};
+  mtx_matrix_ref_a(&e, sym, 3, 3);
+  CHECK_C(mtx_matrix_equals(&m, &e));
+  mtx_matrix_unref(&e);
+  fclose(fd);
+
+  // Skew-symmetric array file into the same matrix.
+  fd = __text_tmpfile("%%MatrixMarket matrix array integer skew-symmetric\n"
+                      "3 3\n1\n2\n3\n");
+  CHECK_C(mtx_matrix_mm_fread(fd, &m) == 0);
+  double skew[9] = {0, -1, -2, 1, 0, -3, 2, 3, 0};
+  mtx_matrix_ref_a(&e, skew, 3, 3);
+  CHECK_C(mtx_matrix_equals(&m, &e));
+  mtx_matrix_unref(&e);
+  mtx_matrix_free(&m);
+  fclose(fd);
+
+  // General array files are stored in column-major order.
+  fd = __text_tmpfile("%%MatrixMarket matrix array real general\n"
+                      "2 3\n1\n2\n3\n4\n5\n6\n");
+  CHECK_C(mtx_matrix_mm_fread(fd, &m) == 0);
+  double general[6] = {1, 3, 5, 2, 4, 6};
+  mtx_matrix_ref_a(&e, general, 2, 3);
+  CHECK_C(mtx_matrix_equals(&m, &e));
+  mtx_matrix_unref(&e);
+  mtx_matrix_free(&m);
+  fclose(fd);
+
+  const char *invalid[] = {
+      "",
+      "%%MatrixMarket matrix coordinate complex general\n1 1 1\n1 1 1 0\n",
+      "%%MatrixMarket matrix array pattern general\n1 1\n",
+      "%%MatrixMarket matrix array real symmetric\n2 3\n1\n2\n3\n",
+      "%%MatrixMarket matrix coordinate real general\n2 2 2\n1 1 1\n",
+      "%%MatrixMarket matrix coordinate real general\n2 2 1\n3 1 1\n",
+      "%%MatrixMarket matrix coordinate real symmetric\n2 2 1\n1 2 1\n",
+      "%%MatrixMarket matrix coordinate real general\n2 2 1\n1 1 1x\n",
+      "%%MatrixMarket matrix array real general\n1 1\n1 2\n"};
+  for (size_t i = 0; i < sizeof(invalid) / sizeof(*invalid); ++i) {
+    fd = __text_tmpfile(invalid[i]);
+    CHECK_C(mtx_matrix_mm_fread(fd, &m) == 1 && m.data == NULL);
+    fclose(fd);
+  }
+}
+
+MAKE_TEST(matrix_io, mm_sparse) {
+  mock_c()->disable();
+
+  FILE *fd = __text_tmpfile("%%MatrixMarket matrix coordinate pattern "
+                            "symmetric\n4 4 4\n4 1\n2 2\n3 1\n4 3\n");
+  mtx_sparse_t S;
+  CHECK_C(mtx_sparse_mm_fread(fd, &S) == 0);
+  fclose(fd);
+  CHECK_C(S.dy == 4 && S.dx == 4 && S.nnz == 7);
+  size_t row_ptr[] = {0, 2, 3, 5, 7};
+  size_t col[] = {2, 3, 1, 0, 3, 0, 2};
+  for (size_t i = 0; i <= 4; ++i) {
+    CHECK_C(S.row_ptr[i] == row_ptr[i]);
+  }
+  for (size_t k = 0; k < 7; ++k) {
+    CHECK_C(S.col[k] == col[k] && S.val[k] == 1);
+  }
+
+  // Written back as the lower triangle and read into a dense matrix.
+  fd = tmpfile();
+  mtx_sparse_mm_fwrite(fd, &S, MTX_MM_SYMMETRIC);
+  rewind(fd);
+  mtx_matrix_t m = {0}, e = {0};
+  CHECK_C(mtx_matrix_mm_fread(fd, &m) == 0);
+  mtx_sparse_to_dense(&e, &S);
+  CHECK_C(mtx_matrix_equals(&m, &e));
+  fclose(fd);
+
+  // Dense matrices round trip through array files.
+  mtx_matrix_view_t v = mtx_matrix_view_of(&__M, 2, 3, 4, 5);
+  fd = tmpfile();
+  mtx_matrix_mm_fwrite(fd, &v.matrix, MTX_MM_GENERAL);
+  rewind(fd);
+  mtx_matrix_free(&m);
+  CHECK_C(mtx_matrix_mm_fread(fd, &m) == 0);
+  CHECK_C(mtx_matrix_equals(&m, &v.matrix));
+  fclose(fd);
+
+  // Coordinates out of the matrix.
+  size_t rows[] = {0, 2}, cols[] = {1, 1};
+  double vals[] = {1, 2};
+  mtx_sparse_t S2;
+  CHECK_C(mtx_sparse_init_coo(&S2, 2, 2, 2, rows, cols, vals) == 1);
+
+  mtx_matrix_free(&m);
+  mtx_matrix_free(&e);
+  mtx_sparse_free(&S);
+}
+
+// Writes an npy file with the given header dictionary and elements.
+static void __write_npy(char *path, int major, const char *dict,
+                        const void *elements, size_t size) {
+  strcpy(path, "/tmp/mtx_npy_XXXXXX");
+  FILE *fd = fdopen(mkstemp(path), "wb");
+  size_t len = strlen(dict);
+  fwrite("\x93NUMPY", 1, 6, fd);
+  fputc(major, fd);
+  fputc(0, fd);
+  for (int i = 0; i < (major == 1 ? 2 : 4); ++i) {
+    fputc((int)(len >> 8 * i) & 0xff, fd);
+  }
+  fwrite(dict, 1, len, fd);
+  fwrite(elements, 1, size, fd);
+  fclose(fd);
+}
+
+MAKE_TEST(matrix_io, npy) {
+  mock_c()->disable();
+  char path[32];
+  mtx_matrix_view_t v = mtx_matrix_view_of(&__M, 1, 2, 3, 4);
+  int flags[] = {0, MTX_NPY_FORTRAN, MTX_NPY_FLOAT32,
+                 MTX_NPY_FLOAT32 | MTX_NPY_FORTRAN};
+
+  for (int f = 0; f < 4; ++f) {
+    __write_tmp(path, "");
+    mtx_matrix_save_npy(path, &v.matrix, flags[f]);
+
+    // The elements start at a multiple of 64 bytes.
+    FILE *fd = fopen(path, "rb");
+    char header[129] = {0};
+    CHECK_C(fread(header, 1, 128, fd) == 128 && header[127] == '\n');
+    CHECK_C(strstr(header + 10, "'shape': (3, 4), }") != NULL);
+    fclose(fd);
+
+    mtx_matrix_t m = {0};
+    CHECK_C(mtx_matrix_load_npy(&m, path) == 0);
+    CHECK_C(m.dy == 3 && m.dx == 4);
+    for (size_t i = 0; i < 3; ++i) {
+      for (size_t j = 0; j < 4; ++j) {
+        double x = mtx_matrix_at(&v.matrix, i, j);
+        CHECK_C(mtx_matrix_at(&m, i, j) ==
+                (flags[f] & MTX_NPY_FLOAT32 ? (double)(float)x : x));
+      }
+    }
+    mtx_matrix_free(&m);
+
+    // Only C-order float64 files are mapped.
+    CHECK_C(mtx_matrix_mmap_npy(&m, path, MTX_MMAP_READ) == (f != 0));
+    if (f == 0) {
+      CHECK_C(mtx_matrix_equals(&m, &v.matrix));
+      mtx_matrix_munmap(&m);
+    }
+    unlink(path);
+  }
+
+  // Version 2.0 header with a vector, read as a column.
+  double vector[3] = {1, -2, 3.5};
+  __write_npy(path, 2,
+              "{\"descr\": \"<f8\", \"fortran_order\": False, \"shape\": "
+              "(3,)}    \n",
+              vector, sizeof(vector));
+  mtx_matrix_t m = {0};
+  CHECK_C(mtx_matrix_load_npy(&m, path) == 0);
+  CHECK_C(m.dy == 3 && m.dx == 1 && mtx_matrix_at(&m, 2, 0) == 3.5);
+  mtx_matrix_free(&m);
+  CHECK_C(mtx_matrix_mmap_npy(&m, path, MTX_MMAP_PRIVATE) == 0);
+  CHECK_C(mtx_matrix_at(&m, 1, 0) == -2);
+  mtx_matrix_munmap(&m);
+  unlink(path);
+
+  const char *invalid[] = {
+      "{'descr': '>f8', 'fortran_order': False, 'shape': (3,), }",
+      "{'descr': '<i8', 'fortran_order': False, 'shape': (3,), }",
+      "{'descr': '<f8', 'fortran_order': False, 'shape': (1, 1, 3), }",
+      "{'descr': '<f8', 'fortran_order': False, 'shape': (0, 3), }",
+      "{'descr': '<f8', 'fortran_order': False, 'shape': (4,), }",
+      "{'descr': '<f8', 'shape': (3,), }"};
+  for (size_t i = 0; i < sizeof(invalid) / sizeof(*invalid); ++i) {
+    __write_npy(path, 1, invalid[i], vector, sizeof(vector));
+    CHECK_C(mtx_matrix_load_npy(&m, path) == 1 && m.data == NULL);
+    unlink(path);
+  }
+}
+
 MAKE_TEST(matrix_io, fread_raw) {
   mtx_matrix_t m;
   FILE *fd = get_mtx_fd(__TEST_FILES, "default")->stream;
@@ -351,7 +1308,7 @@ MAKE_TEST(matrix_io, fread_raw) {
   mock_c()->expectNCalls(2 + 2, "realloc_mock");
 
 #define COMPARE_RAW(raw1, raw2, which_matrix)                                  \
-  for (int i = 0; i < dx * dy; ++i) {                                          \
+  for (size_t i = 0; i < dx * dy; ++i) {                                       \
     if (raw1[i] != raw2[i]) {                                                  \
       FAIL_TEXT_C("mtx_matrix_fread_raw() read " #which_matrix                 \
                   "th matrix wrongly.");                                       \
@@ -359,7 +1316,7 @@ MAKE_TEST(matrix_io, fread_raw) {
   }
 
   double arr[9] = {2, 3, 1, 48, -24.3, 1e-242, -3.342e+119, 0, -0.00044342};
-  int dx, dy;
+  size_t dx, dy;
 
   double *raw = mtx_matrix_fread_raw(fd, &dy, &dx);
   CHECK_C(dx == dy && dx == 3);
@@ -384,7 +1341,7 @@ MAKE_TEST(matrix_io, fread_raw) {
 MAKE_TEST(matrix_io, fread_raw_fail) {
   FILE *fd = get_mtx_fd(__TEST_FILES, "default")->stream;
 
-  int dy, dx;
+  size_t dy, dx;
   double *raw;
 
   // Null pointer to stream
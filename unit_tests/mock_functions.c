@@ -9,6 +9,7 @@ extern "C" {
 
 void *malloc_mock(size_t size);
 void *realloc_mock(void *ptr, size_t size);
+int posix_memalign_mock(void **memptr, size_t alignment, size_t size);
 void free_mock(void *p);
 void *memcpy_mock(void *dest, const void *src, size_t size);
 void *memmove_mock(void *dest, const void *src, size_t size);
@@ -17,19 +18,30 @@ int fscanf_mock(FILE *stream, const char *format, ...);
 
 #define malloc malloc_mock
 #define realloc realloc_mock
+#define posix_memalign posix_memalign_mock
 #define free free_mock
 #define memcpy memcpy_mock
 #define memmove memmove_mock
 #define fprintf fprintf_mock
 #define fscanf fscanf_mock
 
+#include "../backend.c"
+#include "../blas1.c"
+#include "../cblas.c"
 #include "../errors.c"
+#include "../gemm.c"
 #include "../linalg.c"
+#include "../simd.c"
 #include "../matrix.c"
+#include "../matrix_io.c"
 #include "../matrix_operations.c"
+#include "../sparse.c"
+#include "../threads.c"
+#include "../workspace.c"
 
 #undef malloc
 #undef realloc
+#undef posix_memalign
 #undef free
 #undef memcpy
 #undef memmove
@@ -50,6 +62,13 @@ void *realloc_mock(void *ptr, size_t size) {
   }
   return realloc(ptr, size); 
 }
+int posix_memalign_mock(void **memptr, size_t alignment, size_t size) {
+  MockActualCall_c *act = mock_c()->actualCall(__func__);
+  if (act->hasReturnValue()) {
+    return act->intReturnValue();
+  }
+  return posix_memalign(memptr, alignment, size);
+}
 void free_mock(void *p) {
   MockActualCall_c *act = mock_c()->actualCall(__func__);
 
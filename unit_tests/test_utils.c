@@ -137,7 +137,7 @@ void copy_next_matrix_of(mtx_matrix_t *M, struct test_mtx_files *files,
   }
 
   if (c == EOF) {
-    throw_error("Cannot read any %dx%d matrix in %s/%s/%s.txt", m.dy, m.dx,
+    throw_error("Cannot read any %zux%zu matrix in %s/%s/%s.txt", m.dy, m.dx,
                 files->groupname, files->testname, filename);
   }
 }
@@ -12,6 +12,8 @@ TEST_GROUP_C_WRAPPER(matrix_lifecycle) {
 
 TEST_ORDERED_C_WRAPPER(matrix_lifecycle, init, 0);
 TEST_ORDERED_C_WRAPPER(matrix_lifecycle, init_fail, 0);
+TEST_ORDERED_C_WRAPPER(matrix_lifecycle, init_aligned, 0);
+TEST_ORDERED_C_WRAPPER(matrix_lifecycle, init_overflow, 0);
 
 TEST_ORDERED_C_WRAPPER(matrix_lifecycle, free, 999); // Must be the last
 TEST_ORDERED_C_WRAPPER(matrix_lifecycle, free_fail, 0);
@@ -19,6 +21,9 @@ TEST_ORDERED_C_WRAPPER(matrix_lifecycle, free_fail, 0);
 TEST_ORDERED_C_WRAPPER(matrix_lifecycle, ref_a, 0);
 TEST_ORDERED_C_WRAPPER(matrix_lifecycle, unref, 1);
 TEST_ORDERED_C_WRAPPER(matrix_lifecycle, raw_a, 2);
+TEST_ORDERED_C_WRAPPER(matrix_lifecycle, unref_fail, 0);
+TEST_ORDERED_C_WRAPPER(matrix_lifecycle, swap, 0);
+TEST_ORDERED_C_WRAPPER(matrix_lifecycle, init_scratch, 0);
 
 TEST_GROUP_C_WRAPPER(matrix_basic) {
   TEST_GROUP_C_SETUP_WRAPPER(matrix_basic);
@@ -28,6 +33,9 @@ TEST_GROUP_C_WRAPPER(matrix_basic) {
 TEST_ORDERED_C_WRAPPER(matrix_basic, view, 10);
 TEST_ORDERED_C_WRAPPER(matrix_basic, view_fail, 10);
 TEST_ORDERED_C_WRAPPER(matrix_basic, view_free, 10);
+TEST_ORDERED_C_WRAPPER(matrix_basic, strided_view, 10);
+TEST_ORDERED_C_WRAPPER(matrix_basic, strided_view_fail, 10);
+TEST_ORDERED_C_WRAPPER(matrix_basic, reshape_view, 10);
 TEST_ORDERED_C_WRAPPER(matrix_basic, fill, 11);
 TEST_ORDERED_C_WRAPPER(matrix_basic, equals, 12);
 TEST_ORDERED_C_WRAPPER(matrix_basic, clone, 13);
@@ -40,12 +48,23 @@ TEST_GROUP_C_WRAPPER(matrix_io) {
 };
 
 TEST_ORDERED_C_WRAPPER(matrix_io, fread, 20);
+TEST_ORDERED_C_WRAPPER(matrix_io, parse_double, 20);
+TEST_ORDERED_C_WRAPPER(matrix_io, format_double, 20);
 TEST_ORDERED_C_WRAPPER(matrix_io, fprint, 20);
 TEST_ORDERED_C_WRAPPER(matrix_io, fread_fail, 20);
 TEST_ORDERED_C_WRAPPER(matrix_io, fprint_fail, 20);
 TEST_ORDERED_C_WRAPPER(matrix_io, fread_raw, 20);
 TEST_ORDERED_C_WRAPPER(matrix_io, fread_raw_fail, 20);
 TEST_ORDERED_C_WRAPPER(matrix_io, finit_fail, 20);
+TEST_ORDERED_C_WRAPPER(matrix_io, fwrite_bin, 20);
+TEST_ORDERED_C_WRAPPER(matrix_io, fread_bin_swapped, 20);
+TEST_ORDERED_C_WRAPPER(matrix_io, fread_bin_fail, 20);
+TEST_ORDERED_C_WRAPPER(matrix_io, mmap, 20);
+TEST_ORDERED_C_WRAPPER(matrix_io, load_text, 20);
+TEST_ORDERED_C_WRAPPER(matrix_io, stream, 20);
+TEST_ORDERED_C_WRAPPER(matrix_io, mm_fread, 20);
+TEST_ORDERED_C_WRAPPER(matrix_io, mm_sparse, 20);
+TEST_ORDERED_C_WRAPPER(matrix_io, npy, 20);
 
 // MATRIX OPERATIONS
 
@@ -57,8 +76,17 @@ TEST_GROUP_C_WRAPPER(matrix_arithmetic) {
 TEST_ORDERED_C_WRAPPER(matrix_arithmetic, distance_each, 30);
 TEST_ORDERED_C_WRAPPER(matrix_arithmetic, element_wise, 31);
 TEST_ORDERED_C_WRAPPER(matrix_arithmetic, mul, 31);
+TEST_ORDERED_C_WRAPPER(matrix_arithmetic, mul_blocked, 31);
+TEST_ORDERED_C_WRAPPER(matrix_arithmetic, mul_transposed, 31);
+TEST_ORDERED_C_WRAPPER(matrix_arithmetic, gemm, 31);
+TEST_ORDERED_C_WRAPPER(matrix_arithmetic, gemv, 31);
+TEST_ORDERED_C_WRAPPER(matrix_arithmetic, element_wise_flat, 31);
+TEST_ORDERED_C_WRAPPER(matrix_arithmetic, element_wise_strided, 31);
+TEST_ORDERED_C_WRAPPER(matrix_arithmetic, simd_levels, 31);
+TEST_ORDERED_C_WRAPPER(matrix_arithmetic, threads, 31);
 TEST_ORDERED_C_WRAPPER(matrix_arithmetic, s_mul, 31);
 TEST_ORDERED_C_WRAPPER(matrix_arithmetic, transpose, 31);
+TEST_ORDERED_C_WRAPPER(matrix_arithmetic, transpose_blocked, 31);
 TEST_ORDERED_C_WRAPPER(matrix_arithmetic, set_identity, 31);
 TEST_ORDERED_C_WRAPPER(matrix_arithmetic, get_upper, 31);
 TEST_ORDERED_C_WRAPPER(matrix_arithmetic, get_lower, 31);
@@ -71,6 +99,16 @@ TEST_GROUP_C_WRAPPER(linalg) {
 };
 
 TEST_ORDERED_C_WRAPPER(linalg, permutate, 40);
+TEST_ORDERED_C_WRAPPER(linalg, lu_threads, 40);
+TEST_ORDERED_C_WRAPPER(linalg, lu_blocked, 40);
+TEST_ORDERED_C_WRAPPER(linalg, lu_strided, 40);
+TEST_ORDERED_C_WRAPPER(linalg, workspace, 40);
+TEST_ORDERED_C_WRAPPER(linalg, blas1, 40);
+TEST_ORDERED_C_WRAPPER(linalg, subs_columns, 40);
+TEST_ORDERED_C_WRAPPER(linalg, cblas_level1, 40);
+TEST_ORDERED_C_WRAPPER(linalg, cblas_level2, 40);
+TEST_ORDERED_C_WRAPPER(linalg, cblas_level3, 40);
+TEST_ORDERED_C_WRAPPER(linalg, blas_backend, 40);
 // TEST_ORDERED_C_WRAPPER(linalg, lu_decomp, 41);
 
 int main(int argc, char **argv) {
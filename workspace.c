@@ -0,0 +1,178 @@
+#include "workspace.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+// Every allocation is preceded by a prefix of a whole alignment unit, so the
+// pointers handed out keep the alignment of the buffer. The prefix starts with
+// the workspace the allocation came from (NULL for the aligned allocator), so
+// it is released there even after the workspace is detached.
+#define PREFIX_SIZE MTX_MATRIX_ALIGNMENT
+
+// Prefix of an allocation made in the buffer of a workspace.
+typedef struct mtx_workspace_entry {
+  mtx_workspace_t *owner;
+  // Offset of the previous allocation, SIZE_MAX for the first one.
+  size_t prev;
+  int freed;
+} mtx_workspace_entry_t;
+
+// Prefix of an allocation that didn't fit in the buffer.
+typedef struct mtx_workspace_block {
+  mtx_workspace_t *owner;
+  struct mtx_workspace_block *next;
+  size_t size;
+} mtx_workspace_block_t;
+
+_Static_assert(sizeof(mtx_workspace_entry_t) <= PREFIX_SIZE &&
+                   sizeof(mtx_workspace_block_t) <= PREFIX_SIZE,
+               "the prefixes must fit in an alignment unit");
+
+static _Thread_local mtx_workspace_t *__mtx_workspace = NULL;
+
+static size_t __round_up(size_t size) {
+  return (size + PREFIX_SIZE - 1) / PREFIX_SIZE * PREFIX_SIZE;
+}
+
+void mtx_workspace_init(mtx_workspace_t *W, size_t size) {
+  size = __round_up(size);
+
+  W->base = size > 0 ? (char *)mtx_mem_aligned_alloc(MTX_MATRIX_ALIGNMENT,
+                                                     size)
+                     : NULL;
+  W->size = size;
+  W->used = 0;
+  W->top = SIZE_MAX;
+  W->peak = 0;
+  W->overflow = 0;
+  W->blocks = NULL;
+}
+
+static void __free_blocks(mtx_workspace_t *W) {
+  while (W->blocks != NULL) {
+    mtx_workspace_block_t *next = W->blocks->next;
+    free(W->blocks);
+    W->blocks = next;
+  }
+  W->overflow = 0;
+}
+
+void mtx_workspace_free(mtx_workspace_t *W) {
+  if (W == NULL) {
+    return;
+  }
+
+  __free_blocks(W);
+  free(W->base);
+  W->base = NULL;
+  W->size = 0;
+  W->used = 0;
+  W->top = SIZE_MAX;
+}
+
+// Once the workspace is empty, replaces the buffer by one that holds everything
+// that was in use at the same time.
+static void __grow_if_empty(mtx_workspace_t *W) {
+  if (W->used > 0 || W->blocks != NULL || W->peak <= W->size) {
+    return;
+  }
+
+  free(W->base);
+  W->base = NULL;
+  W->size = 0;
+  W->base = (char *)mtx_mem_aligned_alloc(MTX_MATRIX_ALIGNMENT, W->peak);
+  W->size = W->peak;
+}
+
+void mtx_workspace_reset(mtx_workspace_t *W) {
+  __free_blocks(W);
+  W->used = 0;
+  W->top = SIZE_MAX;
+  __grow_if_empty(W);
+}
+
+mtx_workspace_t *mtx_workspace_attach(mtx_workspace_t *W) {
+  mtx_workspace_t *previous = __mtx_workspace;
+  __mtx_workspace = W;
+  return previous;
+}
+
+mtx_workspace_t *mtx_workspace_current() { return __mtx_workspace; }
+
+void *_mtx_scratch_alloc(size_t size) {
+  mtx_workspace_t *W = __mtx_workspace;
+  if (W == NULL) {
+    char *p = (char *)mtx_mem_aligned_alloc(MTX_MATRIX_ALIGNMENT,
+                                            PREFIX_SIZE + size);
+    *(mtx_workspace_t **)p = NULL;
+    return p + PREFIX_SIZE;
+  }
+
+  size = PREFIX_SIZE + __round_up(size);
+  char *p;
+  if (size <= W->size - W->used) {
+    mtx_workspace_entry_t *entry = (mtx_workspace_entry_t *)(W->base + W->used);
+    entry->owner = W;
+    entry->prev = W->top;
+    entry->freed = 0;
+    W->top = W->used;
+    W->used += size;
+    p = (char *)entry;
+  } else {
+    mtx_workspace_block_t *block = (mtx_workspace_block_t *)
+        mtx_mem_aligned_alloc(MTX_MATRIX_ALIGNMENT, size);
+    block->owner = W;
+    block->next = W->blocks;
+    block->size = size;
+    W->blocks = block;
+    W->overflow += size;
+    p = (char *)block;
+  }
+
+  if (W->used + W->overflow > W->peak) {
+    W->peak = W->used + W->overflow;
+  }
+  return p + PREFIX_SIZE;
+}
+
+void _mtx_scratch_free(void *p) {
+  if (p == NULL) {
+    return;
+  }
+
+  char *prefix = (char *)p - PREFIX_SIZE;
+  mtx_workspace_t *W = *(mtx_workspace_t **)prefix;
+  if (W == NULL) {
+    free(prefix);
+    return;
+  }
+
+  if (W->base != NULL && prefix >= W->base && prefix < W->base + W->used) {
+    ((mtx_workspace_entry_t *)prefix)->freed = 1;
+
+    // Pops every freed allocation from the top of the stack.
+    while (W->top != SIZE_MAX) {
+      mtx_workspace_entry_t *top = (mtx_workspace_entry_t *)(W->base + W->top);
+      if (!top->freed) {
+        break;
+      }
+      W->used = W->top;
+      W->top = top->prev;
+    }
+  } else {
+    mtx_workspace_block_t **b = &W->blocks;
+    while (*b != NULL && (char *)*b != prefix) {
+      b = &(*b)->next;
+    }
+    if (*b == NULL) {
+      // Already discarded by mtx_workspace_reset().
+      return;
+    }
+    W->overflow -= (*b)->size;
+    *b = (*b)->next;
+    free(prefix);
+  }
+
+  __grow_if_empty(W);
+}
+
+#undef PREFIX_SIZE
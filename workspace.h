@@ -0,0 +1,72 @@
+#ifndef MTX_WORKSPACE_H
+#define MTX_WORKSPACE_H
+
+#include "matrix.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct mtx_workspace_block;
+
+// Arena de onde saem as matrizes e arrays temporários das operações (saídas
+// que convergem com as entradas, a cópia LU de mtx_matrix_det(), os painéis
+// empacotados do GEMM, ...). As alocações são feitas em pilha sobre um único
+// buffer e devolvidas ao fim de cada operação. O que não couber no buffer é
+// alocado à parte, e o buffer cresce até o pico de uso assim que a arena fica
+// vazia, então a partir da segunda execução de uma mesma sequência de
+// operações nenhuma alocação é feita.
+typedef struct mtx_workspace {
+  char *base;
+  size_t size;
+  // Bytes do buffer em uso (topo da pilha).
+  size_t used;
+  // Offset da última alocação do buffer.
+  size_t top;
+  // Maior número de bytes em uso ao mesmo tempo, contando os blocos à parte.
+  size_t peak;
+  // Bytes em uso nos blocos alocados à parte.
+  size_t overflow;
+  struct mtx_workspace_block *blocks;
+} mtx_workspace_t;
+
+// Inicializa a arena W com um buffer de size bytes (que pode ser 0, sendo
+// então dimensionado pelo uso).
+void mtx_workspace_init(mtx_workspace_t *W, size_t size);
+
+// Libera toda a memória da arena W. W não pode estar anexada a nenhuma thread.
+void mtx_workspace_free(mtx_workspace_t *W);
+
+// Descarta todas as alocações de W, inclusive as que não foram devolvidas por
+// causa de erros no meio de uma operação.
+void mtx_workspace_reset(mtx_workspace_t *W);
+
+// Anexa W à thread que chama: os temporários das operações feitas por ela
+// passam a sair de W. Caso W == NULL, os temporários voltam a ser alocados com
+// mtx_mem_aligned_alloc(). Retorna a arena anexada anteriormente, para que
+// possa ser restaurada no fim de uma chamada.
+mtx_workspace_t *mtx_workspace_attach(mtx_workspace_t *W);
+
+// Retorna a arena anexada à thread que chama ou NULL.
+mtx_workspace_t *mtx_workspace_current();
+
+// Uso interno da lib: aloca size bytes alinhados a MTX_MATRIX_ALIGNMENT da
+// arena da thread, ou com mtx_mem_aligned_alloc() caso não haja uma. Os
+// ponteiros são devolvidos com _mtx_scratch_free(), de preferência na ordem
+// inversa das alocações, à arena de onde vieram (mesmo que ela já tenha sido
+// desanexada, mas não liberada).
+void *_mtx_scratch_alloc(size_t size);
+void _mtx_scratch_free(void *p);
+
+// Defined in matrix.c
+// Inicializa _M como mtx_matrix_init(), mas com o bloco vindo de
+// _mtx_scratch_alloc(). Deve ser liberada com mtx_matrix_free() na mesma
+// thread.
+void mtx_matrix_init_scratch(mtx_matrix_t *_M, size_t dy, size_t dx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif